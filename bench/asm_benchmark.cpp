@@ -0,0 +1,144 @@
+#include <assert.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <chrono>
+
+#include "../src/assembler_specification.h"
+#include "../libs/file_manager.h"
+#include "asy_generator.h"
+#include "resource_usage.h"
+
+const char*  DEFAULT_RESULTS_FILE_NAME = "bin/asm_benchmark.csv";
+const char*  GENERATED_ASSEMBLY_NAME   = "bin/asm_benchmark.asy";
+const char*  GENERATED_BYTECODE_NAME   = "bin/asm_benchmark.bsy";
+const size_t DEFAULT_MAX_LINES_COUNT   = 200000;
+const double JUMP_DENSITY              = 0.15;
+const double COMPOUND_ARGS_RATIO       = 0.5;
+const size_t LINES_PER_LABEL           = 50;
+const size_t SERIES_LENGTH             = 4;
+const size_t SERIES_STEP               = 4;
+
+struct AssemblyResult
+{
+    size_t sourceBytes    = 0;
+    double seconds        = 0;
+    size_t assemblerRssKb = 0;
+};
+
+bool measureAssembly (const GeneratorParams* params, AssemblyResult* result);
+void writeResult     (FILE* resultsFile, const char* series, const GeneratorParams* params, const AssemblyResult* result);
+
+int main(int argc, char* argv[])
+{
+    size_t      maxLinesCount   = DEFAULT_MAX_LINES_COUNT;
+    const char* resultsFileName = DEFAULT_RESULTS_FILE_NAME;
+
+    if (argc >= 2) { maxLinesCount   = strtoul(argv[1], NULL, 10); }
+    if (argc >= 3) { resultsFileName = argv[2]; }
+
+    if (maxLinesCount < LINES_PER_LABEL) { printf("Benchmark error: too few lines\n"); return 1; }
+
+    FILE* resultsFile = fopen(resultsFileName, "w");
+    if (resultsFile == NULL) { printf("Benchmark error: couldn't open results file '%s'\n", resultsFileName); return 1; }
+
+    fprintf(resultsFile, "series,lines,labels,jump_density,compound_args_ratio,source_bytes,seconds,"
+                         "source_mb_per_second,ns_per_line,assembler_rss_kb,rss_kb_per_source_mb\n");
+
+    GeneratorParams params = {};
+    params.jumpDensity       = JUMP_DENSITY;
+    params.compoundArgsRatio = COMPOUND_ARGS_RATIO;
+
+    // scaling with the source size, labels count grows proportionally
+    size_t divisor = 1;
+    for (size_t i = 1; i < SERIES_LENGTH; i++) { divisor *= SERIES_STEP; }
+
+    for (size_t i = 0; i < SERIES_LENGTH; i++, divisor /= SERIES_STEP)
+    {
+        params.linesCount  = maxLinesCount / divisor;
+        params.labelsCount = params.linesCount / LINES_PER_LABEL;
+
+        AssemblyResult result = {};
+        if (!measureAssembly(&params, &result)) { fclose(resultsFile); return 1; }
+
+        writeResult(resultsFile, "size", &params, &result);
+    }
+
+    // scaling with the labels count, source size is fixed
+    params.linesCount  = maxLinesCount / SERIES_STEP;
+    params.labelsCount = params.linesCount / LINES_PER_LABEL;
+    for (size_t i = 1; i < SERIES_LENGTH; i++) { params.labelsCount /= SERIES_STEP; }
+
+    for (size_t i = 0; i < SERIES_LENGTH; i++, params.labelsCount *= SERIES_STEP)
+    {
+        if (params.labelsCount == 0) { continue; }
+
+        AssemblyResult result = {};
+        if (!measureAssembly(&params, &result)) { fclose(resultsFile); return 1; }
+
+        writeResult(resultsFile, "labels", &params, &result);
+    }
+
+    fclose(resultsFile);
+
+    return 0;
+}
+
+// only translateAssemblyFile is timed, memory is the resident set growth while the assembler is alive
+bool measureAssembly(const GeneratorParams* params, AssemblyResult* result)
+{
+    assert(params != NULL);
+    assert(result != NULL);
+
+    if (!generateAssembly(params, GENERATED_ASSEMBLY_NAME)) { return false; }
+
+    result->sourceBytes = getFileSize(GENERATED_ASSEMBLY_NAME);
+
+    char* assemblerArgv[] = { (char*) "asm+", (char*) GENERATED_ASSEMBLY_NAME, (char*) GENERATED_BYTECODE_NAME, NULL };
+
+    size_t    rssBeforeKb = getCurrentRssKb();
+    Assembler assembler   = {};
+    if (initAssembler(&assembler, 3, assemblerArgv) != ASSEMBLER_INIT_NO_ERROR)
+    {
+        finishAssembler(&assembler);
+        return false;
+    }
+
+    auto start                   = std::chrono::steady_clock::now();
+    bool isTranslatedSuccessfuly = translateAssemblyFile(&assembler);
+    auto finish                  = std::chrono::steady_clock::now();
+
+    size_t rssAfterKb = getCurrentRssKb();
+    finishAssembler(&assembler);
+
+    if (!isTranslatedSuccessfuly) { printf("Benchmark error: generated program wasn't assembled\n"); return false; }
+
+    result->seconds        = std::chrono::duration<double>(finish - start).count();
+    result->assemblerRssKb = rssAfterKb > rssBeforeKb ? rssAfterKb - rssBeforeKb : 0;
+
+    return true;
+}
+
+void writeResult(FILE* resultsFile, const char* series, const GeneratorParams* params, const AssemblyResult* result)
+{
+    assert(resultsFile != NULL);
+    assert(series      != NULL);
+    assert(params      != NULL);
+    assert(result      != NULL);
+
+    double sourceMb = result->sourceBytes / (1024.0 * 1024.0);
+
+    fprintf(resultsFile, "%s,%zu,%zu,%.2lf,%.2lf,%zu,%.6lf,%.3lf,%.1lf,%zu,%.1lf\n",
+            series,
+            params->linesCount,
+            params->labelsCount,
+            params->jumpDensity,
+            params->compoundArgsRatio,
+            result->sourceBytes,
+            result->seconds,
+            sourceMb / result->seconds,
+            result->seconds * 1e9 / params->linesCount,
+            result->assemblerRssKb,
+            result->assemblerRssKb / sourceMb);
+
+    fflush(resultsFile);
+}
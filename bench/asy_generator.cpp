@@ -0,0 +1,154 @@
+#include <assert.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "asy_generator.h"
+
+static const char*  STACK_COMMANDS[] = { "add", "sub", "mul", "div", "pow", "sqrt", "sin", "cos", "abs", "flr", "out" };
+static const char*  JUMP_COMMANDS[]  = { "jmp", "jae", "ja", "jb", "jbe", "je", "jne", "call" };
+static const size_t REGISTERS_COUNT  = 18;
+static const double PUSH_RATIO       = 0.5; // of the non-jump instructions
+static const double POP_RATIO        = 0.2;
+static const double COMMENT_RATIO    = 0.05;
+
+#define ARRAY_LENGTH(array) (sizeof(array) / sizeof((array)[0]))
+
+uint64_t nextRandom            (uint64_t* state);
+double   nextRandomUnit        (uint64_t* state);
+void     writeCompoundArgument (FILE* file, uint64_t* state);
+
+// generates a syntactically valid program, which isn't meant to be executed
+#ifndef GENERATOR_NO_MAIN
+int main(int argc, char* argv[])
+{
+    if (argc <= 1)
+    {
+        printf("Usage: %s <output file> [lines] [labels] [jump density] [compound args ratio] [seed]\n", argv[0]);
+        return 1;
+    }
+
+    GeneratorParams params = {};
+    if (argc >= 3) { params.linesCount        = strtoul(argv[2], NULL, 10); }
+    if (argc >= 4) { params.labelsCount       = strtoul(argv[3], NULL, 10); }
+    if (argc >= 5) { params.jumpDensity       = strtod (argv[4], NULL);     }
+    if (argc >= 6) { params.compoundArgsRatio = strtod (argv[5], NULL);     }
+    if (argc >= 7) { params.seed              = strtoull(argv[6], NULL, 10); }
+
+    return !generateAssembly(&params, argv[1]);
+}
+#endif
+
+bool generateAssembly(const GeneratorParams* params, const char* assemblyFileName)
+{
+    assert(params           != NULL);
+    assert(assemblyFileName != NULL);
+
+    if (params->labelsCount == 0 && params->jumpDensity > 0)
+    {
+        printf("Generator error: jumps need at least one label\n");
+        return false;
+    }
+
+    if (params->labelsCount > params->linesCount)
+    {
+        printf("Generator error: more labels than lines\n");
+        return false;
+    }
+
+    FILE* assemblyFile = fopen(assemblyFileName, "w");
+    if (assemblyFile == NULL) { printf("Generator error: couldn't open '%s'\n", assemblyFileName); return false; }
+
+    uint64_t state     = params->seed == 0 ? 1 : params->seed;
+    size_t   nextLabel = 0;
+
+    for (size_t line = 0; line + 1 < params->linesCount; line++)
+    {
+        // labels are spread evenly over the program
+        if (nextLabel < params->labelsCount && line == nextLabel * params->linesCount / params->labelsCount)
+        {
+            fprintf(assemblyFile, "label_%zu:\n", nextLabel++);
+            continue;
+        }
+
+        double kind = nextRandomUnit(&state);
+
+        if (kind < params->jumpDensity)
+        {
+            fprintf(assemblyFile, "\t%s :label_%zu",
+                    JUMP_COMMANDS[nextRandom(&state) % ARRAY_LENGTH(JUMP_COMMANDS)],
+                    (size_t) (nextRandom(&state) % params->labelsCount));
+        }
+        else
+        {
+            kind = nextRandomUnit(&state);
+
+            if (kind < PUSH_RATIO)
+            {
+                fprintf(assemblyFile, "\tpush ");
+
+                if (nextRandomUnit(&state) < params->compoundArgsRatio)
+                    writeCompoundArgument(assemblyFile, &state);
+                else if (nextRandom(&state) % 2 == 0)
+                    fprintf(assemblyFile, "%zu", (size_t) (nextRandom(&state) % 100000));
+                else
+                    fprintf(assemblyFile, "%.4lf", nextRandomUnit(&state) * 1000);
+            }
+            else if (kind < PUSH_RATIO + POP_RATIO)
+            {
+                fprintf(assemblyFile, "\tpop ");
+                writeCompoundArgument(assemblyFile, &state);
+            }
+            else
+            {
+                fprintf(assemblyFile, "\t%s", STACK_COMMANDS[nextRandom(&state) % ARRAY_LENGTH(STACK_COMMANDS)]);
+            }
+        }
+
+        if (nextRandomUnit(&state) < COMMENT_RATIO) { fprintf(assemblyFile, " ; generated comment"); }
+
+        fprintf(assemblyFile, "\n");
+    }
+
+    fprintf(assemblyFile, "\thlt\n");
+
+    bool isWritten = !ferror(assemblyFile);
+    fclose(assemblyFile);
+
+    return isWritten;
+}
+
+// register, register + constant or any of them in RAM
+void writeCompoundArgument(FILE* file, uint64_t* state)
+{
+    assert(file  != NULL);
+    assert(state != NULL);
+
+    char   reg  = 'a' + nextRandom(state) % REGISTERS_COUNT;
+    size_t form = nextRandom(state) % 5;
+
+    switch (form)
+    {
+        case 0:  fprintf(file, "r%cx",       reg);                                  break;
+        case 1:  fprintf(file, "r%cx+%zu",   reg, (size_t) (nextRandom(state) % 64)); break;
+        case 2:  fprintf(file, "[%zu]",      (size_t) (nextRandom(state) % 1024));   break;
+        case 3:  fprintf(file, "[r%cx]",     reg);                                  break;
+        default: fprintf(file, "[r%cx+%zu]", reg, (size_t) (nextRandom(state) % 64)); break;
+    }
+}
+
+// xorshift64*
+uint64_t nextRandom(uint64_t* state)
+{
+    assert(state != NULL);
+
+    *state ^= *state >> 12;
+    *state ^= *state << 25;
+    *state ^= *state >> 27;
+
+    return *state * 2685821657736338717ULL;
+}
+
+double nextRandomUnit(uint64_t* state)
+{
+    return (nextRandom(state) >> 11) * (1.0 / 9007199254740992.0);
+}
@@ -0,0 +1,14 @@
+#pragma once
+#include <stddef.h>
+#include <stdint.h>
+
+struct GeneratorParams
+{
+    size_t   linesCount        = 10000;
+    size_t   labelsCount       = 100;
+    double   jumpDensity       = 0.1; // share of instructions that are jumps or calls
+    double   compoundArgsRatio = 0.5; // share of push arguments that use registers or RAM instead of a constant
+    uint64_t seed              = 1;
+};
+
+bool generateAssembly (const GeneratorParams* params, const char* assemblyFileName);
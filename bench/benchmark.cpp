@@ -0,0 +1,352 @@
+#include <assert.h>
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <chrono>
+
+#include "../src/cpu_specification.h"
+#include "../src/assembler_specification.h"
+#include "resource_usage.h"
+
+const char*  WORKLOADS_DIR             = "bench/workloads";
+const char*  BYTECODE_DIR              = "bin";
+const char*  DEFAULT_RESULTS_FILE_NAME = "bin/benchmark.csv";
+const char*  MATH_KERNELS_FILE_NAME    = "bin/math_kernels.csv";
+const size_t DEFAULT_RUNS_COUNT        = 5;
+const size_t MAX_FILE_NAME_LENGTH      = 256;
+const size_t MATH_KERNEL_VALUES_COUNT  = 1 << 16;
+const size_t MATH_KERNEL_REPEATS       = 20;
+
+const char* WORKLOADS[] = { "arith_loop", "arith_loop_regs", "fact_rec", "ram_walk", "branchy", "math", "math_arrays", "vram_render", "kernel_render", "naive_codegen" };
+
+// these run in every math mode, the rest only with libm
+const char* MATH_WORKLOADS[] = { "math", "math_arrays" };
+
+enum MathFunction
+{
+    MATH_FUNCTION_SIN,
+    MATH_FUNCTION_COS,
+    MATH_FUNCTION_POW
+};
+
+const char* MATH_FUNCTIONS[] = { "sin", "cos", "pow" };
+
+struct WorkloadResult
+{
+    const char* name         = NULL;
+    bool        isOptimized  = false; // assembled with -O
+    MathMode    mathMode     = MATH_MODE_EXACT;
+    size_t      runsCount    = 0;
+    uint64_t    instructions = 0; // per run
+    double      seconds      = 0; // total over all runs
+    size_t      peakRssKb    = 0;
+    size_t      programBytes = 0;
+    uint64_t    iCacheMisses = 0; // total over all runs
+    bool        hasICache    = false; // the counter could be read in every run
+};
+
+struct MathKernelResult
+{
+    double maxUlp           = 0; // against libm
+    double maxRelativeError = 0;
+    double nsPerValue       = 0; // one call per value
+    double nsPerArrayValue  = 0; // the array form
+};
+
+bool   assembleWorkload     (const char* assemblyFileName, const char* bytecodeFileName, bool isOptimized);
+bool   runWorkload          (const char* bytecodeFileName, size_t runsCount, WorkloadResult* result);
+bool   isMathWorkload       (const char* name);
+bool   writeMathKernels     (const char* fileName);
+void   measureMathKernel    (MathFunction function, MathMode mode, const double* x, const double* y, MathKernelResult* result);
+double evaluateMathFunction (MathFunction function, MathMode mode, double x, double y);
+double getUlpDistance       (double value, double exact);
+
+int main(int argc, char* argv[])
+{
+    size_t      runsCount       = DEFAULT_RUNS_COUNT;
+    const char* resultsFileName = DEFAULT_RESULTS_FILE_NAME;
+    const char* onlyWorkload    = NULL; // peak RSS is per process, so for exact per-workload values run them one by one
+
+    if (argc >= 2) { runsCount       = strtoul(argv[1], NULL, 10); }
+    if (argc >= 3) { resultsFileName = argv[2]; }
+    if (argc >= 4) { onlyWorkload    = argv[3]; }
+
+    if (runsCount == 0) { printf("Benchmark error: invalid number of runs '%s'\n", argv[1]); return 1; }
+
+    FILE* resultsFile = fopen(resultsFileName, "w");
+    if (resultsFile == NULL) { printf("Benchmark error: couldn't open results file '%s'\n", resultsFileName); return 1; }
+
+    fprintf(resultsFile, "workload,optimized,math_mode,runs,instructions,seconds,instructions_per_second,ns_per_instruction,peak_rss_kb,program_bytes,icache_misses\n");
+
+    bool isSuccessful = true;
+    for (size_t i = 0; i < sizeof(WORKLOADS) / sizeof(WORKLOADS[0]); i++)
+    {
+        if (onlyWorkload != NULL && strcmp(onlyWorkload, WORKLOADS[i]) != 0) { continue; }
+
+        // every workload runs as written and after the peephole optimizer
+        for (int isOptimized = 0; isOptimized <= 1; isOptimized++)
+        {
+            char assemblyFileName[MAX_FILE_NAME_LENGTH] = {};
+            char bytecodeFileName[MAX_FILE_NAME_LENGTH] = {};
+            snprintf(assemblyFileName, MAX_FILE_NAME_LENGTH, "%s/%s.asy",   WORKLOADS_DIR, WORKLOADS[i]);
+            snprintf(bytecodeFileName, MAX_FILE_NAME_LENGTH, "%s/%s%s.bsy", BYTECODE_DIR,  WORKLOADS[i], isOptimized ? ".O" : "");
+
+            if (!assembleWorkload(assemblyFileName, bytecodeFileName, isOptimized))
+            {
+                printf("Benchmark error: workload '%s'%s failed\n", WORKLOADS[i], isOptimized ? " (-O)" : "");
+                isSuccessful = false;
+                continue;
+            }
+
+            size_t modesCount = isMathWorkload(WORKLOADS[i]) ? MATH_MODES_COUNT : 1;
+            for (size_t mode = 0; mode < modesCount; mode++)
+            {
+                WorkloadResult result = {};
+                result.name        = WORKLOADS[i];
+                result.isOptimized = isOptimized;
+                result.mathMode    = (MathMode) mode;
+
+                if (!runWorkload(bytecodeFileName, runsCount, &result))
+                {
+                    printf("Benchmark error: workload '%s'%s failed with --math %s\n", WORKLOADS[i], isOptimized ? " (-O)" : "",
+                           getMathModeName(result.mathMode));
+                    isSuccessful = false;
+                    continue;
+                }
+
+                double totalInstructions = (double) result.instructions * result.runsCount;
+
+                fprintf(resultsFile, "%s,%d,%s,%zu,%llu,%.6lf,%.0lf,%.3lf,%zu,%zu,",
+                        result.name,
+                        result.isOptimized,
+                        getMathModeName(result.mathMode),
+                        result.runsCount,
+                        (unsigned long long) result.instructions,
+                        result.seconds,
+                        totalInstructions / result.seconds,
+                        result.seconds * 1e9 / totalInstructions,
+                        result.peakRssKb,
+                        result.programBytes);
+
+                // the column is left empty where there is no hardware counter
+                if (result.hasICache) { fprintf(resultsFile, "%llu", (unsigned long long) (result.iCacheMisses / result.runsCount)); }
+                fprintf(resultsFile, "\n");
+
+                fflush(resultsFile);
+            }
+        }
+    }
+
+    fclose(resultsFile);
+
+    if (!writeMathKernels(MATH_KERNELS_FILE_NAME))
+    {
+        printf("Benchmark error: couldn't write math kernels results to '%s'\n", MATH_KERNELS_FILE_NAME);
+        isSuccessful = false;
+    }
+
+    return !isSuccessful;
+}
+
+bool assembleWorkload(const char* assemblyFileName, const char* bytecodeFileName, bool isOptimized)
+{
+    assert(assemblyFileName != NULL);
+    assert(bytecodeFileName != NULL);
+
+    char* assemblerArgv[] = { (char*) "asm+", (char*) assemblyFileName, (char*) bytecodeFileName, (char*) "-O", NULL };
+
+    Assembler assembler = {};
+    if (initAssembler(&assembler, isOptimized ? 4 : 3, assemblerArgv) != ASSEMBLER_INIT_NO_ERROR)
+    {
+        finishAssembler(&assembler);
+        return false;
+    }
+
+    bool isTranslatedSuccessfuly = translateAssemblyFile(&assembler);
+    finishAssembler(&assembler);
+
+    return isTranslatedSuccessfuly;
+}
+
+// only executeProgram is timed and counted, loading the bytecode and creating the display are not
+bool runWorkload(const char* bytecodeFileName, size_t runsCount, WorkloadResult* result)
+{
+    assert(bytecodeFileName != NULL);
+    assert(result           != NULL);
+
+    char* cpuArgv[] = { (char*) "scpu", (char*) bytecodeFileName, (char*) "--math", (char*) getMathModeName(result->mathMode), NULL };
+
+    result->hasICache = true;
+
+    for (size_t run = 0; run < runsCount; run++)
+    {
+        CPU cpu = {};
+        if (initCpu(&cpu, 4, cpuArgv) != CPU_INIT_NO_ERROR) { return false; }
+
+        int      iCacheCounter = startICacheMissCounter();
+        auto     start         = std::chrono::steady_clock::now();
+        CpuError status        = executeProgram(&cpu);
+        auto     finish        = std::chrono::steady_clock::now();
+
+        uint64_t iCacheMisses  = 0;
+        result->hasICache      = stopICacheMissCounter(iCacheCounter, &iCacheMisses) && result->hasICache;
+        result->iCacheMisses  += iCacheMisses;
+
+        result->seconds      += std::chrono::duration<double>(finish - start).count();
+        result->instructions  = cpu.instructionsCount;
+        result->programBytes  = cpu.programBytes;
+
+        deleteCpu(&cpu);
+
+        if (status != CPU_NO_ERROR) { return false; }
+    }
+
+    result->runsCount = runsCount;
+    result->peakRssKb = getPeakRssKb();
+
+    return true;
+}
+
+bool isMathWorkload(const char* name)
+{
+    assert(name != NULL);
+
+    for (size_t i = 0; i < sizeof(MATH_WORKLOADS) / sizeof(MATH_WORKLOADS[0]); i++)
+    {
+        if (strcmp(name, MATH_WORKLOADS[i]) == 0) { return true; }
+    }
+
+    return false;
+}
+
+// error and speed of every kernel in every mode, on the same arguments: sin and cos of [-1000, 1000],
+// pow of [0.01, 100] to [-8, 8]
+bool writeMathKernels(const char* fileName)
+{
+    assert(fileName != NULL);
+
+    double* x = (double*) calloc(MATH_KERNEL_VALUES_COUNT, sizeof(double));
+    double* y = (double*) calloc(MATH_KERNEL_VALUES_COUNT, sizeof(double));
+    double* b = (double*) calloc(MATH_KERNEL_VALUES_COUNT, sizeof(double));
+    FILE*   resultsFile = fopen(fileName, "w");
+
+    bool isWritten = x != NULL && y != NULL && b != NULL && resultsFile != NULL;
+    if (isWritten)
+    {
+        initMathTables();
+
+        // a fixed sequence, so that the runs are comparable
+        uint64_t seed = 1;
+        for (size_t i = 0; i < MATH_KERNEL_VALUES_COUNT; i++)
+        {
+            seed = seed * 6364136223846793005 + 1442695040888963407;
+            double random = (double) (seed >> 11) / (double) ((uint64_t) 1 << 53);
+
+            x[i] = random * 2000 - 1000;
+            b[i] = pow(10, random * 4 - 2);
+            y[i] = fmod(random * 1e6, 16) - 8;
+        }
+
+        fprintf(resultsFile, "function,mode,max_ulp,max_relative_error,ns_per_value,ns_per_array_value\n");
+
+        for (size_t function = 0; function < sizeof(MATH_FUNCTIONS) / sizeof(MATH_FUNCTIONS[0]); function++)
+        {
+            for (size_t mode = 0; mode < MATH_MODES_COUNT; mode++)
+            {
+                MathKernelResult result = {};
+                measureMathKernel((MathFunction) function, (MathMode) mode, function == MATH_FUNCTION_POW ? b : x, y, &result);
+
+                fprintf(resultsFile, "%s,%s,%.0lf,%.3le,%.3lf,%.3lf\n",
+                        MATH_FUNCTIONS[function],
+                        getMathModeName((MathMode) mode),
+                        result.maxUlp,
+                        result.maxRelativeError,
+                        result.nsPerValue,
+                        result.nsPerArrayValue);
+            }
+        }
+    }
+
+    if (resultsFile != NULL) { fclose(resultsFile); }
+    free(x);
+    free(y);
+    free(b);
+
+    return isWritten;
+}
+
+void measureMathKernel(MathFunction function, MathMode mode, const double* x, const double* y, MathKernelResult* result)
+{
+    assert(x      != NULL);
+    assert(y      != NULL);
+    assert(result != NULL);
+
+    static double values[MATH_KERNEL_VALUES_COUNT] = {};
+
+    auto start = std::chrono::steady_clock::now();
+    for (size_t repeat = 0; repeat < MATH_KERNEL_REPEATS; repeat++)
+    {
+        for (size_t i = 0; i < MATH_KERNEL_VALUES_COUNT; i++) { values[i] = evaluateMathFunction(function, mode, x[i], y[i]); }
+    }
+    auto finish = std::chrono::steady_clock::now();
+
+    for (size_t i = 0; i < MATH_KERNEL_VALUES_COUNT; i++)
+    {
+        double exact = evaluateMathFunction(function, MATH_MODE_EXACT, x[i], y[i]);
+        double ulp   = getUlpDistance(values[i], exact);
+
+        if (ulp > result->maxUlp) { result->maxUlp = ulp; }
+        if (exact != 0 && fabs(values[i] - exact) / fabs(exact) > result->maxRelativeError)
+        {
+            result->maxRelativeError = fabs(values[i] - exact) / fabs(exact);
+        }
+    }
+
+    auto arrayStart = std::chrono::steady_clock::now();
+    for (size_t repeat = 0; repeat < MATH_KERNEL_REPEATS; repeat++)
+    {
+        switch (function)
+        {
+            case MATH_FUNCTION_SIN: { mathSinArray(mode, x, values, MATH_KERNEL_VALUES_COUNT);    break; }
+            case MATH_FUNCTION_COS: { mathCosArray(mode, x, values, MATH_KERNEL_VALUES_COUNT);    break; }
+            case MATH_FUNCTION_POW: { mathPowArray(mode, x, y, values, MATH_KERNEL_VALUES_COUNT); break; }
+        }
+    }
+    auto arrayFinish = std::chrono::steady_clock::now();
+
+    double valuesCount = (double) MATH_KERNEL_VALUES_COUNT * MATH_KERNEL_REPEATS;
+
+    result->nsPerValue      = std::chrono::duration<double>(finish      - start).count()      * 1e9 / valuesCount;
+    result->nsPerArrayValue = std::chrono::duration<double>(arrayFinish - arrayStart).count() * 1e9 / valuesCount;
+}
+
+double evaluateMathFunction(MathFunction function, MathMode mode, double x, double y)
+{
+    switch (function)
+    {
+        case MATH_FUNCTION_SIN: { return mathSin(mode, x);    }
+        case MATH_FUNCTION_COS: { return mathCos(mode, x);    }
+        default:                { return mathPow(mode, x, y); }
+    }
+}
+
+// the number of doubles between the two, NaN is 0 ulp from NaN only
+double getUlpDistance(double value, double exact)
+{
+    if (value != value || exact != exact) { return (value != value && exact != exact) ? 0 : INFINITY; }
+
+    int64_t valueBits = 0;
+    int64_t exactBits = 0;
+    memcpy(&valueBits, &value, sizeof(valueBits));
+    memcpy(&exactBits, &exact, sizeof(exactBits));
+
+    // negative doubles are ordered backwards
+    if (valueBits < 0) { valueBits = INT64_MIN - valueBits; }
+    if (exactBits < 0) { exactBits = INT64_MIN - exactBits; }
+
+    uint64_t distance = valueBits > exactBits ? (uint64_t) valueBits - (uint64_t) exactBits : (uint64_t) exactBits - (uint64_t) valueBits;
+
+    return (double) distance;
+}
+
@@ -0,0 +1,96 @@
+#include <stdio.h>
+
+#ifdef _WIN32
+#include <windows.h>
+#include <psapi.h>
+#else
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/resource.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+#include "resource_usage.h"
+
+// peak resident set size of the whole process so far, in kilobytes
+size_t getPeakRssKb()
+{
+#ifdef _WIN32
+    PROCESS_MEMORY_COUNTERS counters = {};
+    if (!GetProcessMemoryInfo(GetCurrentProcess(), &counters, sizeof(counters))) { return 0; }
+
+    return counters.PeakWorkingSetSize / 1024;
+#else
+    struct rusage usage = {};
+    if (getrusage(RUSAGE_SELF, &usage) != 0) { return 0; }
+
+    return usage.ru_maxrss; // kilobytes on Linux
+#endif
+}
+
+size_t getCurrentRssKb()
+{
+#ifdef _WIN32
+    PROCESS_MEMORY_COUNTERS counters = {};
+    if (!GetProcessMemoryInfo(GetCurrentProcess(), &counters, sizeof(counters))) { return 0; }
+
+    return counters.WorkingSetSize / 1024;
+#else
+    FILE* statmFile = fopen("/proc/self/statm", "r");
+    if (statmFile == NULL) { return 0; }
+
+    size_t totalPages    = 0;
+    size_t residentPages = 0;
+    if (fscanf(statmFile, "%zu %zu", &totalPages, &residentPages) != 2) { residentPages = 0; }
+
+    fclose(statmFile);
+
+    return residentPages * (sysconf(_SC_PAGESIZE) / 1024);
+#endif
+}
+
+// L1 instruction cache misses of the calling thread in user mode, NO_COUNTER if the hardware
+// counter isn't available (Windows, virtual machines, perf_event_paranoid)
+int startICacheMissCounter()
+{
+#ifdef _WIN32
+    return NO_COUNTER;
+#else
+    struct perf_event_attr attributes = {};
+    attributes.type           = PERF_TYPE_HW_CACHE;
+    attributes.size           = sizeof(attributes);
+    attributes.config         = PERF_COUNT_HW_CACHE_L1I | (PERF_COUNT_HW_CACHE_OP_READ << 8) | (PERF_COUNT_HW_CACHE_RESULT_MISS << 16);
+    attributes.disabled       = 1;
+    attributes.exclude_kernel = 1;
+    attributes.exclude_hv     = 1;
+
+    int counter = (int) syscall(SYS_perf_event_open, &attributes, 0, -1, -1, 0);
+    if (counter < 0) { return NO_COUNTER; }
+
+    if (ioctl(counter, PERF_EVENT_IOC_RESET, 0) != 0 || ioctl(counter, PERF_EVENT_IOC_ENABLE, 0) != 0)
+    {
+        close(counter);
+        return NO_COUNTER;
+    }
+
+    return counter;
+#endif
+}
+
+// the counter is closed
+bool stopICacheMissCounter(int counter, uint64_t* misses)
+{
+#ifdef _WIN32
+    return false;
+#else
+    if (counter == NO_COUNTER || misses == NULL) { return false; }
+
+    bool isRead = ioctl(counter, PERF_EVENT_IOC_DISABLE, 0) == 0 &&
+                  read(counter, misses, sizeof(*misses)) == sizeof(*misses);
+
+    close(counter);
+
+    return isRead;
+#endif
+}
\ No newline at end of file
@@ -0,0 +1,10 @@
+#pragma once
+#include <stddef.h>
+#include <stdint.h>
+
+static const int NO_COUNTER = -1;
+
+size_t getPeakRssKb           ();
+size_t getCurrentRssKb        ();
+int    startICacheMissCounter ();
+bool   stopICacheMissCounter  (int counter, uint64_t* misses);
@@ -0,0 +1,62 @@
+#include <assert.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "arena.h"
+
+static const size_t ARENA_ALIGNMENT = sizeof(double);
+
+// returns NULL if there's not enough memory
+void* arenaAllocate(Arena* arena, size_t size)
+{
+    assert(arena != NULL);
+
+    size = (size + ARENA_ALIGNMENT - 1) / ARENA_ALIGNMENT * ARENA_ALIGNMENT;
+
+    ArenaBlock* block = arena->blocks;
+    if (block == NULL || block->size - block->used < size)
+    {
+        size_t blockSize = size > ARENA_DEFAULT_BLOCK_SIZE ? size : ARENA_DEFAULT_BLOCK_SIZE;
+
+        // the block header and its data are a single allocation
+        block = (ArenaBlock*) calloc(1, sizeof(ArenaBlock) + blockSize);
+        if (block == NULL) { return NULL; }
+
+        block->next = arena->blocks;
+        block->size = blockSize;
+        block->data = (char*) (block + 1);
+
+        arena->blocks = block;
+    }
+
+    void* memory = block->data + block->used;
+    block->used += size;
+
+    return memory;
+}
+
+char* arenaCopyString(Arena* arena, const char* string, size_t length)
+{
+    assert(arena  != NULL);
+    assert(string != NULL);
+
+    char* copy = (char*) arenaAllocate(arena, length + 1);
+    if (copy == NULL) { return NULL; }
+
+    memcpy(copy, string, length);
+    copy[length] = '\0';
+
+    return copy;
+}
+
+void clearArena(Arena* arena)
+{
+    assert(arena != NULL);
+
+    while (arena->blocks != NULL)
+    {
+        ArenaBlock* next = arena->blocks->next;
+        free(arena->blocks);
+        arena->blocks = next;
+    }
+}
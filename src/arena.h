@@ -0,0 +1,24 @@
+#pragma once
+#include <stddef.h>
+
+// Bump allocator for many small allocations that live as long as the arena, e.g. label names.
+// Memory is taken in blocks and is freed all at once.
+
+static const size_t ARENA_DEFAULT_BLOCK_SIZE = 1 << 16;
+
+struct ArenaBlock
+{
+    ArenaBlock* next = NULL;
+    size_t      size = 0;
+    size_t      used = 0;
+    char*       data = NULL;
+};
+
+struct Arena
+{
+    ArenaBlock* blocks = NULL; // the current block is the first one
+};
+
+void* arenaAllocate   (Arena* arena, size_t size);
+char* arenaCopyString (Arena* arena, const char* string, size_t length);
+void  clearArena      (Arena* arena);
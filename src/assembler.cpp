@@ -1,58 +1,98 @@
 #include <assert.h>
+#include <charconv>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 
 #include "cpu_specification.h"
+#include "assembler_batch.h"
 #include "assembler_specification.h"
+#include "instructions.h"
+#include "mnemonics.h"
+#include "symbols.h"
 
-#define PRINT_ERROR(message) printf("Syntax ERROR: " message); \
-                             printCurrentLine(assembler);      \
-                             return false;   
+#define PRINT_ERROR(message) fprintf(assembler->messages, "Syntax ERROR: " message); \
+                             printCurrentLine(assembler);                           \
+                             return false;
 
-#define PRINT_ERROR1(message, param1) printf("Syntax ERROR: " message, param1); \
-                                      printCurrentLine(assembler);              \
-                                      return false; 
+#define PRINT_ERROR1(message, param1) fprintf(assembler->messages, "Syntax ERROR: " message, param1); \
+                                      printCurrentLine(assembler);                                   \
+                                      return false;
 
-#define PRINT_ERROR2(message, param1, param2) printf("Syntax ERROR: " message, param1, param2); \
-                                              printCurrentLine(assembler);                      \
-                                              return false;                            
+#define PRINT_ERROR2(message, param1, param2) fprintf(assembler->messages, "Syntax ERROR: " message, param1, param2); \
+                                              printCurrentLine(assembler);                                           \
+                                              return false;
 
 const char*  DEFAULT_BYTECODE_FILE_NAME = "bin/bytecode.bcd";
-const char*  TOKEN_DELIMS               = " ;\t";
-const size_t MAX_LINE_LENGTH            = 128;
-
-bool   translateAssemblyLine   (Assembler* assembler, const char* line, size_t passNum);
-bool   makeAssemblyPass        (Assembler* assembler, size_t passNum);
-bool   processArgument         (Assembler* assembler, bool isControlFlow, char* currToken, size_t passNum);
-bool   processCompoundToken    (Assembler* assembler, bool isControlFlow, char* currToken, size_t passNum);
-void   processNumbericToken    (Assembler* assembler, char* currToken);
-bool   processCompoundArgument (Assembler* assembler, char* currArg);
-bool   processLabel            (Assembler* assembler, size_t labelLength, char* cmd, size_t passNum);
+const size_t DEFAULT_FIXUPS_CAPACITY    = 64;
+const size_t DEFAULT_TARGETS_CAPACITY   = 16;
+const size_t DEFAULT_LINE_CAPACITY      = 128;
+const size_t MAX_MNEMONIC_LENGTH        = 16;
+
+AssemblerInitError initAssemblerTables (Assembler* assembler);
+bool   assembleCode            (Assembler* assembler);
+bool   readAssemblyLine        (Assembler* assembler);
+bool   readSourceLine          (Assembler* assembler);
+bool   reserveLine             (Assembler* assembler, size_t length);
+bool   compactAssembledCode    (Assembler* assembler, BytecodeImage* image);
+bool   translateAssemblyLine   (Assembler* assembler, const char* line);
+bool   resolveFixups           (Assembler* assembler);
+bool   writeBytecodeFile       (Assembler* assembler);
+bool   writeLabelsFile         (Assembler* assembler, const BytecodeImage* image);
+bool   writeObject             (Assembler* assembler);
+bool   processDirective        (Assembler* assembler, Token directive, const char** cursor);
+Token  nextToken               (const char** cursor);
+size_t countTokens             (const char* cursor);
+bool   hasOperandList          (const char* cursor);
+Token  nextOperand             (const char** cursor);
+size_t countOperands           (const char* cursor);
+bool   findRegisterMnemonic    (Token cmd, const InstructionDescriptor** mnemonic);
+bool   checkOperand            (Assembler* assembler, const InstructionDescriptor* mnemonic, size_t index, Token operand);
+bool   processArgument         (Assembler* assembler, bool isControlFlow, Token token);
+bool   processCompoundToken    (Assembler* assembler, bool isControlFlow, Token token);
+bool   processCompoundArgument (Assembler* assembler, Token arg);
+bool   processLabel            (Assembler* assembler, Token label, const char** cursor);
+bool   addFixup                (Assembler* assembler, const char* labelName, size_t labelLength);
+bool   addLiteralTarget        (Assembler* assembler);
 size_t currBytecodeOfs         (Assembler* assembler);
-void   createNewLabel          (Assembler* assembler, const char* labelName, size_t labelLength);
-Label* getLabel                (Assembler* assembler, const char* labelName);
-bool   isValidNumericToken     (const char* token);
-bool   isValidRegisterToken    (const char* token);
-size_t getExtraArgsCount       (const char* start, const char* commentStart);
+bool   createNewLabel          (Assembler* assembler, const char* labelName, size_t labelLength);
+bool   parseNumericToken       (Token token, double* value);
+bool   isValidRegisterToken    (Token token);
 void   printCurrentLine        (Assembler* assembler);
 
+// the benchmark harnesses link the assembler in, so it's built without main
+#ifndef ASSEMBLER_NO_MAIN
 int main(int argc, char* argv[])
 {
+    if (isAssemblerBatch(argc, argv))
+    {
+        AssemblerBatch batch = {};
+
+        AssemblerBatchError batchError = initAssemblerBatch(&batch, argc, argv);
+        if (batchError != ASSEMBLER_BATCH_NO_ERROR) { finishAssemblerBatch(&batch); return batchError; }
+
+        size_t failedCount = runAssemblerBatch(&batch);
+        finishAssemblerBatch(&batch);
+
+        return failedCount != 0;
+    }
+
     Assembler assembler = {};
 
     AssemblerInitError asmInitError = initAssembler(&assembler, argc, argv);
     if (asmInitError != ASSEMBLER_INIT_NO_ERROR) {  return asmInitError; } 
 
     bool isTranslatedSuccessfuly = translateAssemblyFile(&assembler);
-    if (!isTranslatedSuccessfuly) { printf("Assembler finished with an error.\n"); }
+    if      (!isTranslatedSuccessfuly) { printf("Assembler finished with an error.\n"); }
+    else if (assembler.isOptimized)    { printOptimizerStats(stdout, &assembler.optimizerStats); }
 
     finishAssembler(&assembler);
 
     return !isTranslatedSuccessfuly;
 }
+#endif
 
-#define ASM_INIT_ERROR(error) printf("Assembler error: %s\n", #error); return error;
+#define ASM_INIT_ERROR(error) fprintf(assembler != NULL ? assembler->messages : stdout, "Assembler error: %s\n", #error); return error;
 
 AssemblerInitError initAssembler(Assembler* assembler, int argc, char* argv[])
 {
@@ -62,27 +102,68 @@ AssemblerInitError initAssembler(Assembler* assembler, int argc, char* argv[])
 
     const char* assemblyFileName = NULL;
     const char* bytecodeFileName = DEFAULT_BYTECODE_FILE_NAME;
-    assemblyFileName = argv[1];
-    if (argc >= 3)
+    size_t      fileNamesCount   = 0;
+    for (int i = 1; i < argc; i++)
     {
-        bytecodeFileName = argv[2];
+        if      (strcmp(argv[i], "-O") == 0)     { assembler->isOptimized = true; }
+        else if (strcmp(argv[i], "-c") == 0)     { assembler->isObject    = true; }
+        else if (strcmp(argv[i], "--wide") == 0) { assembler->isWide      = true; }
+        else if (fileNamesCount == 0)            { assemblyFileName = argv[i]; fileNamesCount++; }
+        else if (fileNamesCount == 1)            { bytecodeFileName = argv[i]; fileNamesCount++; }
     }
  
     if (assemblyFileName == NULL) { ASM_INIT_ERROR(ASSEMBLER_INIT_ASY_FILE_UNSPECIFIED); }
     if (bytecodeFileName == NULL) { ASM_INIT_ERROR(ASSEMBLER_INIT_BCD_FILE_UNSPECIFIED); }
 
-    assembler->assembly = readTextFromFile(assemblyFileName);
-    if (assembler->assembly == NULL) { ASM_INIT_ERROR(ASSEMBLER_INIT_ASSEMBLY_FILE_READ_ERROR); }
+    assembler->assemblyFile = fopen(assemblyFileName, "r");
+    if (assembler->assemblyFile == NULL) { ASM_INIT_ERROR(ASSEMBLER_INIT_ASSEMBLY_FILE_READ_ERROR); }
 
     assembler->bytecodeFile = fopen(bytecodeFileName, "wb");
     if (assembler->bytecodeFile == NULL) { ASM_INIT_ERROR(ASSEMBLER_INIT_BYTECODE_FILE_WRITE_ERROR); }
 
+    // labels of an object file are written into it
+    if (!assembler->isObject)
+    {
+        char* labelsFileName = makeSymbolsFileName(bytecodeFileName);
+        if (labelsFileName == NULL) { ASM_INIT_ERROR(ASSEMBLER_INIT_NOT_ENOUGH_MEMORY); }
+
+        assembler->labelsFile = fopen(labelsFileName, "w");
+        free(labelsFileName);
+        if (assembler->labelsFile == NULL) { ASM_INIT_ERROR(ASSEMBLER_INIT_LABELS_FILE_WRITE_ERROR); }
+    }
+
+    return initAssemblerTables(assembler);
+}
+
+// source stays owned by the caller, the options (isOptimized) are set beforehand; the code is
+// translated into memory with translateAssemblySource, nothing is written to files
+AssemblerInitError initAssemblerForSource(Assembler* assembler, const char* source, size_t sourceSize)
+{
+    if (assembler == NULL)                 { ASM_INIT_ERROR(ASSEMBLER_INIT_NULL_PTR_PARAMETER); }
+    if (source == NULL && sourceSize != 0) { ASM_INIT_ERROR(ASSEMBLER_INIT_NULL_PTR_PARAMETER); }
+
+    assembler->source     = source != NULL ? source : "";
+    assembler->sourceSize = sourceSize;
+    assembler->sourcePos  = 0;
+
+    return initAssemblerTables(assembler);
+}
+
+AssemblerInitError initAssemblerTables(Assembler* assembler)
+{
+    assert(assembler != NULL);
+
     assembler->bytecode = newDynamicArray();
     if (assembler->bytecode == NULL) { ASM_INIT_ERROR(ASSEMBLER_INIT_NOT_ENOUGH_MEMORY); }
 
-    assembler->labels = newLabelArray();
+    assembler->labels = newLabelTable();
     if (assembler->labels == NULL) { ASM_INIT_ERROR(ASSEMBLER_INIT_NOT_ENOUGH_MEMORY); }
 
+    assembler->exports = newLabelTable();
+    if (assembler->exports == NULL) { ASM_INIT_ERROR(ASSEMBLER_INIT_NOT_ENOUGH_MEMORY); }
+
+    assembler->isRelocatable = assembler->isOptimized || assembler->isObject;
+
     return ASSEMBLER_INIT_NO_ERROR;
 }
 
@@ -90,10 +171,10 @@ void finishAssembler(Assembler* assembler)
 {
     assert(assembler != NULL);
 
-    if (assembler->assembly != NULL)
+    if (assembler->assemblyFile != NULL)
     {
-        deleteText(assembler->assembly);
-        assembler->assembly = NULL;
+        fclose(assembler->assemblyFile);
+        assembler->assemblyFile = NULL;
     }
 
     if (assembler->bytecodeFile != NULL)
@@ -102,6 +183,12 @@ void finishAssembler(Assembler* assembler)
         assembler->bytecodeFile = NULL;
     }
 
+    if (assembler->labelsFile != NULL)
+    {
+        fclose(assembler->labelsFile);
+        assembler->labelsFile = NULL;
+    }
+
     if (assembler->bytecode != NULL)
     {
         deleteDynamicArray(assembler->bytecode);
@@ -110,206 +197,589 @@ void finishAssembler(Assembler* assembler)
 
     if (assembler->labels != NULL)
     {
-        for (size_t i = 0; i < assembler->labels->iteratorPos; i++)
-        {
-            free(get(assembler->labels, i).name);    
-        }
-   
-        deleteLabelArray(assembler->labels);
+        deleteLabelTable(assembler->labels);
         assembler->labels = NULL;
     }
+
+    if (assembler->exports != NULL)
+    {
+        deleteLabelTable(assembler->exports);
+        assembler->exports = NULL;
+    }
+
+    free(assembler->currLine);
+    assembler->currLine         = NULL;
+    assembler->currLineCapacity = 0;
+
+    free(assembler->fixups);
+    assembler->fixups         = NULL;
+    assembler->fixupsCount    = 0;
+    assembler->fixupsCapacity = 0;
+    clearArena(&assembler->fixupNames);
+
+    free(assembler->literalTargets);
+    assembler->literalTargets         = NULL;
+    assembler->literalTargetsCount    = 0;
+    assembler->literalTargetsCapacity = 0;
 }
 
+// single pass: bytecode is emitted while the source is read line by line, jumps to labels
+// which aren't defined yet get a placeholder and are patched once the whole file is read,
+// with -O the peephole optimizer rewrites the bytecode after that
 bool translateAssemblyFile(Assembler* assembler)
 {
     assert(assembler               != NULL);
-    assert(assembler->assembly     != NULL);
+    assert(assembler->assemblyFile != NULL);
     assert(assembler->bytecode     != NULL);
     assert(assembler->bytecodeFile != NULL);
-    
-    if (!makeAssemblyPass(assembler, 1)) { return false; }
-    if (!makeAssemblyPass(assembler, 2)) { return false; }
 
-    size_t numOfBytesToWrite = assembler->bytecode->iteratorPos;
-    if (fwrite(assembler->bytecode->data, sizeof(char), numOfBytesToWrite, assembler->bytecodeFile) != numOfBytesToWrite)
+    if (!assembleCode(assembler)) { return false; }
+
+    if (assembler->isObject) { return writeObject(assembler); }
+
+    return writeBytecodeFile(assembler);
+}
+
+// the same translation from the source in memory, the compact code is put into image; the labels
+// are written only if labelsFile is set
+bool translateAssemblySource(Assembler* assembler, BytecodeImage* image)
+{
+    assert(assembler           != NULL);
+    assert(assembler->source   != NULL);
+    assert(assembler->bytecode != NULL);
+    assert(!assembler->isObject);
+    assert(image               != NULL);
+
+    if (!assembleCode(assembler) || !compactAssembledCode(assembler, image)) { return false; }
+
+    return assembler->labelsFile == NULL || writeLabelsFile(assembler, image);
+}
+
+bool assembleCode(Assembler* assembler)
+{
+    assert(assembler != NULL);
+
+    while (readAssemblyLine(assembler))
     {
-        printf("Couldn't write to file.\n");
-        return false;
+        if (!translateAssemblyLine(assembler, assembler->currLine)) { return false; }
+    }
+
+    if (assembler->assemblyFile != NULL)
+    {
+        if (ferror(assembler->assemblyFile)) { fprintf(assembler->messages, "Couldn't read assembly file.\n"); return false; }
+        if (!feof(assembler->assemblyFile))  { return false; }
+    }
+    else if (assembler->sourcePos < assembler->sourceSize) { return false; }
+
+    // references of an object file are left to the linker
+    if (!assembler->isObject && !resolveFixups(assembler)) { return false; }
+
+    if (assembler->isOptimized)
+    {
+        size_t codeSize = assembler->bytecode->iteratorPos;
+        if (optimizeBytecode((unsigned char*) assembler->bytecode->data, &codeSize, assembler->labels,
+                             assembler->isObject ? assembler->exports : NULL,
+                             assembler->fixups, &assembler->fixupsCount, &assembler->optimizerStats))
+        {
+            // the fixups were moved along with the code
+            assembler->bytecode->iteratorPos = codeSize;
+            if (!assembler->isObject && !resolveFixups(assembler)) { return false; }
+        }
+        else
+        {
+            fprintf(assembler->messages, "Note: the code can't be optimized (e.g. it jumps to a numeric offset), it is written as it is.\n");
+            assembler->isOptimized = false;
+        }
+    }
+
+    return true;
+}
+
+// returns false at the end of the file, the line buffer is grown until the whole line fits into it
+bool readAssemblyLine(Assembler* assembler)
+{
+    assert(assembler != NULL);
+
+    if (assembler->assemblyFile == NULL) { return readSourceLine(assembler); }
+
+    size_t length = 0;
+    while (true)
+    {
+        if (assembler->currLineCapacity - length < 2 && !reserveLine(assembler, assembler->currLineCapacity)) { return false; }
+
+        if (fgets(assembler->currLine + length, (int) (assembler->currLineCapacity - length), assembler->assemblyFile) == NULL)
+        {
+            if (length == 0) { return false; }
+            break;
+        }
+
+        length += strlen(assembler->currLine + length);
+        if (length > 0 && assembler->currLine[length - 1] == '\n') { break; }
+    }
+
+    assembler->currLineNumber++;
+
+    if (length > 0 && assembler->currLine[length - 1] == '\n') { assembler->currLine[--length] = '\0'; }
+    if (length > 0 && assembler->currLine[length - 1] == '\r') { assembler->currLine[--length] = '\0'; }
+
+    return true;
+}
+
+// the next line of the source in memory is copied out, tokens point into the line buffer
+bool readSourceLine(Assembler* assembler)
+{
+    assert(assembler         != NULL);
+    assert(assembler->source != NULL);
+
+    if (assembler->sourcePos >= assembler->sourceSize) { return false; }
+
+    const char* start = assembler->source + assembler->sourcePos;
+    size_t      rest  = assembler->sourceSize - assembler->sourcePos;
+    const char* end   = (const char*) memchr(start, '\n', rest);
+
+    size_t length = end != NULL ? (size_t) (end - start) : rest;
+    if (!reserveLine(assembler, length)) { return false; }
+
+    memcpy(assembler->currLine, start, length);
+    assembler->sourcePos += end != NULL ? length + 1 : length;
+    assembler->currLineNumber++;
+
+    if (length > 0 && assembler->currLine[length - 1] == '\r') { length--; }
+    assembler->currLine[length] = '\0';
+
+    return true;
+}
+
+// the line buffer is doubled until it holds length characters and two more
+bool reserveLine(Assembler* assembler, size_t length)
+{
+    assert(assembler != NULL);
+
+    if (assembler->currLineCapacity >= length + 2) { return true; }
+
+    size_t capacity = assembler->currLineCapacity == 0 ? DEFAULT_LINE_CAPACITY : assembler->currLineCapacity;
+    while (capacity < length + 2) { capacity *= 2; }
+
+    char* line = (char*) realloc(assembler->currLine, capacity);
+    if (line == NULL) { fprintf(assembler->messages, "Not enough memory for line %zu.\n", assembler->currLineNumber + 1); return false; }
+
+    assembler->currLine         = line;
+    assembler->currLineCapacity = capacity;
+
+    return true;
+}
+
+bool resolveFixups(Assembler* assembler)
+{
+    assert(assembler != NULL);
+
+    for (size_t i = 0; i < assembler->fixupsCount; i++)
+    {
+        Fixup* fixup = &assembler->fixups[i];
+
+        Label* label = findLabel(assembler->labels, fixup->labelName);
+        if (label == NULL)
+        {
+            fprintf(assembler->messages, "Syntax ERROR: no label '%s' found: line %zu\n", fixup->labelName, fixup->lineNumber);
+            return false;
+        }
+
+        memcpy(&assembler->bytecode->data[fixup->offset], &label->value, sizeof(label->value));
     }
-   
+
     return true;
 }
 
-// passNum starting from 1
-bool makeAssemblyPass(Assembler* assembler, size_t passNum)
+// the code is compacted unless it's --wide, labels are moved to the compact offsets
+bool writeBytecodeFile(Assembler* assembler)
 {
     assert(assembler               != NULL);
-    assert(assembler->assembly     != NULL);
     assert(assembler->bytecode     != NULL);
     assert(assembler->bytecodeFile != NULL);
 
-    resetTextToStart(assembler->assembly);
-    assembler->bytecode->iteratorPos = 0;
+    size_t numOfBytesToWrite = assembler->bytecode->iteratorPos;
+    if (assembler->isWide)
+    {
+        if (fwrite(assembler->bytecode->data, sizeof(char), numOfBytesToWrite, assembler->bytecodeFile) != numOfBytesToWrite)
+        {
+            fprintf(assembler->messages, "Couldn't write to file.\n");
+            return false;
+        }
+
+        return writeLabelsFile(assembler, NULL);
+    }
+
+    BytecodeImage image = {};
+    if (!compactAssembledCode(assembler, &image)) { return false; }
+
+    bool isWritten = writeBytecode(assembler->bytecodeFile, &image);
+    if (!isWritten) { fprintf(assembler->messages, "Couldn't write to file.\n"); }
+
+    isWritten = isWritten && writeLabelsFile(assembler, &image);
+    clearBytecodeImage(&image);
+
+    return isWritten;
+}
+
+bool compactAssembledCode(Assembler* assembler, BytecodeImage* image)
+{
+    assert(assembler           != NULL);
+    assert(assembler->bytecode != NULL);
+    assert(image               != NULL);
 
-    const char* currLine = NULL;
-    while ((currLine = nextTextLine(assembler->assembly)) != NULL)
+    if (!compactBytecode((const unsigned char*) assembler->bytecode->data, assembler->bytecode->iteratorPos,
+                         assembler->literalTargets, assembler->literalTargetsCount, image))
     {
-        if (!translateAssemblyLine(assembler, currLine, passNum)) { return false; }
+        if (image->failedOffset == BYTECODE_NO_OFFSET) { fprintf(assembler->messages, "Not enough memory to compact the bytecode.\n"); }
+        else
+        {
+            fprintf(assembler->messages, "Syntax ERROR: target of '%s' at bytecode offset %zu isn't the start of an instruction\n",
+                    getInstructionName((unsigned char) assembler->bytecode->data[image->failedOffset]), image->failedOffset);
+        }
+
+        clearBytecodeImage(image);
+        return false;
     }
 
     return true;
 }
 
-bool translateAssemblyLine(Assembler* assembler, const char* line, size_t passNum)
+// image is NULL if the code isn't compacted
+bool writeLabelsFile(Assembler* assembler, const BytecodeImage* image)
+{
+    assert(assembler             != NULL);
+    assert(assembler->labels     != NULL);
+    assert(assembler->labelsFile != NULL);
+
+    for (size_t i = 0; i < assembler->labels->count; i++)
+    {
+        Label  label  = assembler->labels->labels[i];
+        size_t offset = image != NULL ? mapWideOffset(image, (size_t) label.value) : (size_t) label.value;
+
+        if (fprintf(assembler->labelsFile, "%zu %s\n", offset, label.name) < 0)
+        {
+            fprintf(assembler->messages, "Couldn't write to labels file.\n");
+            return false;
+        }
+    }
+
+    return true;
+}
+
+// all labels go into the symbols of the object, every fixup becomes a relocation
+bool writeObject(Assembler* assembler)
+{
+    assert(assembler               != NULL);
+    assert(assembler->labels       != NULL);
+    assert(assembler->exports      != NULL);
+    assert(assembler->bytecodeFile != NULL);
+
+    for (size_t i = 0; i < assembler->exports->count; i++)
+    {
+        Label exported = assembler->exports->labels[i];
+        if (findLabel(assembler->labels, exported.name) == NULL)
+        {
+            fprintf(assembler->messages, "Syntax ERROR: exported label '%s' isn't defined: line %zu\n", exported.name, (size_t) exported.value);
+            return false;
+        }
+    }
+
+    ObjectFile object       = {};
+    object.code             = (unsigned char*) assembler->bytecode->data;
+    object.codeSize         = assembler->bytecode->iteratorPos;
+    object.symbolsCount     = assembler->labels->count;
+    object.relocationsCount = assembler->fixupsCount;
+    object.symbols          = (ObjectSymbol*)     calloc(object.symbolsCount + 1,     sizeof(ObjectSymbol));
+    object.relocations      = (ObjectRelocation*) calloc(object.relocationsCount + 1, sizeof(ObjectRelocation));
+
+    bool isWritten = false;
+    if (object.symbols != NULL && object.relocations != NULL)
+    {
+        for (size_t i = 0; i < object.symbolsCount; i++)
+        {
+            Label label = assembler->labels->labels[i];
+
+            object.symbols[i].name       = label.name;
+            object.symbols[i].offset     = (size_t) label.value;
+            object.symbols[i].isExported = findLabel(assembler->exports, label.name) != NULL;
+        }
+
+        for (size_t i = 0; i < object.relocationsCount; i++)
+        {
+            object.relocations[i].name       = assembler->fixups[i].labelName;
+            object.relocations[i].offset     = assembler->fixups[i].offset;
+            object.relocations[i].lineNumber = assembler->fixups[i].lineNumber;
+        }
+
+        isWritten = writeObjectFile(assembler->bytecodeFile, &object);
+    }
+
+    free(object.symbols);
+    free(object.relocations);
+
+    if (!isWritten) { fprintf(assembler->messages, "Couldn't write to object file.\n"); }
+
+    return isWritten;
+}
+
+bool translateAssemblyLine(Assembler* assembler, const char* line)
 {
     assert(assembler != NULL);
     assert(line      != NULL);
-    static char tempLineCopy[MAX_LINE_LENGTH];
-    strcpy(tempLineCopy, line);
-
-    const char* commentStart = strchr(tempLineCopy, ';');
-
-    char* currToken = strtok((char*) tempLineCopy, TOKEN_DELIMS);
-    if (currToken == NULL || (commentStart != NULL && currToken >= commentStart)) { return true; }
-
-    char* cmd = currToken;
-
-    #define DEFINE_CMD(name, number, args, isControlFlow, code) \
-            if (strcmp(cmd, #name) == 0)                                                                     \
-            {                                                                                                \
-                pushBack(assembler->bytecode, CPU_CMD_##name);                                               \
-                currToken = strtok(NULL, TOKEN_DELIMS);                                                      \
-                for (size_t i = 0; i < args; i++, currToken = strtok(NULL, " ;\t"))                          \
-                    if (!processArgument(assembler, isControlFlow, currToken, passNum))                      \
-                        return false;                                                                        \
-                                                                                                             \
-                size_t extraArgsCount = getExtraArgsCount(currToken, commentStart);                          \
-                if (extraArgsCount != 0)                                                                     \
-                {                                                                                            \
-                    PRINT_ERROR2("invalid number of arguments: %d instead of %d: ",                          \
-                                 args + extraArgsCount, args);                                               \
-                }                                                                                            \
-                                                                                                             \
-            }                                                                                                \
-            else                                                                                                                                                                      
-  
-    #include "cpu_commands.h"
-    /* else */ 
-    {
-        size_t labelLength = strlen(cmd);
-        if (cmd[labelLength - 1] == ':')
+
+    const char* cursor = line;
+
+    Token cmd = nextToken(&cursor);
+    if (cmd.length == 0) { return true; }
+
+    const InstructionDescriptor* mnemonic = findMnemonic(cmd.start, cmd.length);
+    if (mnemonic != NULL)
+    {
+        // comma-separated operands select the register form: "add rdx, rbx, 5" is add_r
+        bool isOperandList = hasOperandList(cursor);
+        if (isOperandList) { findRegisterMnemonic(cmd, &mnemonic); }
+
+        pushBack(assembler->bytecode, mnemonic->opcode);
+
+        for (size_t i = 0; i < mnemonic->argsCount; i++)
         {
-            if (!processLabel(assembler, labelLength, cmd, passNum)) { return false; }
-        } 
-        else
+            Token arg = isOperandList ? nextOperand(&cursor) : nextToken(&cursor);
+            if (arg.length == 0)
+            {
+                PRINT_ERROR2("invalid number of arguments: %zu instead of %zu: ", i, mnemonic->argsCount);
+            }
+
+            bool isTarget = mnemonic->operands[i] == OPERAND_TARGET;
+
+            if (!checkOperand(assembler, mnemonic, i, arg))         { return false; }
+            if (!processArgument(assembler, isTarget, arg))         { return false; }
+        }
+
+        size_t extraArgsCount = isOperandList ? countOperands(cursor) : countTokens(cursor);
+        if (extraArgsCount != 0)
         {
-            PRINT_ERROR1("unrecognized command '%s': ", cmd);
+            PRINT_ERROR2("invalid number of arguments: %zu instead of %zu: ",
+                         mnemonic->argsCount + extraArgsCount, mnemonic->argsCount);
         }
     }
-    #undef DEFINE_CMD   
+    else if (cmd.start[0] == '.')
+    {
+        if (!processDirective(assembler, cmd, &cursor)) { return false; }
+    }
+    else if (cmd.start[cmd.length - 1] == ':')
+    {
+        if (!processLabel(assembler, cmd, &cursor)) { return false; }
+    }
+    else
+    {
+        PRINT_ERROR2("unrecognized command '%.*s': ", (int) cmd.length, cmd.start);
+    }
+
+    return true;
+}
+
+// tokens are separated by spaces and tabs, a ';' starts a comment till the end of the line
+Token nextToken(const char** cursor)
+{
+    assert(cursor  != NULL);
+    assert(*cursor != NULL);
+
+    const char* start = *cursor;
+    while (*start == ' ' || *start == '\t') { start++; }
+
+    const char* end = start;
+    while (*end != '\0' && *end != ' ' && *end != '\t' && *end != ';') { end++; }
+
+    *cursor = end;
+
+    return { start, (size_t) (end - start) };
+}
+
+size_t countTokens(const char* cursor)
+{
+    assert(cursor != NULL);
+
+    size_t tokensCount = 0;
+    while (nextToken(&cursor).length != 0) { tokensCount++; }
+
+    return tokensCount;
+}
+
+bool hasOperandList(const char* cursor)
+{
+    assert(cursor != NULL);
+
+    return cursor[strcspn(cursor, ",;")] == ',';
+}
+
+// operands are separated by commas, spaces around them are skipped
+Token nextOperand(const char** cursor)
+{
+    assert(cursor  != NULL);
+    assert(*cursor != NULL);
+
+    const char* start = *cursor;
+    while (*start == ' ' || *start == '\t') { start++; }
+
+    const char* end = start + strcspn(start, ",;");
+    *cursor = *end == ',' ? end + 1 : end;
+
+    while (end > start && (end[-1] == ' ' || end[-1] == '\t')) { end--; }
+
+    return { start, (size_t) (end - start) };
+}
+
+size_t countOperands(const char* cursor)
+{
+    assert(cursor != NULL);
+
+    size_t operandsCount = 0;
+    while (nextOperand(&cursor).length != 0) { operandsCount++; }
+
+    return operandsCount;
+}
+
+// mnemonic is left as it is if the command has no register form (e.g. mov)
+bool findRegisterMnemonic(Token cmd, const InstructionDescriptor** mnemonic)
+{
+    assert(mnemonic != NULL);
+
+    char   name[MAX_MNEMONIC_LENGTH] = {};
+    size_t suffixLength              = strlen(REGISTER_INSTRUCTION_SUFFIX);
+    if (cmd.length + suffixLength >= sizeof(name)) { return false; }
+
+    memcpy(name, cmd.start, cmd.length);
+    memcpy(name + cmd.length, REGISTER_INSTRUCTION_SUFFIX, suffixLength);
+
+    const InstructionDescriptor* registerMnemonic = findMnemonic(name, cmd.length + suffixLength);
+    if (registerMnemonic == NULL) { return false; }
+
+    *mnemonic = registerMnemonic;
 
     return true;
 }
 
-bool processArgument(Assembler* assembler, bool isControlFlow, char* currToken, size_t passNum)
+// pop writes to a register or to RAM, the destination of a register instruction is a register,
+// the sources are registers and numbers
+bool checkOperand(Assembler* assembler, const InstructionDescriptor* mnemonic, size_t index, Token operand)
 {
     assert(assembler != NULL);
-    assert(currToken != NULL);
+    assert(mnemonic  != NULL);
 
-    if (!isValidNumericToken(currToken))                                                     
-    {                                                                                        
-        if (!processCompoundToken(assembler, isControlFlow, currToken, passNum))                   
-            return false;                                                                    
-    }                                                                                        
-    else { processNumbericToken(assembler, currToken); }    
+    if (mnemonic->operands[index] == OPERAND_POP && operand.start[0] != '[' && !isValidRegisterToken(operand))
+    {
+        PRINT_ERROR2("pop destination '%.*s' is neither a register nor in ram: ", (int) operand.length, operand.start);
+    }
 
-    return true;                                 
+    if (!mnemonic->isRegister) { return true; }
+
+    if (mnemonic->operands[index] == OPERAND_DESTINATION && !isValidRegisterToken(operand))
+    {
+        PRINT_ERROR2("destination '%.*s' isn't a register: ", (int) operand.length, operand.start);
+    }
+
+    if (operand.start[0] == '[') { PRINT_ERROR("register instructions don't take ram arguments: "); }
+
+    return true;
 }
 
-bool processCompoundToken(Assembler* assembler, bool isControlFlow, char* currToken, size_t passNum)
+// .global <label> exports the label from the object file, without -c it has no effect
+bool processDirective(Assembler* assembler, Token directive, const char** cursor)
 {
     assert(assembler != NULL);
-    assert(currToken != NULL);
+    assert(cursor    != NULL);
 
-    double temp = 0;
+    if (directive.length != strlen(".global") || strncmp(directive.start, ".global", directive.length) != 0)
+    {
+        PRINT_ERROR2("unrecognized directive '%.*s': ", (int) directive.length, directive.start);
+    }
+
+    Token name = nextToken(cursor);
+    if (name.length == 0) { PRINT_ERROR("no label name after .global: "); }
+
+    if (countTokens(*cursor) != 0) { PRINT_ERROR("only one label can be exported by .global: "); }
 
-    if (isControlFlow && currToken[0] != ':')                                     
-    {                                                                                
-        PRINT_ERROR("invalid label indicator, no ':' found: ");                                                          
-    }                                                                     
-                                                                                  
-    Label* label = getLabel(assembler, &currToken[1]);                            
-                                                                                  
-    if (isControlFlow &&                                                
-        passNum > 1   &&                                                
-        label != NULL)                                                            
-    {                                                                             
-        pushBack(assembler->bytecode, CPU_ARGUMENT_TYPE_CST);         
-        pushBack(assembler->bytecode, &(label->value), sizeof(temp));           
-    }                                                                             
-    else if (isControlFlow &&                                                     
-             passNum > 1)                                             
-    {                                                                                      
-        PRINT_ERROR1("no label '%s' found: ", &currToken[1]);                                                             
-    }                                                                             
-    else if (isControlFlow)                                                       
-    {                                                                             
-        temp = -1;                                                                
-        pushBack(assembler->bytecode, CPU_ARGUMENT_TYPE_CST);               
-        pushBack(assembler->bytecode, &temp, sizeof(temp));                       
-    }                                                                             
-    else                                                                          
-    {                                                                             
-        if (!processCompoundArgument(assembler, currToken)) { return false; };                   
-    } 
-
-    return true;                                                                            
-}
-
-void processNumbericToken(Assembler* assembler, char* currToken)
+    if (findLabel(assembler->exports, name.start, name.length) == NULL &&
+        addLabel(assembler->exports, name.start, name.length, (double) assembler->currLineNumber) == NULL)
+    {
+        PRINT_ERROR("not enough memory for exported label: ");
+    }
+
+    return true;
+}
+
+bool processArgument(Assembler* assembler, bool isControlFlow, Token token)
 {
     assert(assembler != NULL);
-    assert(currToken != NULL);
 
     double temp = 0;
+    if (parseNumericToken(token, &temp))
+    {
+        if (isControlFlow && assembler->isObject) { PRINT_ERROR("numeric jump targets can't be relocated: "); }
 
-    sscanf(currToken, "%lg", &temp);                                                   
-    pushBack(assembler->bytecode, CPU_ARGUMENT_TYPE_CST);               
-    pushBack(assembler->bytecode, &temp, sizeof(temp));                                
+        pushBack(assembler->bytecode, CPU_ARGUMENT_TYPE_CST);
+        if (isControlFlow && !addLiteralTarget(assembler)) { PRINT_ERROR("not enough memory for jump target: "); }
+        pushBack(assembler->bytecode, &temp, sizeof(temp));
+    }
+    else if (!processCompoundToken(assembler, isControlFlow, token)) { return false; }
+
+    return true;
 }
 
-bool processCompoundArgument(Assembler* assembler, char* currArg)
+bool processCompoundToken(Assembler* assembler, bool isControlFlow, Token token)
 {
     assert(assembler != NULL);
-    assert(currArg   != NULL);
 
-    bool isRam = currArg[0] == '['; 
-    if (isRam) { currArg++; }; // to skip '['
+    if (!isControlFlow) { return processCompoundArgument(assembler, token); }
 
-    char*  firstArg        = strtok(currArg, "+");
-    char*  secondArg       = strtok(NULL, "+");
-    size_t firstArgLength  = strlen(firstArg);
-    size_t secondArgLength = 0;
+    if (token.start[0] != ':')
+    {
+        PRINT_ERROR("invalid label indicator, no ':' found: ");
+    }
+
+    const char* labelName   = token.start  + 1;
+    size_t      labelLength = token.length - 1;
+
+    Label* label = findLabel(assembler->labels, labelName, labelLength);
+    double temp  = label != NULL ? label->value : -1;
+
+    pushBack(assembler->bytecode, CPU_ARGUMENT_TYPE_CST);
+    if ((label == NULL || assembler->isRelocatable) && !addFixup(assembler, labelName, labelLength)) { PRINT_ERROR("not enough memory for label reference: "); }
+    pushBack(assembler->bytecode, &temp, sizeof(temp));
 
-    if (secondArg == NULL && isRam)
+    return true;
+}
+
+// [register + const], [register], [const], register + const or register
+bool processCompoundArgument(Assembler* assembler, Token arg)
+{
+    assert(assembler != NULL);
+
+    bool isRam = arg.start[0] == '[';
+    if (isRam)
     {
-        if (firstArg[firstArgLength - 1] != ']') { PRINT_ERROR("no ']' found in ram argument: "); }
+        if (arg.length < 2 || arg.start[arg.length - 1] != ']') { PRINT_ERROR("no ']' found in ram argument: "); }
 
-        firstArg[firstArgLength - 1] = '\0';
+        arg.start++;
+        arg.length -= 2;
     }
-    else if (isRam)
-    {
-        secondArgLength = strlen(secondArg);
 
-        if (secondArg[secondArgLength - 1] != ']') { PRINT_ERROR("no ']' found in ram argument: "); }
+    const char* plus      = (const char*) memchr(arg.start, '+', arg.length);
+    Token       firstArg  = { arg.start, plus != NULL ? (size_t) (plus - arg.start) : arg.length };
+    Token       secondArg = {};
+    if (plus != NULL) { secondArg = { plus + 1, arg.length - firstArg.length - 1 }; }
 
-        secondArg[secondArgLength - 1] = '\0';
-    }
+    double firstValue  = 0;
+    double secondValue = 0;
+    bool   is1stNum    = parseNumericToken(firstArg, &firstValue);
+    bool   is1stReg    = isValidRegisterToken(firstArg);
+    bool   is2ndNum    = plus != NULL && parseNumericToken(secondArg, &secondValue);
+    bool   is2ndReg    = plus != NULL && isValidRegisterToken(secondArg);
 
-    bool is1stNum = isValidNumericToken(firstArg);
-    bool is1stReg = isValidRegisterToken(firstArg);
-    bool is2ndNum = isValidNumericToken(secondArg);
-    bool is2ndReg = isValidRegisterToken(secondArg);
+    if ((!is1stNum && !is1stReg) || (plus != NULL && !is2ndNum && !is2ndReg))
+    {
+        PRINT_ERROR("invalid argument: ");
+    }
 
     if ((is1stNum && is2ndNum) || (is1stReg && is2ndReg))
     {
@@ -327,149 +797,148 @@ bool processCompoundArgument(Assembler* assembler, char* currArg)
     if (is1stNum || is2ndNum) { argType |= CPU_ARGUMENT_MASK_CST; }
     if (is1stReg || is2ndReg) { argType |= CPU_ARGUMENT_MASK_REG; }
 
-    if (argType == 0) { PRINT_ERROR("invalid argument: "); }
-
     pushBack(assembler->bytecode, argType);
 
-    double temp = 0;
-    if (isValidNumericToken(firstArg))
-    {
-        sscanf(firstArg, "%lg", &temp);                                                             
-        pushBack(assembler->bytecode, &temp, sizeof(temp));   
-    }
-    else if (isValidRegisterToken(firstArg))
-    {                                                                                  
-        pushBack(assembler->bytecode, firstArg[1] - 'a' + 1);
-    }
+    if (is1stNum) { pushBack(assembler->bytecode, &firstValue, sizeof(firstValue)); }
+    else          { pushBack(assembler->bytecode, firstArg.start[1] - 'a' + 1); }
 
-    if (secondArg != NULL)
-    {
-        if (isValidNumericToken(secondArg))
-        {
-            sscanf(secondArg, "%lg", &temp);                                                             
-            pushBack(assembler->bytecode, &temp, sizeof(temp));
-        }   
-        else if (isValidRegisterToken(secondArg))
-        {                                                                                 
-            pushBack(assembler->bytecode, secondArg[1] - 'a' + 1);
-        }
-    }
+    if (is2ndNum) { pushBack(assembler->bytecode, &secondValue, sizeof(secondValue)); }
 
     return true;
 }
 
-bool processLabel(Assembler* assembler, size_t labelLength, char* cmd, size_t passNum)
+bool processLabel(Assembler* assembler, Token label, const char** cursor)
 {
-    char* currToken = NULL;
+    assert(assembler != NULL);
+    assert(cursor    != NULL);
 
-    if ((currToken = strtok(NULL, TOKEN_DELIMS)) != NULL)
+    Token nextCmd = nextToken(cursor);
+    if (nextCmd.length != 0)
     {
-        PRINT_ERROR1("commands after label definition: '%s' ", currToken);
+        PRINT_ERROR2("commands after label definition: '%.*s' ", (int) nextCmd.length, nextCmd.start);
     }
-    else
+
+    size_t labelLength = label.length - 1; // without ':'
+    if (findLabel(assembler->labels, label.start, labelLength) != NULL)
     {
-        cmd[--labelLength] = '\0';
-        bool labelDefined = getLabel(assembler, cmd) != NULL;
-        if (passNum == 1 && labelDefined)
-        {
-            PRINT_ERROR1("label defined more than once: '%s': ", cmd);
-        }    
-        else if (passNum == 1)
-        {
-            createNewLabel(assembler, cmd, labelLength);
-        }
+        PRINT_ERROR2("label defined more than once: '%.*s': ", (int) labelLength, label.start);
     }
 
-    return true;
-}
-
-size_t currBytecodeOfs(Assembler* assembler)
-{
-    assert(assembler           != NULL);
-    assert(assembler->bytecode != NULL);
+    if (!createNewLabel(assembler, label.start, labelLength))
+    {
+        PRINT_ERROR("not enough memory for label: ");
+    }
 
-    return assembler->bytecode->iteratorPos - 1;
+    return true;
 }
 
-void createNewLabel(Assembler* assembler, const char* labelName, size_t labelLength)
+// the placeholder of the label value is going to be written at the current offset
+bool addFixup(Assembler* assembler, const char* labelName, size_t labelLength)
 {
     assert(assembler != NULL);
     assert(labelName != NULL);
 
-    Label newLabel = {};
-    newLabel.value = currBytecodeOfs(assembler) + 1;
+    if (assembler->fixupsCount == assembler->fixupsCapacity)
+    {
+        size_t capacity = assembler->fixupsCapacity == 0 ? DEFAULT_FIXUPS_CAPACITY : assembler->fixupsCapacity * 2;
+
+        Fixup* fixups = (Fixup*) realloc(assembler->fixups, capacity * sizeof(Fixup));
+        if (fixups == NULL) { return false; }
+
+        assembler->fixups         = fixups;
+        assembler->fixupsCapacity = capacity;
+    }
 
-    newLabel.name  = (char*) calloc(labelLength + 1, sizeof(char));
-    assert(newLabel.name != NULL);
+    Fixup* fixup = &assembler->fixups[assembler->fixupsCount];
+    fixup->offset     = currBytecodeOfs(assembler) + 1;
+    fixup->labelName  = arenaCopyString(&assembler->fixupNames, labelName, labelLength);
+    fixup->lineNumber = assembler->currLineNumber;
+    if (fixup->labelName == NULL) { return false; }
 
-    strcpy(newLabel.name, labelName);
-    newLabel.name[labelLength] = '\0';
+    assembler->fixupsCount++;
 
-    pushBack(assembler->labels, newLabel);
+    return true;
 }
 
-Label* getLabel(Assembler* assembler, const char* labelName)
+// the target is written as a number, so it's an offset in the compact code and isn't mapped
+bool addLiteralTarget(Assembler* assembler)
 {
     assert(assembler != NULL);
-    assert(labelName != NULL);
 
-    for (size_t i = 0; i < assembler->labels->iteratorPos; i++)
+    if (assembler->literalTargetsCount == assembler->literalTargetsCapacity)
     {
-        if (strcmp(get(assembler->labels, i).name, labelName) == 0) 
-        {
-            return at(assembler->labels, i);    
-        }       
+        size_t capacity = assembler->literalTargetsCapacity == 0 ? DEFAULT_TARGETS_CAPACITY : assembler->literalTargetsCapacity * 2;
+
+        size_t* literalTargets = (size_t*) realloc(assembler->literalTargets, capacity * sizeof(size_t));
+        if (literalTargets == NULL) { return false; }
+
+        assembler->literalTargets         = literalTargets;
+        assembler->literalTargetsCapacity = capacity;
     }
 
-    return NULL;
+    assembler->literalTargets[assembler->literalTargetsCount++] = currBytecodeOfs(assembler) + 1;
+
+    return true;
 }
 
-bool isValidNumericToken(const char* token)
+size_t currBytecodeOfs(Assembler* assembler)
 {
-    if (token == NULL) { return false; }
+    assert(assembler           != NULL);
+    assert(assembler->bytecode != NULL);
 
-    double temp = 0;
-    return sscanf(token, "%lg", &temp) == 1;
+    return assembler->bytecode->iteratorPos - 1;
 }
 
-bool isValidRegisterToken(const char* token)
+bool createNewLabel(Assembler* assembler, const char* labelName, size_t labelLength)
 {
-    if (token == NULL) { return false; }
+    assert(assembler != NULL);
+    assert(labelName != NULL);
 
-    return strlen(token) == 3                    && 
-           token[0] == 'r'                       && 
-           token[1] >= 'a'                       && 
-           token[1] <  'a' + CPU_REGISTERS_COUNT &&
-           token[2] == 'x';
+    return addLabel(assembler->labels, labelName, labelLength, currBytecodeOfs(assembler) + 1) != NULL;
 }
 
-size_t getExtraArgsCount(const char* start, const char* commentStart)
+// the whole token has to be a number: decimal, hexadecimal with 0x, inf or nan, optionally signed
+bool parseNumericToken(Token token, double* value)
 {
-    if (start == NULL || (commentStart != NULL && start >= commentStart))
-    {
-        return 0;
-    }
+    assert(value != NULL);
 
-    size_t extraArgsCount = 1;
+    const char* start = token.start;
+    const char* end   = token.start + token.length;
+    if (start == end) { return false; }
 
-    char* currToken = strtok(NULL, TOKEN_DELIMS);
+    bool isNegative = *start == '-';
+    if (*start == '-' || *start == '+') { start++; }
 
-    while (currToken != NULL)
+    std::chars_format format = std::chars_format::general;
+    if (end - start > 2 && start[0] == '0' && (start[1] == 'x' || start[1] == 'X'))
     {
-        if (commentStart != NULL && currToken >= commentStart) { break; }
+        format = std::chars_format::hex;
+        start += 2;
+    }
 
-        extraArgsCount++;
+    // from_chars takes neither '+' nor a second sign
+    if (start == end || *start == '-' || *start == '+') { return false; }
 
-        currToken = strtok(NULL, TOKEN_DELIMS);
-    }
+    std::from_chars_result result = std::from_chars(start, end, *value, format);
+    if (result.ec != std::errc() || result.ptr != end) { return false; }
+
+    if (isNegative) { *value = -*value; }
 
-    return extraArgsCount;
+    return true;
+}
+
+bool isValidRegisterToken(Token token)
+{
+    return token.length == 3                                 &&
+           token.start[0] == 'r'                             &&
+           token.start[1] >= 'a'                             &&
+           token.start[1] <  'a' + (int) CPU_REGISTERS_COUNT &&
+           token.start[2] == 'x';
 }
 
 void printCurrentLine(Assembler* assembler)
 {
-    size_t currLineNumber = getCurrentLineNumber(assembler->assembly);
-    printf("line %u\n%5u | %s\n", currLineNumber + 1, 
-                                  currLineNumber + 1, 
-                                  getLine(assembler->assembly, currLineNumber));
+    fprintf(assembler->messages, "line %zu\n%5zu | %s\n", assembler->currLineNumber,
+                                                          assembler->currLineNumber,
+                                                          assembler->currLine);
 }
\ No newline at end of file
@@ -0,0 +1,293 @@
+#include <assert.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <thread>
+
+#include "../libs/file_manager.h"
+#include "assembler_batch.h"
+#include "assembler_specification.h"
+
+const size_t DEFAULT_JOBS_CAPACITY = 16;
+const size_t MESSAGES_CHUNK_SIZE   = 4096;
+
+bool                addAssemblyJob    (AssemblerBatch* batch, const char* assemblyFileName, const char* bytecodeFileName);
+AssemblerBatchError readManifest      (AssemblerBatch* batch, const char* manifestFileName);
+void                runAssemblyWorker (AssemblerBatch* batch);
+void                assembleJob       (AssemblerBatch* batch, AssemblyJob* job, FILE* messages);
+void                printJobMessages  (AssemblerBatch* batch, const AssemblyJob* job, FILE* messages);
+
+bool isAssemblerBatch(int argc, char* argv[])
+{
+    if (argv == NULL) { return false; }
+
+    size_t fileNamesCount = 0;
+    for (int i = 1; i < argc; i++)
+    {
+        if (strcmp(argv[i], "--manifest") == 0 || strcmp(argv[i], "-j") == 0) { return true; }
+        if (argv[i][0] != '-') { fileNamesCount++; }
+    }
+
+    return fileNamesCount > 2;
+}
+
+#define BATCH_INIT_ERROR(error) printf("Assembler error: %s\n", #error); return error;
+
+AssemblerBatchError initAssemblerBatch(AssemblerBatch* batch, int argc, char* argv[])
+{
+    if (batch == NULL || argv == NULL) { BATCH_INIT_ERROR(ASSEMBLER_BATCH_NULL_PTR_PARAMETER); }
+
+    const char* pairedFileName = NULL;
+    for (int i = 1; i < argc; i++)
+    {
+        if      (strcmp(argv[i], "-O")     == 0) { batch->isOptimized = true; }
+        else if (strcmp(argv[i], "-c")     == 0) { batch->isObject    = true; }
+        else if (strcmp(argv[i], "--wide") == 0) { batch->isWide      = true; }
+        else if (strcmp(argv[i], "-j") == 0)
+        {
+            char* end = NULL;
+            if (i + 1 < argc) { batch->threadsCount = strtoul(argv[++i], &end, 10); }
+            if (end == NULL || *end != '\0' || batch->threadsCount == 0) { BATCH_INIT_ERROR(ASSEMBLER_BATCH_INVALID_OPTION); }
+        }
+        else if (strcmp(argv[i], "--manifest") == 0)
+        {
+            if (i + 1 == argc) { BATCH_INIT_ERROR(ASSEMBLER_BATCH_INVALID_OPTION); }
+
+            AssemblerBatchError manifestError = readManifest(batch, argv[++i]);
+            if (manifestError != ASSEMBLER_BATCH_NO_ERROR) { return manifestError; }
+        }
+        else if (argv[i][0] == '-')
+        {
+            printf("Unknown option '%s'.\n", argv[i]);
+            BATCH_INIT_ERROR(ASSEMBLER_BATCH_INVALID_OPTION);
+        }
+        else if (pairedFileName == NULL)
+        {
+            pairedFileName = argv[i];
+        }
+        else
+        {
+            if (!addAssemblyJob(batch, pairedFileName, argv[i])) { BATCH_INIT_ERROR(ASSEMBLER_BATCH_NOT_ENOUGH_MEMORY); }
+            pairedFileName = NULL;
+        }
+    }
+
+    if (pairedFileName != NULL)
+    {
+        printf("No bytecode file for '%s'.\n", pairedFileName);
+        BATCH_INIT_ERROR(ASSEMBLER_BATCH_UNPAIRED_FILE);
+    }
+
+    if (batch->threadsCount == 0) { batch->threadsCount = std::thread::hardware_concurrency(); }
+    if (batch->threadsCount == 0) { batch->threadsCount = 1; }
+    if (batch->threadsCount > batch->jobsCount && batch->jobsCount != 0) { batch->threadsCount = batch->jobsCount; }
+
+    return ASSEMBLER_BATCH_NO_ERROR;
+}
+
+void finishAssemblerBatch(AssemblerBatch* batch)
+{
+    assert(batch != NULL);
+
+    free(batch->jobs);
+    batch->jobs         = NULL;
+    batch->jobsCount    = 0;
+    batch->jobsCapacity = 0;
+
+    clearArena(&batch->fileNames);
+}
+
+// the calling thread is one of the workers
+size_t runAssemblerBatch(AssemblerBatch* batch)
+{
+    assert(batch != NULL);
+
+    batch->nextJob.store(0, std::memory_order_relaxed);
+
+    std::thread* workers = new std::thread[batch->threadsCount - 1];
+    for (size_t i = 0; i + 1 < batch->threadsCount; i++)
+    {
+        workers[i] = std::thread(runAssemblyWorker, batch);
+    }
+
+    runAssemblyWorker(batch);
+
+    for (size_t i = 0; i + 1 < batch->threadsCount; i++)
+    {
+        workers[i].join();
+    }
+
+    delete[] workers;
+
+    size_t failedCount = 0;
+    for (size_t i = 0; i < batch->jobsCount; i++)
+    {
+        if (!batch->jobs[i].isAssembled) { failedCount++; }
+    }
+
+    printf("Assembled %zu of %zu files on %zu threads.\n", batch->jobsCount - failedCount, batch->jobsCount, batch->threadsCount);
+
+    return failedCount;
+}
+
+bool addAssemblyJob(AssemblerBatch* batch, const char* assemblyFileName, const char* bytecodeFileName)
+{
+    assert(batch            != NULL);
+    assert(assemblyFileName != NULL);
+    assert(bytecodeFileName != NULL);
+
+    if (batch->jobsCount == batch->jobsCapacity)
+    {
+        size_t       newCapacity = batch->jobsCapacity == 0 ? DEFAULT_JOBS_CAPACITY : 2 * batch->jobsCapacity;
+        AssemblyJob* newJobs     = (AssemblyJob*) realloc(batch->jobs, newCapacity * sizeof(AssemblyJob));
+        if (newJobs == NULL) { return false; }
+
+        batch->jobs         = newJobs;
+        batch->jobsCapacity = newCapacity;
+    }
+
+    AssemblyJob* job      = &batch->jobs[batch->jobsCount++];
+    job->assemblyFileName = assemblyFileName;
+    job->bytecodeFileName = bytecodeFileName;
+    job->isAssembled      = false;
+
+    return true;
+}
+
+AssemblerBatchError readManifest(AssemblerBatch* batch, const char* manifestFileName)
+{
+    assert(batch            != NULL);
+    assert(manifestFileName != NULL);
+
+    Text* manifest = readTextFromFile(manifestFileName);
+    if (manifest == NULL) { BATCH_INIT_ERROR(ASSEMBLER_BATCH_MANIFEST_READ_ERROR); }
+
+    const char* SEPARATORS = " \t\r\n";
+
+    AssemblerBatchError error      = ASSEMBLER_BATCH_NO_ERROR;
+    const char*         currLine   = NULL;
+    size_t              lineNumber = 0;
+    while (error == ASSEMBLER_BATCH_NO_ERROR && (currLine = nextTextLine(manifest)) != NULL)
+    {
+        lineNumber++;
+
+        const char* fileNames[2]       = {};
+        size_t      fileNamesLength[2] = {};
+        size_t      fileNamesCount     = 0;
+
+        const char* cursor = currLine + strspn(currLine, SEPARATORS);
+        while (*cursor != '\0' && *cursor != ';' && fileNamesCount < 3)
+        {
+            size_t length = strcspn(cursor, " \t\r\n;");
+            if (fileNamesCount < 2)
+            {
+                fileNames[fileNamesCount]       = cursor;
+                fileNamesLength[fileNamesCount] = length;
+            }
+
+            fileNamesCount++;
+            cursor += length;
+            cursor += strspn(cursor, SEPARATORS);
+        }
+
+        if (fileNamesCount == 0) { continue; }
+
+        if (fileNamesCount != 2)
+        {
+            printf("Manifest ERROR: expected '<assembly file> <bytecode file>': line %zu\n", lineNumber);
+            error = ASSEMBLER_BATCH_INVALID_MANIFEST;
+            break;
+        }
+
+        char* assemblyFileName = arenaCopyString(&batch->fileNames, fileNames[0], fileNamesLength[0]);
+        char* bytecodeFileName = arenaCopyString(&batch->fileNames, fileNames[1], fileNamesLength[1]);
+        if (assemblyFileName == NULL || bytecodeFileName == NULL || !addAssemblyJob(batch, assemblyFileName, bytecodeFileName))
+        {
+            error = ASSEMBLER_BATCH_NOT_ENOUGH_MEMORY;
+        }
+    }
+
+    deleteText(manifest);
+
+    if (error == ASSEMBLER_BATCH_NOT_ENOUGH_MEMORY) { BATCH_INIT_ERROR(ASSEMBLER_BATCH_NOT_ENOUGH_MEMORY); }
+
+    return error;
+}
+
+// messages of a job are written into a temporary file of the worker and printed when it's done
+void runAssemblyWorker(AssemblerBatch* batch)
+{
+    assert(batch != NULL);
+
+    FILE* messages = tmpfile();
+
+    size_t jobIndex = 0;
+    while ((jobIndex = batch->nextJob.fetch_add(1, std::memory_order_relaxed)) < batch->jobsCount)
+    {
+        AssemblyJob* job = &batch->jobs[jobIndex];
+
+        if (messages == NULL)
+        {
+            // the messages of files running at the same time can be mixed then
+            assembleJob(batch, job, stdout);
+            continue;
+        }
+
+        rewind(messages);
+        assembleJob(batch, job, messages);
+        printJobMessages(batch, job, messages);
+    }
+
+    if (messages != NULL) { fclose(messages); }
+}
+
+void assembleJob(AssemblerBatch* batch, AssemblyJob* job, FILE* messages)
+{
+    assert(batch    != NULL);
+    assert(job      != NULL);
+    assert(messages != NULL);
+
+    char* assemblerArgv[7] = { (char*) "asm+", (char*) job->assemblyFileName, (char*) job->bytecodeFileName };
+    int   assemblerArgc    = 3;
+    if (batch->isOptimized) { assemblerArgv[assemblerArgc++] = (char*) "-O"; }
+    if (batch->isObject)    { assemblerArgv[assemblerArgc++] = (char*) "-c"; }
+    if (batch->isWide)      { assemblerArgv[assemblerArgc++] = (char*) "--wide"; }
+
+    Assembler assembler = {};
+    assembler.messages  = messages;
+
+    job->isAssembled = initAssembler(&assembler, assemblerArgc, assemblerArgv) == ASSEMBLER_INIT_NO_ERROR &&
+                       translateAssemblyFile(&assembler);
+
+    finishAssembler(&assembler);
+}
+
+// only the files with errors or notes are printed
+void printJobMessages(AssemblerBatch* batch, const AssemblyJob* job, FILE* messages)
+{
+    assert(batch    != NULL);
+    assert(job      != NULL);
+    assert(messages != NULL);
+
+    long messagesSize = ftell(messages);
+    if (messagesSize <= 0) { return; }
+
+    rewind(messages);
+
+    std::lock_guard<std::mutex> outputGuard(batch->outputLock);
+
+    printf("%s:\n", job->assemblyFileName);
+
+    char   chunk[MESSAGES_CHUNK_SIZE] = {};
+    size_t leftSize                   = (size_t) messagesSize;
+    while (leftSize != 0)
+    {
+        size_t chunkSize = fread(chunk, sizeof(char), leftSize < sizeof(chunk) ? leftSize : sizeof(chunk), messages);
+        if (chunkSize == 0) { break; }
+
+        fwrite(chunk, sizeof(char), chunkSize, stdout);
+        leftSize -= chunkSize;
+    }
+
+    if (!job->isAssembled) { printf("Assembler finished with an error.\n"); }
+}
@@ -0,0 +1,53 @@
+#pragma once
+#include <stddef.h>
+#include <atomic>
+#include <mutex>
+#include "arena.h"
+
+// Batch mode of asm+: many files are assembled in one process by a pool of threads, every
+// thread takes the next file until none are left. Assemblers don't share any state, only the
+// messages of a file are collected and printed at once, so the output of files isn't mixed.
+//
+//     asm+ a.asy a.bsy b.asy b.bsy ... [-j <threads>] [-O] [-c]
+//     asm+ --manifest <file> [-j <threads>] [-O] [-c]
+//
+// The manifest has an "<assembly file> <bytecode file>" pair on every line, ';' starts a comment.
+
+enum AssemblerBatchError
+{
+    ASSEMBLER_BATCH_NO_ERROR,
+    ASSEMBLER_BATCH_NULL_PTR_PARAMETER,
+    ASSEMBLER_BATCH_INVALID_OPTION,
+    ASSEMBLER_BATCH_UNPAIRED_FILE,
+    ASSEMBLER_BATCH_MANIFEST_READ_ERROR,
+    ASSEMBLER_BATCH_INVALID_MANIFEST,
+    ASSEMBLER_BATCH_NOT_ENOUGH_MEMORY
+};
+
+struct AssemblyJob
+{
+    const char* assemblyFileName = NULL;
+    const char* bytecodeFileName = NULL;
+    bool        isAssembled      = false;
+};
+
+struct AssemblerBatch
+{
+    AssemblyJob*        jobs          = NULL;
+    size_t              jobsCount     = 0;
+    size_t              jobsCapacity  = 0;
+    Arena               fileNames     = {}; // names read from the manifest
+
+    size_t              threadsCount  = 0;  // -j, the number of cores by default
+    bool                isOptimized   = false;
+    bool                isObject      = false;
+    bool                isWide        = false;
+
+    std::atomic<size_t> nextJob       {0};
+    std::mutex          outputLock;
+};
+
+bool                isAssemblerBatch     (int argc, char* argv[]);
+AssemblerBatchError initAssemblerBatch   (AssemblerBatch* batch, int argc, char* argv[]);
+void                finishAssemblerBatch (AssemblerBatch* batch);
+size_t              runAssemblerBatch    (AssemblerBatch* batch); // returns the number of failed files
@@ -1,9 +1,17 @@
 #pragma once
 #include "../libs/file_manager.h"
+#include "bytecode.h"
+#include "label_table.h"
+#include "object_file.h"
+#include "optimizer.h"
 
 typedef char da_elem_t;
 #include "../libs/dynamic_array.h"
 
+// raised whenever the same source is assembled into different code, builds cached with an older
+// assembler are keyed by the old version and aren't used
+static const uint32_t ASSEMBLER_VERSION = 1;
+
 enum AssemblerInitError
 {
 	ASSEMBLER_INIT_NO_ERROR,
@@ -13,32 +21,54 @@ enum AssemblerInitError
 	ASSEMBLER_INIT_BCD_FILE_UNSPECIFIED,
 	ASSEMBLER_INIT_NOT_ENOUGH_MEMORY,
 	ASSEMBLER_INIT_ASSEMBLY_FILE_READ_ERROR,
-	ASSEMBLER_INIT_BYTECODE_FILE_WRITE_ERROR
+	ASSEMBLER_INIT_BYTECODE_FILE_WRITE_ERROR,
+	ASSEMBLER_INIT_LABELS_FILE_WRITE_ERROR
 };
 
-const char* assemblerCommands[] = { 
-									#define DEFINE_CMD(name, number, args, isControlFlow, code) #name,
-									#include "cpu_commands.h"
-									#undef DEFINE_CMD	
-                                  };
 
-struct Label
+// part of the current line, tokens aren't copied out of it
+struct Token
 {
-	char*  name  = NULL;
-	double value = 0;
+    const char* start  = NULL;
+    size_t      length = 0; // 0 at the end of the line or at a comment
 };
 
-#undef DYNAMIC_ARRAY_H
-#include "label_array.h"
-
 struct Assembler
 {
-    Text*         assembly     = NULL;
-    FILE*         bytecodeFile = NULL;
-    DynamicArray* bytecode     = NULL;
-    LabelArray*   labels       = NULL;
+    FILE*          assemblyFile     = NULL;
+    FILE*          bytecodeFile     = NULL;
+    FILE*          labelsFile       = NULL;
+    FILE*          messages         = stdout; // diagnostics, every job of a batch has its own
+    const char*    source           = NULL;   // the source is in memory instead of assemblyFile
+    size_t         sourceSize       = 0;
+    size_t         sourcePos        = 0;
+    DynamicArray*  bytecode         = NULL;
+    LabelTable*    labels           = NULL;
+
+    char*          currLine         = NULL; // grows to the longest line
+    size_t         currLineCapacity = 0;
+    size_t         currLineNumber   = 0; // starting from 1
+
+    Fixup*         fixups           = NULL;
+    size_t         fixupsCount      = 0;
+    size_t         fixupsCapacity   = 0;
+    Arena          fixupNames       = {};
+
+    bool           isOptimized      = false; // -O
+    OptimizerStats optimizerStats   = {};
+
+    bool           isObject         = false; // -c, a relocatable object file is written instead of the bytecode
+    LabelTable*    exports          = NULL;  // names from .global, the value is the line number
+    bool           isRelocatable    = false; // -O or -c, every label reference becomes a fixup
+
+    bool           isWide                 = false; // --wide, the code isn't compacted (see bytecode.h)
+    size_t*        literalTargets         = NULL;  // offsets of numeric jump targets, which are compact offsets already
+    size_t         literalTargetsCount    = 0;
+    size_t         literalTargetsCapacity = 0;
 };
 
-AssemblerInitError initAssembler         (Assembler* assembler, int argc, char* argv[]);
-void               finishAssembler       (Assembler* assembler);
-bool               translateAssemblyFile (Assembler* assembler);
\ No newline at end of file
+AssemblerInitError initAssembler           (Assembler* assembler, int argc, char* argv[]);
+AssemblerInitError initAssemblerForSource  (Assembler* assembler, const char* source, size_t sourceSize);
+void               finishAssembler         (Assembler* assembler);
+bool               translateAssemblyFile   (Assembler* assembler);
+bool               translateAssemblySource (Assembler* assembler, BytecodeImage* image);
\ No newline at end of file
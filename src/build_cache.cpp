@@ -0,0 +1,120 @@
+#include <assert.h>
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "build_cache.h"
+
+static const size_t HASH_FILE_CHUNK_SIZE = 1 << 16;
+
+// FNV-1a, continues the given hash
+uint64_t hashBytes(const void* data, size_t size, uint64_t hash)
+{
+    assert(data != NULL || size == 0);
+
+    const unsigned char* bytes = (const unsigned char*) data;
+    for (size_t i = 0; i < size; i++)
+    {
+        hash = (hash ^ bytes[i]) * 1099511628211ull;
+    }
+
+    return hash;
+}
+
+bool hashFile(const char* fileName, uint64_t* hash)
+{
+    assert(fileName != NULL);
+    assert(hash     != NULL);
+
+    FILE* file = fopen(fileName, "rb");
+    if (file == NULL) { return false; }
+
+    unsigned char chunk[HASH_FILE_CHUNK_SIZE];
+    size_t        chunkSize = 0;
+    while ((chunkSize = fread(chunk, sizeof(unsigned char), HASH_FILE_CHUNK_SIZE, file)) != 0)
+    {
+        *hash = hashBytes(chunk, chunkSize, *hash);
+    }
+
+    bool isRead = !ferror(file);
+    fclose(file);
+
+    return isRead;
+}
+
+// the missing parent directories are created too; false if the directory can't be written to
+bool createCacheDir(const char* cacheDir)
+{
+    assert(cacheDir != NULL);
+
+    if (cacheDir[0] == '\0') { return false; }
+
+    char* path = strdup(cacheDir);
+    if (path == NULL) { return false; }
+
+    bool isCreated = true;
+    for (char* separator = strchr(path + 1, '/'); separator != NULL && isCreated; separator = strchr(separator + 1, '/'))
+    {
+        *separator = '\0';
+        isCreated  = mkdir(path, 0755) == 0 || errno == EEXIST;
+        *separator = '/';
+    }
+
+    isCreated = isCreated && (mkdir(path, 0755) == 0 || errno == EEXIST);
+    free(path);
+
+    return isCreated && access(cacheDir, W_OK | X_OK) == 0;
+}
+
+// returns calloc'ed "<cache dir>/<key in hex><extension>"
+char* makeCacheEntryName(const char* cacheDir, uint64_t key, const char* extension)
+{
+    assert(cacheDir  != NULL);
+    assert(extension != NULL);
+
+    size_t length    = strlen(cacheDir) + 1 + 2 * sizeof(key) + strlen(extension);
+    char*  entryName = (char*) calloc(length + 1, sizeof(char));
+    if (entryName == NULL) { return NULL; }
+
+    snprintf(entryName, length + 1, "%s/%016llx%s", cacheDir, (unsigned long long) key, extension);
+
+    return entryName;
+}
+
+// the name is unique to the process, so concurrent builds of the same entry don't clash
+char* makeTemporaryEntryName(const char* entryName)
+{
+    assert(entryName != NULL);
+
+    size_t length        = strlen(entryName) + 32;
+    char*  temporaryName = (char*) calloc(length + 1, sizeof(char));
+    if (temporaryName == NULL) { return NULL; }
+
+    snprintf(temporaryName, length + 1, "%s.%ld.tmp", entryName, (long) getpid());
+
+    return temporaryName;
+}
+
+bool isCacheEntryPresent(const char* entryName)
+{
+    assert(entryName != NULL);
+
+    struct stat entryStat = {};
+
+    return stat(entryName, &entryStat) == 0;
+}
+
+bool commitCacheEntry(const char* temporaryName, const char* entryName)
+{
+    assert(temporaryName != NULL);
+    assert(entryName     != NULL);
+
+    if (rename(temporaryName, entryName) == 0) { return true; }
+
+    remove(temporaryName);
+
+    return false;
+}
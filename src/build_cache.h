@@ -0,0 +1,19 @@
+#pragma once
+#include <stddef.h>
+#include <stdint.h>
+
+// Content-addressed cache of build results. An entry is named after the hash of everything
+// its contents depend on (the source text, options, format version), so a changed source gets
+// a new entry and an unchanged one is reused. Entries are written under a temporary name and
+// renamed, so a reader never sees a partially written entry.
+
+static const char* const DEFAULT_BUILD_CACHE_DIR = "bin/cache";
+static const uint64_t    BUILD_CACHE_HASH_SEED   = 14695981039346656037ull; // FNV-1a offset basis
+
+uint64_t hashBytes              (const void* data, size_t size, uint64_t hash);
+bool     hashFile               (const char* fileName, uint64_t* hash);
+bool     createCacheDir         (const char* cacheDir);
+char*    makeCacheEntryName     (const char* cacheDir, uint64_t key, const char* extension);
+char*    makeTemporaryEntryName (const char* entryName);
+bool     isCacheEntryPresent    (const char* entryName);
+bool     commitCacheEntry       (const char* temporaryName, const char* entryName);
@@ -0,0 +1,325 @@
+#include <assert.h>
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "bytecode.h"
+#include "instructions.h"
+
+size_t           getCompactLength    (const unsigned char* instruction);
+size_t           encodeCompactArgs   (const unsigned char* instruction, unsigned char* compact);
+bool             compactJumpTargets  (const unsigned char* wide, const size_t* literalTargets,
+                                      size_t literalTargetsCount, BytecodeImage* image);
+
+static_assert(getMaxInstructionLength(false) <= 1 + BYTECODE_MAX_ARGS_LENGTH, "the longest arguments don't fit");
+
+// literalTargets are the offsets of jump targets in the wide code, in ascending order, which are
+// written as numbers in the source; they are compact offsets already, all other targets are mapped
+bool compactBytecode(const unsigned char* wide, size_t wideSize, const size_t* literalTargets,
+                     size_t literalTargetsCount, BytecodeImage* image)
+{
+    assert(wide  != NULL || wideSize == 0);
+    assert(image != NULL);
+    assert(literalTargets != NULL || literalTargetsCount == 0);
+
+    image->wideSize  = wideSize;
+    image->offsetMap = (size_t*) malloc((wideSize + 1) * sizeof(size_t));
+    if (image->offsetMap == NULL) { return false; }
+
+    for (size_t i = 0; i <= wideSize; i++) { image->offsetMap[i] = BYTECODE_NO_OFFSET; }
+
+    // the compact length of an instruction doesn't depend on its jump target, so the layout is known before the targets are
+    size_t compactSize = 0;
+    for (size_t offset = 0; offset < wideSize;)
+    {
+        size_t length = getWideInstructionLength(wide + offset, wideSize - offset);
+        if (length == 0) { image->failedOffset = offset; return false; }
+
+        image->offsetMap[offset]  = compactSize;
+        compactSize              += getCompactLength(wide + offset);
+        offset                   += length;
+    }
+
+    image->offsetMap[wideSize] = compactSize;
+    if (compactSize > UINT32_MAX) { image->failedOffset = wideSize; return false; }
+
+    image->size = compactSize;
+    image->code = (unsigned char*) calloc(compactSize + 1, sizeof(unsigned char));
+    if (image->code == NULL) { return false; }
+
+    for (size_t offset = 0; offset < wideSize; offset += getWideInstructionLength(wide + offset, wideSize - offset))
+    {
+        unsigned char* compact = image->code + image->offsetMap[offset];
+
+        compact[0] = wide[offset];
+        encodeCompactArgs(wide + offset, compact + 1);
+    }
+
+    return compactJumpTargets(wide, literalTargets, literalTargetsCount, image);
+}
+
+// compact files are checked instruction by instruction, wide ones are compacted
+bool loadBytecode(const char* fileName, BytecodeImage* image)
+{
+    assert(fileName != NULL);
+    assert(image    != NULL);
+
+    unsigned char* data = NULL;
+    size_t         size = 0;
+    if (!readWholeFile(fileName, &data, &size)) { return false; }
+
+    bool isLoaded = loadBytecodeBuffer(data, size, image);
+    free(data);
+
+    return isLoaded;
+}
+
+// the contents of a bytecode file, the code is copied into the image
+bool loadBytecodeBuffer(const unsigned char* data, size_t size, BytecodeImage* image)
+{
+    assert(data  != NULL || size == 0);
+    assert(image != NULL);
+
+    BytecodeHeader header = {};
+    if (size >= sizeof(header)) { memcpy(&header, data, sizeof(header)); }
+
+    if (size < sizeof(header) || memcmp(header.magic, BYTECODE_MAGIC, sizeof(header.magic)) != 0)
+    {
+        return compactBytecode(data, size, NULL, 0, image);
+    }
+
+    if (header.version != BYTECODE_VERSION) { return false; }
+
+    image->size = size - sizeof(header);
+    image->code = (unsigned char*) calloc(image->size + 1, sizeof(unsigned char));
+    if (image->code == NULL) { return false; }
+
+    memcpy(image->code, data + sizeof(header), image->size);
+
+    for (size_t offset = 0; offset < image->size;)
+    {
+        size_t length = getInstructionLength(image->code + offset, image->size - offset);
+        if (length == 0) { image->failedOffset = offset; return false; }
+
+        offset += length;
+    }
+
+    return true;
+}
+
+bool writeBytecode(FILE* file, const BytecodeImage* image)
+{
+    assert(file  != NULL);
+    assert(image != NULL);
+
+    BytecodeHeader header = {};
+    memcpy(header.magic, BYTECODE_MAGIC, sizeof(header.magic));
+    header.version = BYTECODE_VERSION;
+
+    return fwrite(&header, sizeof(header), 1, file) == 1 &&
+           fwrite(image->code, sizeof(unsigned char), image->size, file) == image->size;
+}
+
+// the contents of a bytecode file in a buffer from malloc, for loadBytecodeBuffer
+bool writeBytecodeBuffer(const BytecodeImage* image, unsigned char** data, size_t* size)
+{
+    assert(image != NULL);
+    assert(data  != NULL);
+    assert(size  != NULL);
+
+    BytecodeHeader header = {};
+    memcpy(header.magic, BYTECODE_MAGIC, sizeof(header.magic));
+    header.version = BYTECODE_VERSION;
+
+    *data = (unsigned char*) malloc(sizeof(header) + image->size);
+    if (*data == NULL) { return false; }
+
+    memcpy(*data, &header, sizeof(header));
+    if (image->size != 0) { memcpy(*data + sizeof(header), image->code, image->size); }
+    *size = sizeof(header) + image->size;
+
+    return true;
+}
+
+void clearBytecodeImage(BytecodeImage* image)
+{
+    assert(image != NULL);
+
+    free(image->code);
+    free(image->offsetMap);
+
+    *image = {};
+}
+
+size_t mapWideOffset(const BytecodeImage* image, size_t wideOffset)
+{
+    assert(image != NULL);
+
+    if (image->offsetMap == NULL || wideOffset > image->wideSize) { return BYTECODE_NO_OFFSET; }
+
+    return image->offsetMap[wideOffset];
+}
+
+// of a valid wide instruction
+size_t getCompactLength(const unsigned char* instruction)
+{
+    assert(instruction != NULL);
+
+    unsigned char compact[BYTECODE_MAX_ARGS_LENGTH] = {};
+
+    return 1 + encodeCompactArgs(instruction, compact);
+}
+
+// -0.0 equals 0 but doesn't survive a round trip through an integer, so it's a double
+CpuImmediateKind getImmediateKind(double value)
+{
+    if (value == 0 && signbit(value)) { return CPU_IMMEDIATE_DOUBLE; }
+
+    if (value >= INT8_MIN  && value <= INT8_MAX  && value == (double) (int8_t)  value) { return CPU_IMMEDIATE_INT8;  }
+    if (value >= INT16_MIN && value <= INT16_MAX && value == (double) (int16_t) value) { return CPU_IMMEDIATE_INT16; }
+    if (value >= INT32_MIN && value <= INT32_MAX && value == (double) (int32_t) value) { return CPU_IMMEDIATE_INT32; }
+
+    return CPU_IMMEDIATE_DOUBLE;
+}
+
+// writes the arguments of a valid wide instruction after its opcode, jump targets are left for
+// compactJumpTargets, returns the number of bytes written
+size_t encodeCompactArgs(const unsigned char* instruction, unsigned char* compact)
+{
+    assert(instruction != NULL);
+    assert(compact     != NULL);
+
+    const InstructionDescriptor* descriptor = &INSTRUCTIONS[instruction[0]];
+    const unsigned char*         wideArg    = instruction + 1;
+    size_t                       length     = 0;
+    for (size_t i = 0; i < descriptor->argsCount; i++)
+    {
+        if (descriptor->operands[i] == OPERAND_TARGET) { length += CPU_TARGET_NUM_BYTES; break; }
+
+        unsigned char  argType = *wideArg++;
+        unsigned char* mode    = &compact[length++];
+
+        *mode = (argType & CPU_ARGUMENT_MASK_RAM) != 0 ? CPU_MODE_MASK_RAM : 0;
+
+        if ((argType & CPU_ARGUMENT_MASK_REG) != 0)
+        {
+            // the wide register byte is the index + 1
+            unsigned char registerByte = *wideArg++;
+            if (registerByte < CPU_MODE_REGISTER_EXTENDED)
+            {
+                *mode |= registerByte;
+            }
+            else
+            {
+                *mode |= CPU_MODE_REGISTER_EXTENDED;
+                compact[length++] = (unsigned char) (registerByte - 1);
+            }
+        }
+
+        if ((argType & CPU_ARGUMENT_MASK_CST) != 0)
+        {
+            double value = 0;
+            memcpy(&value, wideArg, sizeof(value));
+            wideArg += sizeof(value);
+
+            CpuImmediateKind kind = getImmediateKind(value);
+            *mode |= (unsigned char) (kind << CPU_MODE_IMMEDIATE_SHIFT);
+
+            switch (kind)
+            {
+                case CPU_IMMEDIATE_INT8:  { int8_t  immediate = (int8_t)  value; memcpy(&compact[length], &immediate, sizeof(immediate)); break; }
+                case CPU_IMMEDIATE_INT16: { int16_t immediate = (int16_t) value; memcpy(&compact[length], &immediate, sizeof(immediate)); break; }
+                case CPU_IMMEDIATE_INT32: { int32_t immediate = (int32_t) value; memcpy(&compact[length], &immediate, sizeof(immediate)); break; }
+                default:                  { memcpy(&compact[length], &value, sizeof(value)); break; }
+            }
+
+            length += CPU_IMMEDIATE_SIZES[kind];
+        }
+    }
+
+    return length;
+}
+
+bool compactJumpTargets(const unsigned char* wide, const size_t* literalTargets,
+                        size_t literalTargetsCount, BytecodeImage* image)
+{
+    assert(wide  != NULL || image->wideSize == 0);
+    assert(image != NULL);
+
+    // compact instruction starts, a literal target has to be one of them
+    bool* isCompactStart = NULL;
+    if (literalTargetsCount != 0)
+    {
+        isCompactStart = (bool*) calloc(image->size + 1, sizeof(bool));
+        if (isCompactStart == NULL) { return false; }
+
+        for (size_t i = 0; i <= image->wideSize; i++)
+        {
+            if (image->offsetMap[i] != BYTECODE_NO_OFFSET) { isCompactStart[image->offsetMap[i]] = true; }
+        }
+    }
+
+    size_t literalIndex = 0;
+    bool   isCompacted  = true;
+    size_t length       = 0;
+    for (size_t offset = 0; offset < image->wideSize && isCompacted; offset += length)
+    {
+        length = getWideInstructionLength(wide + offset, image->wideSize - offset);
+        const InstructionDescriptor* descriptor = &INSTRUCTIONS[wide[offset]];
+        if (descriptor->argsCount == 0 || descriptor->operands[descriptor->argsCount - 1] != OPERAND_TARGET) { continue; }
+
+        size_t targetOffset = offset + length - sizeof(double);
+
+        double value = 0;
+        memcpy(&value, wide + targetOffset, sizeof(value));
+
+        size_t target       = BYTECODE_NO_OFFSET;
+        bool   isKnownValue = wide[targetOffset - 1] == CPU_ARGUMENT_TYPE_CST && value >= 0 && value == (double) (size_t) value;
+
+        if (literalIndex < literalTargetsCount && literalTargets[literalIndex] == targetOffset)
+        {
+            literalIndex++;
+            if (isKnownValue && (size_t) value <= image->size && isCompactStart[(size_t) value]) { target = (size_t) value; }
+        }
+        else if (isKnownValue)
+        {
+            target = mapWideOffset(image, (size_t) value);
+        }
+
+        if (target == BYTECODE_NO_OFFSET) { image->failedOffset = offset; isCompacted = false; break; }
+
+        uint32_t compactTarget = (uint32_t) target;
+        memcpy(image->code + image->offsetMap[offset + length] - sizeof(compactTarget), &compactTarget, sizeof(compactTarget));
+    }
+
+    free(isCompactStart);
+
+    return isCompacted;
+}
+
+bool readWholeFile(const char* fileName, unsigned char** data, size_t* size)
+{
+    assert(fileName != NULL);
+    assert(data     != NULL);
+    assert(size     != NULL);
+
+    FILE* file = fopen(fileName, "rb");
+    if (file == NULL) { return false; }
+
+    long fileSize = -1;
+    if (fseek(file, 0, SEEK_END) == 0) { fileSize = ftell(file); }
+
+    bool isRead = fileSize >= 0 && fseek(file, 0, SEEK_SET) == 0;
+    if (isRead)
+    {
+        *size  = (size_t) fileSize;
+        *data  = (unsigned char*) calloc(*size + 1, sizeof(unsigned char));
+        isRead = *data != NULL && fread(*data, sizeof(unsigned char), *size, file) == *size;
+    }
+
+    fclose(file);
+
+    if (!isRead && *data != NULL) { free(*data); *data = NULL; }
+
+    return isRead;
+}
@@ -0,0 +1,94 @@
+#pragma once
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include "cpu_specification.h"
+
+// Bytecode files are a BytecodeHeader followed by the code in the compact encoding:
+//
+//     opcode
+//     arguments:      mode byte, [register index], [immediate]
+//     jumps and call: the last argument is a 4-byte target offset
+//
+// The mode byte (CpuModeMasks) holds the register, the kind of the immediate and the RAM flag,
+// the register index has its own byte only for the registers which don't fit into the mode byte.
+// Immediates are stored in the smallest of int8, int16 and int32 which holds them exactly,
+// other values as doubles.
+//
+// The assembler, the optimizer and object files work on the wide encoding: every argument has a
+// type byte (CpuArgumentMasks), a register byte and an 8-byte double, jump targets included. As
+// all label references have the same size, they are simple to patch and code is simple to move,
+// the code is compacted when it's written. Files without a header are from before the compact
+// encoding, they are compacted when they are loaded.
+
+static const char     BYTECODE_MAGIC[4]  = { 'S', 'B', 'C', '\0' };
+static const uint32_t BYTECODE_VERSION   = 1;
+static const size_t   BYTECODE_NO_OFFSET = (size_t) -1;
+
+// the longest arguments: three of them with an extended register and a double each
+static const size_t   BYTECODE_MAX_ARGS_LENGTH = 3 * (2 + sizeof(double));
+
+struct BytecodeHeader
+{
+    char     magic[4] = {};
+    uint32_t version  = 0;
+};
+
+struct BytecodeImage
+{
+    unsigned char* code         = NULL;               // compact
+    size_t         size         = 0;
+
+    // only for code compacted from the wide encoding: compact offset of every wide offset
+    // (wideSize + 1 entries), BYTECODE_NO_OFFSET if it isn't the start of an instruction
+    size_t*        offsetMap    = NULL;
+    size_t         wideSize     = 0;
+    size_t         failedOffset = BYTECODE_NO_OFFSET; // wide offset of the instruction which couldn't be compacted
+};
+
+bool   compactBytecode     (const unsigned char* wide, size_t wideSize, const size_t* literalTargets,
+                            size_t literalTargetsCount, BytecodeImage* image);
+bool   loadBytecode        (const char* fileName, BytecodeImage* image);
+bool   loadBytecodeBuffer  (const unsigned char* data, size_t size, BytecodeImage* image);
+bool   writeBytecode       (FILE* file, const BytecodeImage* image);
+bool   writeBytecodeBuffer (const BytecodeImage* image, unsigned char** data, size_t* size);
+void   clearBytecodeImage  (BytecodeImage* image);
+size_t mapWideOffset       (const BytecodeImage* image, size_t wideOffset);
+bool   readWholeFile       (const char* fileName, unsigned char** data, size_t* size);
+
+// the narrowest immediate which holds the value exactly, the kinds are in the order of their size
+CpuImmediateKind getImmediateKind (double value);
+
+// the CPU decodes arguments with these, pc is moved past the decoded bytes
+
+inline size_t decodeRegister(const char* code, size_t* pc, unsigned char mode)
+{
+    size_t index = mode & CPU_MODE_MASK_REGISTER;
+    if (index != CPU_MODE_REGISTER_EXTENDED) { return index - 1; }
+
+    index = (unsigned char) code[*pc];
+    (*pc)++;
+
+    return index;
+}
+
+inline double decodeImmediate(const char* code, size_t* pc, unsigned char mode)
+{
+    switch ((mode & CPU_MODE_MASK_IMMEDIATE) >> CPU_MODE_IMMEDIATE_SHIFT)
+    {
+        case CPU_IMMEDIATE_INT8:   { int8_t  value = 0; memcpy(&value, code + *pc, sizeof(value)); *pc += sizeof(value); return value; }
+        case CPU_IMMEDIATE_INT16:  { int16_t value = 0; memcpy(&value, code + *pc, sizeof(value)); *pc += sizeof(value); return value; }
+        case CPU_IMMEDIATE_INT32:  { int32_t value = 0; memcpy(&value, code + *pc, sizeof(value)); *pc += sizeof(value); return value; }
+        case CPU_IMMEDIATE_DOUBLE: { double  value = 0; memcpy(&value, code + *pc, sizeof(value)); *pc += sizeof(value); return value; }
+        default:                   { return 0; }
+    }
+}
+
+inline uint32_t decodeTarget(const char* code, size_t pc)
+{
+    uint32_t target = 0;
+    memcpy(&target, code + pc, sizeof(target));
+
+    return target;
+}
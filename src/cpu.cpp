@@ -1,9 +1,22 @@
+#include <setjmp.h>
+#include <signal.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <math.h>
+#include <string.h>
+#include <mutex>
 
+#include "bytecode.h"
 #include "cpu_specification.h"
+#include "debugger.h"
 #include "display.h"
+#include "kernel_pool.h"
+#include "metrics.h"
+#include "pages.h"
+#include "profiler.h"
+#include "source_cache.h"
+#include "symbols.h"
+#include "tracer.h"
 #include "../libs/file_manager.h"
 #include "../libs/log_generator.h"
 
@@ -16,14 +29,82 @@
                                    printf("CPU error: %d\n", cpu_ptr->status); \
                                    assert(!"OK");                              \
                                }                                               \
-                               ASSERT_STACK_OK(&cpu_ptr->stack);
+                               assert(getOperandStackSize(&cpu_ptr->stack) <= cpu_ptr->stack.capacity);
 
 #else
 #define ASSERT_CPU_OK(cpu_ptr)
 #endif
 
-void clearVRAM(unsigned char* vram, size_t vramSize);
+// Profiling is compiled in only with CPU_PROFILE_MODE, so that a regular build has no instrumentation at all
+#ifdef CPU_PROFILE_MODE
+const char* DEFAULT_PROFILE_FILE_NAME    = "bin/profile.txt";
+const char* DEFAULT_CALL_GRAPH_FILE_NAME = "bin/callgraph.folded";
 
+#define PROFILE_INSTRUCTION_START size_t   profiledPc    = cpu->pc; \
+                                  uint64_t profiledStart = getHostTimeNs();
+
+#define PROFILE_INSTRUCTION_END   profilerRecordInstruction(cpu->profiler, profiledPc, cpu->pc, getHostTimeNs() - profiledStart);
+
+#define PROFILE_CALL(target)      profilerOnCall(cpu->profiler, target)
+#define PROFILE_RET               profilerOnRet(cpu->profiler)
+
+#else
+#define PROFILE_INSTRUCTION_START
+#define PROFILE_INSTRUCTION_END
+#define PROFILE_CALL(target)
+#define PROFILE_RET
+#endif
+
+// Tracing is compiled in only with CPU_TRACE_MODE, records are kept in a ring buffer and saved by a background thread
+#ifdef CPU_TRACE_MODE
+const char* DEFAULT_TRACE_FILE_NAME = "bin/trace.bin";
+
+#define TRACE_INSTRUCTION_START size_t tracedPc = cpu->pc;
+
+#define TRACE_INSTRUCTION_END   tracerRecordInstruction(cpu->tracer, tracedPc, cpu->program[tracedPc], cpu->stack.top != cpu->stack.base, \
+                                                        cpu->stack.top != cpu->stack.base ? cpu->stack.top[-1] : 0);
+
+#define TRACE_RAM_ACCESS(address) tracerRecordRamAccess(cpu->tracer, address)
+
+#else
+#define TRACE_INSTRUCTION_START
+#define TRACE_INSTRUCTION_END
+#define TRACE_RAM_ACCESS(address)
+#endif
+
+// Metrics are updated only by call, upd, in and out, there is nothing in the loop (see metrics.h)
+#define METRICS_CALL        if (cpu->metrics != NULL) { metricsOnCall(cpu->metrics, cpu->callStack.size); }
+#define METRICS_IN          if (cpu->metrics != NULL) { increaseMetricsCounter(&cpu->metrics->inCount,  1); }
+#define METRICS_OUT         if (cpu->metrics != NULL) { increaseMetricsCounter(&cpu->metrics->outCount, 1); }
+#define METRICS_FRAME_START uint64_t frameStart = cpu->metrics != NULL ? metricsOnFrame(cpu->metrics) : 0;
+#define METRICS_FRAME_END   if (cpu->metrics != NULL) { metricsOnPresent(cpu->metrics, frameStart); }
+
+// the signal handler jumps back into executeProgram or executeInstruction of the faulted thread
+struct CpuFaultContext
+{
+    CPU*       cpu  = NULL;
+    sigjmp_buf jump = {};
+};
+
+static thread_local CpuFaultContext* cpuFaultContext     = NULL;
+static struct sigaction              oldCpuSegvAction    = {};
+static std::once_flag                cpuFaultHandlerFlag = {};
+
+bool     parseCpuOptions        (CpuOptions* options, int optionsCount, char* optionsStrings[], FILE* messages);
+bool     checkCpuOptions        (CpuOptions* options, FILE* messages);
+bool     newRam                 (RAM* ram, size_t cellsCount, size_t vramStart, size_t vramSize);
+void     deleteRam              (RAM* ram);
+bool     isRamGuardAddress      (const RAM* ram, const void* address);
+void     clearVRAM              (unsigned char* vram, size_t vramSize);
+void     setCpuFaultHandler     ();
+void     installCpuFaultHandler ();
+void     handleCpuFault         (int signalNumber, siginfo_t* info, void* context);
+CpuError catchCpuFaults         (CPU* cpu, CpuError (*run)(CPU* cpu));
+CpuError runProgram             (CPU* cpu);
+CpuError runInstruction         (CPU* cpu);
+
+// the benchmark harness links the CPU in, so it's built without main
+#ifndef CPU_NO_MAIN
 int main(int argc, char* argv[])
 {
    	CPU cpu = {};
@@ -31,22 +112,208 @@ int main(int argc, char* argv[])
    	CpuInitError cpuInitError = initCpu(&cpu, argc, argv);
    	if (cpuInitError != CPU_INIT_NO_ERROR) { return cpuInitError; } 
 
-    CpuError executionResult = executeProgram(&cpu);
+    CpuError executionResult = CPU_NO_ERROR;
+    if (cpu.options.isDebugged)
+    {
+        Debugger* debugger = newDebugger(&cpu);
+        if (debugger == NULL) { deleteCpu(&cpu); return CPU_INIT_RAM_NOT_ENOUGH_MEMORY; }
+
+        executionResult = runDebugger(debugger);
+        deleteDebugger(debugger);
+    }
+    else
+    {
+        executionResult = executeProgram(&cpu);
+    }
+
+#ifdef CPU_PROFILE_MODE
+    writeProfileReport(cpu.profiler, DEFAULT_PROFILE_FILE_NAME);
+    writeCollapsedStacks(cpu.profiler, DEFAULT_CALL_GRAPH_FILE_NAME);
+#endif
 
    	deleteCpu(&cpu);
    	return executionResult;
 }
+#endif
 
-#define CPU_INIT_ERROR(error) printf("Cpu error: %s\n", #error); return error;
+#define CPU_INIT_ERROR(error) fprintf(getCpuMessages(cpu), "Cpu error: %s\n", #error); return error;
 
 void printStack(CPU* cpu)
 {
-	for (size_t i = 0; i < cpu->stack.size; i++)
-		printf("%lg ", cpu->stack.dynamicArray[i]);
+	for (size_t i = 0; i < getOperandStackSize(&cpu->stack); i++)
+		printf("%lg ", cpu->stack.base[i]);
 
 	printf("\n");
 }
 
+// options follow the bytecode file name, e.g. scpu prog.bsy --debug or scpu prog.bsy --trace bin/prog.trace --trace-last 1000000
+bool parseCpuOptions(CpuOptions* options, int optionsCount, char* optionsStrings[], FILE* messages)
+{
+    assert(options  != NULL);
+    assert(messages != NULL);
+
+    for (int i = 0; i < optionsCount; i++)
+    {
+        const char* option = optionsStrings[i];
+
+        if (strcmp(option, "--debug") == 0)
+        {
+            options->isDebugged = true;
+            continue;
+        }
+
+        if (strcmp(option, "--headless") == 0)
+        {
+            options->isHeadless = true;
+            continue;
+        }
+
+        if (strcmp(option, "--stack") == 0 && i + 1 < optionsCount)
+        {
+            options->stackCapacity = strtoul(optionsStrings[++i], NULL, 10);
+            if (options->stackCapacity == 0) { fprintf(messages, "Cpu error: invalid stack size '%s'\n", optionsStrings[i]); return false; }
+            continue;
+        }
+
+        // in cells, VRAM starts right after the RAM unless --vram moves it further
+        if (strcmp(option, "--ram") == 0 && i + 1 < optionsCount)
+        {
+            options->ramCells = strtoul(optionsStrings[++i], NULL, 10);
+            if (options->ramCells == 0 || options->ramCells > SIZE_MAX / 2 / sizeof(double))
+            {
+                fprintf(messages, "Cpu error: invalid RAM size '%s'\n", optionsStrings[i]);
+                return false;
+            }
+            continue;
+        }
+
+        if (strcmp(option, "--vram") == 0 && i + 1 < optionsCount)
+        {
+            options->vramStart = strtoul(optionsStrings[++i], NULL, 10);
+            if (options->vramStart == 0) { fprintf(messages, "Cpu error: invalid VRAM start '%s'\n", optionsStrings[i]); return false; }
+            continue;
+        }
+
+        // the device registers, see devices.h
+        if (strcmp(option, "--devices") == 0 && i + 1 < optionsCount)
+        {
+            options->devicesStart = strtoul(optionsStrings[++i], NULL, 10);
+            if (options->devicesStart == 0) { fprintf(messages, "Cpu error: invalid device base '%s'\n", optionsStrings[i]); return false; }
+            continue;
+        }
+
+        if (strcmp(option, "--block") == 0 && i + 1 < optionsCount)
+        {
+            options->blockFileName = optionsStrings[++i];
+            continue;
+        }
+
+        // a source is assembled in memory before it's run, through the build cache
+        if (strcmp(option, "-O") == 0)
+        {
+            options->isOptimized = true;
+            continue;
+        }
+
+        if (strcmp(option, "--cache") == 0 && i + 1 < optionsCount)
+        {
+            options->cacheDir = optionsStrings[++i];
+            continue;
+        }
+
+        // threads of launch, see kernel_pool.h
+        if (strcmp(option, "--threads") == 0 && i + 1 < optionsCount)
+        {
+            options->kernelThreads = strtoul(optionsStrings[++i], NULL, 10);
+            if (options->kernelThreads == 0) { fprintf(messages, "Cpu error: invalid number of threads '%s'\n", optionsStrings[i]); return false; }
+            continue;
+        }
+
+        // published while the CPU runs, see metrics.h
+        if (strcmp(option, "--metrics") == 0 && i + 1 < optionsCount)
+        {
+            options->metricsFileName = optionsStrings[++i];
+            continue;
+        }
+
+        if (strcmp(option, "--metrics-socket") == 0 && i + 1 < optionsCount)
+        {
+            options->metricsSocketName = optionsStrings[++i];
+            continue;
+        }
+
+        if (strcmp(option, "--metrics-interval") == 0 && i + 1 < optionsCount)
+        {
+            options->metricsInterval = strtoul(optionsStrings[++i], NULL, 10);
+            if (options->metricsInterval == 0) { fprintf(messages, "Cpu error: invalid metrics interval '%s'\n", optionsStrings[i]); return false; }
+            continue;
+        }
+
+        // sin, cos and pow kernels, see fast_math.h
+        if (strcmp(option, "--math") == 0 && i + 1 < optionsCount)
+        {
+            if (!parseMathMode(optionsStrings[++i], &options->mathMode)) { fprintf(messages, "Cpu error: invalid math mode '%s'\n", optionsStrings[i]); return false; }
+            continue;
+        }
+
+#ifdef CPU_TRACE_MODE
+        if (strcmp(option, "--trace") == 0 && i + 1 < optionsCount)
+        {
+            options->traceFileName = optionsStrings[++i];
+            continue;
+        }
+
+        // --trace-records sets the ring buffer size, --trace-last also keeps only the last records instead of the whole run
+        if ((strcmp(option, "--trace-records") == 0 || strcmp(option, "--trace-last") == 0) && i + 1 < optionsCount)
+        {
+            options->traceAll     = strcmp(option, "--trace-records") == 0;
+            options->traceRecords = strtoul(optionsStrings[++i], NULL, 10);
+            if (options->traceRecords == 0) { fprintf(messages, "Cpu error: invalid number of trace records '%s'\n", optionsStrings[i]); return false; }
+            continue;
+        }
+#endif
+
+        fprintf(messages, "Cpu error: unknown option '%s'\n", option);
+        return false;
+    }
+
+    return true;
+}
+
+// the defaults which depend on other options are filled in, options given to initCpuFromImage
+// directly are checked here too
+bool checkCpuOptions(CpuOptions* options, FILE* messages)
+{
+    assert(options  != NULL);
+    assert(messages != NULL);
+
+#ifdef CPU_TRACE_MODE
+    if (options->traceFileName == NULL) { options->traceFileName = DEFAULT_TRACE_FILE_NAME;        }
+    if (options->traceRecords  == 0)    { options->traceRecords  = TRACE_DEFAULT_RECORDS_CAPACITY; }
+#endif
+
+    if (options->stackCapacity == 0 || options->ramCells == 0 || options->ramCells > SIZE_MAX / 2 / sizeof(double))
+    {
+        fprintf(messages, "Cpu error: invalid stack or RAM size\n");
+        return false;
+    }
+
+    if (options->vramStart == 0) { options->vramStart = options->ramCells; }
+    if (options->vramStart < options->ramCells || options->vramStart > SIZE_MAX - VRAM_SIZE)
+    {
+        fprintf(messages, "Cpu error: VRAM at %zu overlaps the RAM of %zu cells\n", options->vramStart, options->ramCells);
+        return false;
+    }
+
+    if (options->devicesStart < options->vramStart + VRAM_SIZE || options->devicesStart > SIZE_MAX - DEVICE_BUS_CELLS)
+    {
+        fprintf(messages, "Cpu error: devices at %zu overlap the VRAM, move them with --devices\n", options->devicesStart);
+        return false;
+    }
+
+    return true;
+}
+
 CpuInitError initCpu(CPU* cpu, int argc, char* argv[])
 {
    	if (cpu  == NULL) { CPU_INIT_ERROR(CPU_INIT_NULL_PTR_PARAMETER);   }
@@ -56,27 +323,83 @@ CpuInitError initCpu(CPU* cpu, int argc, char* argv[])
    	const char* bytecodeFileName = argv[1];
    	if (bytecodeFileName == NULL) { CPU_INIT_ERROR(CPU_INIT_BCD_FILE_UNSPECIFIED); }
 
-   	FILE* bytecodeFile = fopen(bytecodeFileName, "rb");
-   	size_t programBytes = getFileSize(bytecodeFileName);
-   	if (bytecodeFile == NULL || programBytes == 0) { CPU_INIT_ERROR(CPU_INIT_BYTECODE_FILE_READ_ERROR); }
+    if (!parseCpuOptions(&cpu->options, argc - 2, argv + 2, getCpuMessages(cpu))) { CPU_INIT_ERROR(CPU_INIT_INVALID_OPTION); }
+
+    BytecodeImage image = {};
+    if (isAssemblyFileName(bytecodeFileName))
+    {
+        if (!loadAssemblySource(bytecodeFileName, cpu->options.cacheDir, cpu->options.isOptimized, &image, &cpu->symbols))
+        {
+            clearBytecodeImage(&image);
+            CPU_INIT_ERROR(CPU_INIT_ASSEMBLY_ERROR);
+        }
 
-   	cpu->programBytes = programBytes;
-   	cpu->program = (char*) calloc(programBytes, sizeof(char));
-   	if (fread(cpu->program, sizeof(char), programBytes, bytecodeFile) != programBytes) 
+        return initCpuFromImage(cpu, &image);
+    }
+
+   	if (!loadBytecode(bytecodeFileName, &image) || image.size == 0) 
    	{ 
+        clearBytecodeImage(&image);
    		CPU_INIT_ERROR(CPU_INIT_BYTECODE_FILE_READ_ERROR); 
    	}
 
-   	stackDefaultConstruct(&cpu->stack);
+    cpu->symbols = loadSymbolTable(bytecodeFileName);
+
+    // labels of a wide file are at the offsets of the wide code
+    if (image.offsetMap != NULL) { remapSymbolTable(cpu->symbols, image.offsetMap, image.wideSize + 1); }
+
+    return initCpuFromImage(cpu, &image);
+}
+
+// cpu->options are set beforehand, the CPU takes the code of the image over and clears the image;
+// on an error the CPU is left for deleteCpu
+CpuInitError initCpuFromImage(CPU* cpu, BytecodeImage* image)
+{
+   	if (cpu   == NULL) { CPU_INIT_ERROR(CPU_INIT_NULL_PTR_PARAMETER); }
+   	if (image == NULL) { CPU_INIT_ERROR(CPU_INIT_NULL_PTR_PARAMETER); }
+
+   	cpu->programBytes = image->size;
+   	cpu->program      = (char*) image->code;
+    image->code       = NULL;
+    clearBytecodeImage(image);
+
    	stackDefaultConstruct(&cpu->callStack);
 
-   	fclose(bytecodeFile);
+    if (cpu->programBytes == 0)          { CPU_INIT_ERROR(CPU_INIT_BYTECODE_FILE_READ_ERROR); }
+    if (!checkCpuOptions(&cpu->options, getCpuMessages(cpu))) { CPU_INIT_ERROR(CPU_INIT_INVALID_OPTION); }
 
-    cpu->ram.size  = CPU_RAM_SIZE;
-    cpu->ram.cells = (double*) calloc(cpu->ram.size, sizeof(char));
-    if (cpu->ram.cells == NULL) { CPU_INIT_ERROR(CPU_INIT_RAM_NOT_ENOUGH_MEMORY); }
-    cpu->ram.vram  = ((unsigned char*) cpu->ram.cells) + sizeof(double) * VRAM_START_INDEX; 
-    cpu->display   = newDisplay();
+    if (!newRam(&cpu->ram, cpu->options.ramCells, cpu->options.vramStart, VRAM_SIZE)) { CPU_INIT_ERROR(CPU_INIT_RAM_NOT_ENOUGH_MEMORY); }
+    if (!cpu->options.isHeadless)
+    {
+        cpu->display = newDisplay(getCpuMessages(cpu));
+        if (cpu->display == NULL) { CPU_INIT_ERROR(CPU_INIT_DISPLAY_ERROR); }
+    }
+
+    cpu->ram.devices      = newDeviceBus(cpu->ram.cells, cpu->ram.cellsCount, cpu->display, cpu->options.blockFileName, getCpuMessages(cpu));
+    cpu->ram.devicesStart = cpu->options.devicesStart;
+    if (cpu->ram.devices == NULL) { CPU_INIT_ERROR(CPU_INIT_DEVICES_ERROR); }
+
+    if (cpu->options.mathMode == MATH_MODE_TABLE) { initMathTables(); }
+
+#ifdef CPU_PROFILE_MODE
+    cpu->profiler = newProfiler(cpu->program, cpu->programBytes, cpu->symbols);
+    if (cpu->profiler == NULL) { CPU_INIT_ERROR(CPU_INIT_PROFILER_NOT_ENOUGH_MEMORY); }
+#endif
+
+#ifdef CPU_TRACE_MODE
+    cpu->tracer = newTracer(cpu->options.traceFileName, cpu->options.traceRecords, cpu->options.traceAll);
+    if (cpu->tracer == NULL) { CPU_INIT_ERROR(CPU_INIT_TRACER_ERROR); }
+#endif
+
+    // after the tracer, which saves the trace on a crash, so that other faults are passed on to it
+    if (!newOperandStack(&cpu->stack, cpu->options.stackCapacity)) { CPU_INIT_ERROR(CPU_INIT_STACK_NOT_ENOUGH_MEMORY); }
+    setCpuFaultHandler();
+
+    if (cpu->options.metricsFileName != NULL || cpu->options.metricsSocketName != NULL)
+    {
+        cpu->metrics = newMetrics(cpu, cpu->options.metricsFileName, cpu->options.metricsSocketName, cpu->options.metricsInterval);
+        if (cpu->metrics == NULL) { CPU_INIT_ERROR(CPU_INIT_METRICS_ERROR); }
+    }
 
    	return CPU_INIT_NO_ERROR;
 }
@@ -85,13 +408,29 @@ void deleteCpu(CPU* cpu)
 {
 	assert(cpu != NULL);
 
-	stackDestruct(&cpu->stack);
+    // the threads run the code and the RAM of the CPU until they stop
+    deleteMetrics(cpu->metrics);
+    deleteKernelPool(cpu->kernels);
+    cpu->metrics = NULL;
+    cpu->kernels = NULL;
+
+	deleteOperandStack(&cpu->stack);
 	stackDestruct(&cpu->callStack);
 
     free(cpu->program);
-    free(cpu->ram.cells);
+    deleteDeviceBus(cpu->ram.devices);
+    deleteRam(&cpu->ram);
 
     deleteDisplay(cpu->display);
+    deleteSymbolTable(cpu->symbols);
+
+#ifdef CPU_PROFILE_MODE
+    deleteProfiler(cpu->profiler);
+#endif
+
+#ifdef CPU_TRACE_MODE
+    deleteTracer(cpu->tracer);
+#endif
 }
 
 void cpuSetError(CPU* cpu, CpuError error)
@@ -101,40 +440,225 @@ void cpuSetError(CPU* cpu, CpuError error)
 	cpu->status = error;
 }
 
+#define DEFINE_CMD(name, number, args, isControlFlow, isRegister, stackPops, stackPushes, code) \
+            case CPU_CMD_##name:                                                                \
+            {                                                                                   \
+                ASSERT_CPU_OK(cpu);                                                             \
+                code                                                                            \
+                ASSERT_CPU_OK(cpu);                                                             \
+                break;                                                                          \
+            }
+
 CpuError executeProgram(CPU* cpu)
 {
 	assert(cpu != NULL);
 
-	#define DEFINE_CMD(name, number, args, isControlFlow, code)	\
-	            case CPU_CMD_##name:                            \
-				{                                               \
-                    ASSERT_CPU_OK(cpu);                         \
-					code                                        \
-                    ASSERT_CPU_OK(cpu);                         \
-				    break;                                      \
-				}                
+    return catchCpuFaults(cpu, runProgram);
+}
+
+CpuError executeInstruction(CPU* cpu)
+{
+	assert(cpu != NULL);
+
+    return catchCpuFaults(cpu, runInstruction);
+}
+
+// a stack overflow or underflow or an access out of RAM faults on a guard page, handleCpuFault
+// jumps back here with the error set and pc at the instruction which faulted
+CpuError catchCpuFaults(CPU* cpu, CpuError (*run)(CPU* cpu))
+{
+    assert(cpu != NULL);
+    assert(run != NULL);
+
+    CpuFaultContext  context         = {};
+    CpuFaultContext* previousContext = cpuFaultContext;
+    context.cpu = cpu;
+
+    CpuError result = CPU_NO_ERROR;
+    if (sigsetjmp(context.jump, 0) == 0)
+    {
+        cpuFaultContext = &context;
+        result            = run(cpu);
+    }
+    else
+    {
+        result = cpu->status;
+    }
+
+    cpuFaultContext = previousContext;
+
+    return result;
+}
+
+// SA_NODEFER: the handler leaves with siglongjmp, which doesn't restore the signal mask
+void setCpuFaultHandler()
+{
+    std::call_once(cpuFaultHandlerFlag, installCpuFaultHandler);
+}
+
+void installCpuFaultHandler()
+{
+    struct sigaction action = {};
+    action.sa_sigaction = handleCpuFault;
+    action.sa_flags     = SA_SIGINFO | SA_NODEFER;
+    sigemptyset(&action.sa_mask);
+
+    sigaction(SIGSEGV, &action, &oldCpuSegvAction);
+}
+
+void handleCpuFault(int signalNumber, siginfo_t* info, void* context)
+{
+    CpuFaultContext* faultContext = cpuFaultContext;
+    if (faultContext != NULL)
+    {
+        CPU*              cpu   = faultContext->cpu;
+        CpuError          error = CPU_NO_ERROR;
+        OperandStackFault fault = getOperandStackFault(&cpu->stack, info->si_addr);
+
+        if (fault == OPERAND_STACK_UNDERFLOW)             { error = CPU_NOT_ENOUGH_VALUES_FOR_OPERATION; }
+        if (fault == OPERAND_STACK_OVERFLOW)              { error = CPU_STACK_OVERFLOW;                  }
+        if (isRamGuardAddress(&cpu->ram, info->si_addr))  { error = CPU_INVALID_RAM_ADDRESS;             }
+
+        if (error != CPU_NO_ERROR)
+        {
+            cpu->status = error;
+            cpu->halt   = true;
+            siglongjmp(faultContext->jump, 1);
+        }
+    }
+
+    // not ours, pass it on to the previous handler
+    if (oldCpuSegvAction.sa_flags & SA_SIGINFO) { oldCpuSegvAction.sa_sigaction(signalNumber, info, context); return; }
+
+    if (oldCpuSegvAction.sa_handler != SIG_DFL && oldCpuSegvAction.sa_handler != SIG_IGN)
+    {
+        oldCpuSegvAction.sa_handler(signalNumber);
+        return;
+    }
+
+    signal(signalNumber, SIG_DFL);
+    raise(signalNumber);
+}
+
+CpuError runProgram(CPU* cpu)
+{
+	assert(cpu != NULL);
 
 	while(!cpu->halt)
 	{
 		if (cpu->pc >= cpu->programBytes) { cpuSetError(cpu, CPU_REACHED_PROGRAM_END_NOT_HALTED); return CPU_REACHED_PROGRAM_END_NOT_HALTED; }
 
+        PROFILE_INSTRUCTION_START
+        TRACE_INSTRUCTION_START
+        countInstructions(cpu, 1);
+
 		switch(cpu->program[cpu->pc])
 		{
 			#include "cpu_commands.h"
 
 			default:
 			{
+                TRACE_INSTRUCTION_END
 				cpuSetError(cpu, CPU_INVALID_COMMAND);
 				return CPU_INVALID_COMMAND;
 			}
 		}
+
+        PROFILE_INSTRUCTION_END
+        TRACE_INSTRUCTION_END
 	}
 
-	#undef DEFINE_CMD
+    return cpu->status;
+}
+
+// same as a single iteration of runProgram, it has its own copy of the switch, so that the main loop stays as it is
+CpuError runInstruction(CPU* cpu)
+{
+	assert(cpu != NULL);
+
+    if (cpu->halt) { return cpu->status; }
+
+	if (cpu->pc >= cpu->programBytes) { cpuSetError(cpu, CPU_REACHED_PROGRAM_END_NOT_HALTED); return CPU_REACHED_PROGRAM_END_NOT_HALTED; }
+
+    PROFILE_INSTRUCTION_START
+    TRACE_INSTRUCTION_START
+    countInstructions(cpu, 1);
+
+	switch(cpu->program[cpu->pc])
+	{
+		#include "cpu_commands.h"
+
+		default:
+		{
+            TRACE_INSTRUCTION_END
+			cpuSetError(cpu, CPU_INVALID_COMMAND);
+			return CPU_INVALID_COMMAND;
+		}
+	}
+
+    PROFILE_INSTRUCTION_END
+    TRACE_INSTRUCTION_END
 
     return cpu->status;
 }
 
+#undef DEFINE_CMD
+
+// [cells][guard page][VRAM][guard page], the cells and the VRAM are placed at the end of their pages,
+// so that the first address out of them is on the guard page
+bool newRam(RAM* ram, size_t cellsCount, size_t vramStart, size_t vramSize)
+{
+    assert(ram != NULL);
+
+    size_t pageSize  = getPageSize();
+    size_t cellsSize = roundUpToPages(cellsCount * sizeof(double));
+    size_t vramPages = roundUpToPages(vramSize);
+
+    ram->size  = cellsSize + pageSize + vramPages + pageSize;
+    ram->pages = (unsigned char*) reservePages(ram->size);
+    if (ram->pages == NULL) { return false; }
+
+    unsigned char* cellsGuard = ram->pages + cellsSize;
+    unsigned char* vramGuard  = cellsGuard + pageSize + vramPages;
+
+    if (!protectPages(cellsGuard, pageSize, PAGE_ACCESS_NONE) || !protectPages(vramGuard, pageSize, PAGE_ACCESS_NONE))
+    {
+        freePages(ram->pages, ram->size);
+        *ram = {};
+        return false;
+    }
+
+    ram->cells      = (double*) (cellsGuard - cellsCount * sizeof(double));
+    ram->cellsCount = cellsCount;
+    ram->vram       = vramGuard - vramSize;
+    ram->vramStart  = vramStart;
+    ram->vramSize   = vramSize;
+
+    return true;
+}
+
+void deleteRam(RAM* ram)
+{
+    assert(ram != NULL);
+
+    freePages(ram->pages, ram->size);
+    *ram = {};
+}
+
+// called from the signal handler
+bool isRamGuardAddress(const RAM* ram, const void* address)
+{
+    assert(ram != NULL);
+
+    const unsigned char* cellsGuard = (const unsigned char*) (ram->cells + ram->cellsCount);
+    const unsigned char* vramGuard  = ram->vram + ram->vramSize;
+    const unsigned char* byte       = (const unsigned char*) address;
+    size_t               pageSize   = getPageSize();
+
+    return ram->pages != NULL && ((byte >= cellsGuard && byte < cellsGuard + pageSize) ||
+                                  (byte >= vramGuard  && byte < vramGuard  + pageSize));
+}
+
 void clearVRAM(unsigned char* vram, size_t vramSize)
 {
     assert(vram != NULL);
@@ -202,6 +726,22 @@ void dump(CPU* cpu)
             case CPU_INVALID_COMMAND:
                 CPU_DUMP_CAT_ERROR_NAME_TO_ERROR_STRING(CPU_INVALID_COMMAND);
             break;
+
+            case CPU_STACK_OVERFLOW:
+                CPU_DUMP_CAT_ERROR_NAME_TO_ERROR_STRING(CPU_STACK_OVERFLOW);
+            break;
+
+            case CPU_INVALID_RAM_ADDRESS:
+                CPU_DUMP_CAT_ERROR_NAME_TO_ERROR_STRING(CPU_INVALID_RAM_ADDRESS);
+            break;
+
+            case CPU_TRAP:
+                CPU_DUMP_CAT_ERROR_NAME_TO_ERROR_STRING(CPU_TRAP);
+            break;
+
+            case CPU_LAUNCH_ERROR:
+                CPU_DUMP_CAT_ERROR_NAME_TO_ERROR_STRING(CPU_LAUNCH_ERROR);
+            break;
         }
     }
     
@@ -214,8 +754,8 @@ void dump(CPU* cpu)
                  "\n"
                  "{\n"  
 
-                 "   programBytes = %lu\n"
-                 "   pc           = %lu\n"
+                 "   programBytes = %zu\n"
+                 "   pc           = %zu\n"
                  "   halt         = %d\n\n"
                  "   regs [0x%X]\n"
                  "   {\n"
@@ -278,28 +818,35 @@ void dump(CPU* cpu)
         logWrite("   ram\n"
                  "   {\n");
     
-        for (size_t i = 0; i < cpu->ram.size; i++)
+        for (size_t i = 0; i < cpu->ram.cellsCount; i++)
         {
-            if (i < VRAM_START_INDEX)
-            {
-                logWrite("       [%lu]\t= %lg\n", 
-                         i, cpu->ram.cells[i]);
-            }
-            else 
-            {
-                logWrite("       [%lu]\t= %u\n", LOG_COLOR_GREEN, 
-                         i, cpu->ram.vram[i - VRAM_START_INDEX]);
-            }
+            logWrite("       [%zu]\t= %lg\n", 
+                     i, cpu->ram.cells[i]);
+        }
+
+        for (size_t i = 0; i < cpu->ram.vramSize; i++)
+        {
+            logWrite("       [%zu]\t= %u\n", LOG_COLOR_GREEN, 
+                     cpu->ram.vramStart + i, cpu->ram.vram[i]);
         }
     
         logWrite("   }\n");
 
     }
 
+    logWrite("   stack [0x%X]\n"
+             "   {\n", cpu->stack.base);
+
+    for (size_t i = 0; i < getOperandStackSize(&cpu->stack); i++)
+    {
+        logWrite("       [%zu]\t= %lg\n", i, cpu->stack.base[i]);
+    }
+
+    logWrite("   }\n");
+
     logWrite("}\n");
 
     logWriteMessageEnd();
 
-    dump(&cpu->stack);
     dump(&cpu->callStack);
 }
\ No newline at end of file
@@ -1,69 +1,95 @@
 #define CPU_PTR        cpu
 #define STACK_PTR      (&CPU_PTR->stack)
-#define RAM_CELLS      (CPU_PTR->ram.cells)
-#define VRAM_CELLS     (CPU_PTR->ram.vram)
+#define RAM_PTR        (&CPU_PTR->ram)
 #define CALL_STACK_PTR (&CPU_PTR->callStack)
 #define PC             CPU_PTR->pc
 #define CODE           CPU_PTR->program
 #define CURR_CODE      CPU_PTR->program[PC]
+#define MATH_MODE      CPU_PTR->options.mathMode
 
-#define TO_DOUBLE(value)       *(double*)(&(value))       
-#define CURR_VAL               TO_DOUBLE(CURR_CODE)
+#define CURR_TARGET            decodeTarget(CODE, PC)
 #define SET_REGISTER(i, value) CPU_PTR->regs[i] = value
 #define GET_REGISTER(i)        CPU_PTR->regs[i]
-#define VAL_NUM_BYTES          sizeof(double)
+#define TARGET_NUM_BYTES       CPU_TARGET_NUM_BYTES
+#define DECODE_REGISTER(mode)  decodeRegister(CODE, &PC, mode)
+#define DECODE_IMMEDIATE(mode) decodeImmediate(CODE, &PC, mode)
 #define PC_SET(value)          PC = value
 #define CPU_STOP               CPU_PTR->halt = true;
 #define CPU_SET_ERROR(error)   cpuSetError(CPU_PTR, error); \
                                ASSERT_CPU_OK(CPU_PTR); 
     
-#define STACK_PUSH(value)        stackPush(STACK_PTR, value)
-#define STACK_POP                stackPop(STACK_PTR)
-#define STACK_CHECK_SIZE(needed) if (STACK_PTR->size < needed) \
-                                 { CPU_SET_ERROR(CPU_NOT_ENOUGH_VALUES_FOR_OPERATION); }
+// overflow and underflow fault on a guard page of the stack, so an instruction has to touch the stack
+// before it moves pc, then the error is reported at the instruction (see handleCpuFault in cpu.cpp)
+#define STACK_PUSH(value)        operandStackPush(STACK_PTR, value)
+#define STACK_POP                operandStackPop(STACK_PTR)
 
 #define READ(dest)   if (scanf("%lg", &dest) != 1)   { CPU_SET_ERROR(CPU_IO_ERROR); }
 #define WRITE(value) if (printf("%lg\n", value) < 0) { CPU_SET_ERROR(CPU_IO_ERROR); }
 
-#define JUMP_TEMPLATE(condition)    PC += 2; /* to skip cmd and literal value flag */   \
-                                    STACK_CHECK_SIZE(2);                                \
-                                    double temp2 = STACK_POP;                           \
-                                    double temp1 = STACK_POP;                           \
-                                    if (temp1 condition temp2) { PC_SET(CURR_VAL); }    \
-                                    else                       { PC += VAL_NUM_BYTES; } \
-
-DEFINE_CMD(in, 0, 0, false,
+#define JUMP_TEMPLATE(condition)    double temp2 = STACK_POP;                              \
+                                    double temp1 = STACK_POP;                              \
+                                    PC += 1; /* to skip cmd */                             \
+                                    if (temp1 condition temp2) { PC_SET(CURR_TARGET); }    \
+                                    else                       { PC += TARGET_NUM_BYTES; } \
+
+// register instructions don't touch the stack, their operands are checked when the code is loaded:
+// the destination is a register, the sources are registers and numbers
+#define DECODE_DESTINATION(index)   { unsigned char destinationMode = CURR_CODE; PC++;                               \
+                                      index = DECODE_REGISTER(destinationMode); }
+
+#define DECODE_SOURCE(value)        { unsigned char sourceMode = CURR_CODE; PC++;                                    \
+                                      value = 0;                                                                     \
+                                      if (sourceMode & CPU_MODE_MASK_REGISTER)  { value += GET_REGISTER(DECODE_REGISTER(sourceMode)); } \
+                                      if (sourceMode & CPU_MODE_MASK_IMMEDIATE) { value += DECODE_IMMEDIATE(sourceMode); } }
+
+#define REGISTER_OPERATION_TEMPLATE(operation)  PC += 1; /* to skip cmd */                                          \
+                                                size_t destination = 0;                                              \
+                                                double temp1       = 0;                                              \
+                                                double temp2       = 0;                                              \
+                                                DECODE_DESTINATION(destination);                                     \
+                                                DECODE_SOURCE(temp1);                                                \
+                                                DECODE_SOURCE(temp2);                                                \
+                                                SET_REGISTER(destination, temp1 operation temp2);                    \
+
+#define REGISTER_JUMP_TEMPLATE(condition)   PC += 1; /* to skip cmd */                                              \
+                                            double temp1 = 0;                                                        \
+                                            double temp2 = 0;                                                        \
+                                            DECODE_SOURCE(temp1);                                                    \
+                                            DECODE_SOURCE(temp2);                                                    \
+                                            if (temp1 condition temp2) { PC_SET(CURR_TARGET); }                      \
+                                            else                       { PC += TARGET_NUM_BYTES; }                   \
+
+// DEFINE_CMD(name, opcode, arguments count, is control flow, is a register form,
+//            values popped from the stack, values pushed onto it, code)
+
+DEFINE_CMD(in, 0, 0, false, false, 0, 1,
             {
                 double temp = 0;
                 READ(temp);
+                METRICS_IN;
 
                 STACK_PUSH(temp);
 
                 PC++;
             })
 
-DEFINE_CMD(out, 1, 0, false,
+DEFINE_CMD(out, 1, 0, false, false, 1, 0,
             {
-                STACK_CHECK_SIZE(1);
-
                 WRITE(STACK_POP);
+                METRICS_OUT;
 
                 PC++;
             })
 
-DEFINE_CMD(add, 2, 0, false,
+DEFINE_CMD(add, 2, 0, false, false, 2, 1,
             {
-                STACK_CHECK_SIZE(2);
-
                 STACK_PUSH(STACK_POP + STACK_POP);
 
                 PC++;
             })
 
-DEFINE_CMD(sub, 3, 0, false,
+DEFINE_CMD(sub, 3, 0, false, false, 2, 1,
             {
-                STACK_CHECK_SIZE(2);
-
                 double temp2 = STACK_POP;
                 double temp1 = STACK_POP;
                 STACK_PUSH(temp1 - temp2);
@@ -71,10 +97,8 @@ DEFINE_CMD(sub, 3, 0, false,
                 PC++;
             })
 
-DEFINE_CMD(mul, 4, 0, false,
+DEFINE_CMD(mul, 4, 0, false, false, 2, 1,
             {
-                STACK_CHECK_SIZE(2);
-
                 double temp2 = STACK_POP;
                 double temp1 = STACK_POP;
 
@@ -83,10 +107,8 @@ DEFINE_CMD(mul, 4, 0, false,
                 PC++;
             })
 
-DEFINE_CMD(div, 5, 0, false,
+DEFINE_CMD(div, 5, 0, false, false, 2, 1,
             {
-                STACK_CHECK_SIZE(2);
-
                 double temp2 = STACK_POP;
                 double temp1 = STACK_POP;
 
@@ -97,22 +119,18 @@ DEFINE_CMD(div, 5, 0, false,
                 PC++;
             })
 
-DEFINE_CMD(pow, 6, 0, false,
+DEFINE_CMD(pow, 6, 0, false, false, 2, 1,
             {
-                STACK_CHECK_SIZE(2);
-               
                 double temp2 = STACK_POP;
                 double temp1 = STACK_POP;
                
-                STACK_PUSH(pow(temp1, temp2));
+                STACK_PUSH(mathPow(MATH_MODE, temp1, temp2));
                
                 PC++;
             })
 
-DEFINE_CMD(sqrt, 7, 0, false,
+DEFINE_CMD(sqrt, 7, 0, false, false, 1, 1,
             {
-                STACK_CHECK_SIZE(1);
-
                 double temp = STACK_POP;
 
                 if (temp < 0) { CPU_SET_ERROR(CPU_MATH_ERROR); }
@@ -122,182 +140,325 @@ DEFINE_CMD(sqrt, 7, 0, false,
                 PC++;
             })
 
-DEFINE_CMD(sin, 8, 0, false, 
+DEFINE_CMD(sin, 8, 0, false, false, 1, 1, 
             {
-                STACK_CHECK_SIZE(1);
-               
-                STACK_PUSH(sin(STACK_POP));
+                STACK_PUSH(mathSin(MATH_MODE, STACK_POP));
                
                 PC++;
             })
 
-DEFINE_CMD(cos, 9, 0, false,
+DEFINE_CMD(cos, 9, 0, false, false, 1, 1,
             {
-                STACK_CHECK_SIZE(1);
-                
-                STACK_PUSH(cos(STACK_POP));
+                STACK_PUSH(mathCos(MATH_MODE, STACK_POP));
                
                 PC++;
             })
 
-DEFINE_CMD(push, 10, 1, false,
+DEFINE_CMD(push, 10, 1, false, false, 0, 1,
             {
-                PC++;
-                char mode = CURR_CODE;
-                PC++;
+                // pc is moved after the push
+                unsigned char mode = CODE[PC + 1];
+                size_t        next = PC + 2;
 
-                double argument = 0;
+                // -0.0 + x is x for every x, so push -0 keeps the sign
+                double argument = -0.0;
 
-                if (mode & CPU_ARGUMENT_MASK_REG) { argument += GET_REGISTER(CURR_CODE - 1); PC += 1; }
+                if (mode & CPU_MODE_MASK_REGISTER)  { argument += GET_REGISTER(decodeRegister(CODE, &next, mode)); }
 
-                if (mode & CPU_ARGUMENT_MASK_CST) { argument += TO_DOUBLE(CODE[PC]); PC += VAL_NUM_BYTES; } 
+                if (mode & CPU_MODE_MASK_IMMEDIATE) { argument += decodeImmediate(CODE, &next, mode); }
 
-                if (mode & CPU_ARGUMENT_MASK_RAM) 
+                if (mode & CPU_MODE_MASK_RAM) 
                 { 
-                    if ((size_t) argument >= VRAM_START_INDEX)
-                        argument = VRAM_CELLS[(size_t) argument - VRAM_START_INDEX];
-                    else
-                        argument = RAM_CELLS[(size_t) argument];
+                    TRACE_RAM_ACCESS((size_t) argument);
+
+                    argument = readRam(RAM_PTR, (size_t) argument);
                 }
 
                 STACK_PUSH(argument);
+                PC_SET(next);
             })
 
-DEFINE_CMD(pop, 11, 1, false,
+DEFINE_CMD(pop, 11, 1, false, false, 1, 0,
             {
-                STACK_CHECK_SIZE(1); 
+                double value = STACK_POP;
 
-                PC++;
-                char mode = CURR_CODE;
-                PC++;
+                // pc is moved after the write, as in push
+                unsigned char mode = CODE[PC + 1];
+                size_t        next = PC + 2;
 
-                if ((mode & (CPU_ARGUMENT_MASK_REG | CPU_ARGUMENT_MASK_RAM)) == 0) 
+                if ((mode & (CPU_MODE_MASK_REGISTER | CPU_MODE_MASK_RAM)) == 0) 
                 { 
                     CPU_SET_ERROR(CPU_INVALID_CMD_ARGUMENT); 
                 }
 
-                if ((mode & CPU_ARGUMENT_MASK_RAM) == 0)
+                if ((mode & CPU_MODE_MASK_RAM) == 0)
                 {
-                    SET_REGISTER(CURR_CODE - 1, STACK_POP);
-                    PC++;
+                    SET_REGISTER(decodeRegister(CODE, &next, mode), value);
                 }
                 else
                 {
                     double argument = 0;
 
-                    if (mode & CPU_ARGUMENT_MASK_REG) { argument += GET_REGISTER(CURR_CODE - 1); PC += 1; }
+                    if (mode & CPU_MODE_MASK_REGISTER)  { argument += GET_REGISTER(decodeRegister(CODE, &next, mode)); }
+
+                    if (mode & CPU_MODE_MASK_IMMEDIATE) { argument += decodeImmediate(CODE, &next, mode); }
 
-                    if (mode & CPU_ARGUMENT_MASK_CST) { argument += TO_DOUBLE(CODE[PC]); PC += VAL_NUM_BYTES; }    
+                    TRACE_RAM_ACCESS((size_t) argument);
 
-                    if ((size_t) argument >= VRAM_START_INDEX)
-                        VRAM_CELLS[(size_t) argument - VRAM_START_INDEX] = (unsigned char) STACK_POP;
-                    else
-                        RAM_CELLS[(size_t)argument] = STACK_POP;
+                    writeRam(RAM_PTR, (size_t) argument, value);
                 }                    
+
+                PC_SET(next);
             })
 
-DEFINE_CMD(call, 12, 1, true,
+DEFINE_CMD(call, 12, 1, true, false, 0, 0,
             {
-                PC += 2; // to skip cmd and literal value flag
+                PC += 1; // to skip cmd
 
-                double temp = CURR_VAL;
+                size_t temp = CURR_TARGET;
 
-                stackPush(CALL_STACK_PTR, PC + VAL_NUM_BYTES);
+                stackPush(CALL_STACK_PTR, PC + TARGET_NUM_BYTES);
                 PC_SET(temp);
+
+                METRICS_CALL;
+                PROFILE_CALL((size_t) temp);
             })
 
-DEFINE_CMD(ret, 13, 0, false,
+DEFINE_CMD(ret, 13, 0, false, false, 0, 0,
             {
                 PC_SET(stackPop(CALL_STACK_PTR));
+
+                PROFILE_RET;
             })
 
-DEFINE_CMD(jmp, 14, 1, true,
+DEFINE_CMD(jmp, 14, 1, true, false, 0, 0,
             {
-                PC += 2; // to skip cmd and literal value flag
-                PC_SET(CURR_VAL);
+                PC += 1; // to skip cmd
+                PC_SET(CURR_TARGET);
             })
 
-DEFINE_CMD(jae, 15, 1, true,
+DEFINE_CMD(jae, 15, 1, true, false, 2, 0,
             {
                 JUMP_TEMPLATE(>=)
             })
 
-DEFINE_CMD(ja, 16, 1, true,
+DEFINE_CMD(ja, 16, 1, true, false, 2, 0,
             {
                 JUMP_TEMPLATE(>)
             })
 
-DEFINE_CMD(jb, 17, 1, true,
+DEFINE_CMD(jb, 17, 1, true, false, 2, 0,
             {
                 JUMP_TEMPLATE(<)
             })
 
-DEFINE_CMD(jbe, 18, 1, true,
+DEFINE_CMD(jbe, 18, 1, true, false, 2, 0,
             {
                 JUMP_TEMPLATE(<=)
             })
 
-DEFINE_CMD(je, 19, 1, true,
+DEFINE_CMD(je, 19, 1, true, false, 2, 0,
             {
                 JUMP_TEMPLATE(==)
             })
 
-DEFINE_CMD(jne, 20, 1, true,
+DEFINE_CMD(jne, 20, 1, true, false, 2, 0,
             {
                 JUMP_TEMPLATE(!=)              
             })
 
-DEFINE_CMD(upd, 21, 0, false,
+// without a display (--headless) the VRAM is kept but never shown, closing the window stops the CPU
+DEFINE_CMD(upd, 21, 0, false, false, 0, 0,
             {
-                updateDisplay(CPU_PTR->display, CPU_PTR->ram.vram);       
+                METRICS_FRAME_START;
+                if (CPU_PTR->display != NULL)
+                {
+                    updateDisplay(CPU_PTR->display, CPU_PTR->ram.vram);
+                    if (isDisplayClosed(CPU_PTR->display)) { CPU_STOP; }
+                }
+                METRICS_FRAME_END;
                 PC++;           
             })
 
-DEFINE_CMD(clr, 22, 0, false,
+DEFINE_CMD(clr, 22, 0, false, false, 0, 0,
             {
-                clearVRAM(CPU_PTR->ram.vram, getDisplayBufferSize(CPU_PTR->display));       
+                clearVRAM(CPU_PTR->ram.vram, CPU_PTR->ram.vramSize);       
                 PC++;           
             })
 
-DEFINE_CMD(abs, 23, 0, false,
+DEFINE_CMD(abs, 23, 0, false, false, 1, 1,
             {
-                STACK_CHECK_SIZE(1); 
-
                 STACK_PUSH(abs(STACK_POP));
 
                 PC++;           
             })
 
-DEFINE_CMD(flr, 24, 0, false,
+DEFINE_CMD(flr, 24, 0, false, false, 1, 1,
             {
-                STACK_CHECK_SIZE(1); 
-
                 STACK_PUSH(floor(STACK_POP));
 
                 PC++;           
             })
 
-DEFINE_CMD(hlt, 25, 0, false,
+DEFINE_CMD(hlt, 25, 0, false, false, 0, 0,
             {
                 CPU_STOP;
             })
 
+// the debugger patches it over the first byte of an instruction to set a breakpoint
+DEFINE_CMD(brk, 26, 0, false, false, 0, 0,
+            {
+                countInstructions(CPU_PTR, (uint64_t) -1); // it isn't an instruction of the program
+                return CPU_TRAP;
+            })
+
+DEFINE_CMD(mov, 27, 2, false, true, 0, 0,
+            {
+                PC += 1; // to skip cmd
+
+                size_t destination = 0;
+                double temp        = 0;
+                DECODE_DESTINATION(destination);
+                DECODE_SOURCE(temp);
+
+                SET_REGISTER(destination, temp);
+            })
+
+DEFINE_CMD(add_r, 28, 3, false, true, 0, 0,
+            {
+                REGISTER_OPERATION_TEMPLATE(+)
+            })
+
+DEFINE_CMD(sub_r, 29, 3, false, true, 0, 0,
+            {
+                REGISTER_OPERATION_TEMPLATE(-)
+            })
+
+DEFINE_CMD(mul_r, 30, 3, false, true, 0, 0,
+            {
+                REGISTER_OPERATION_TEMPLATE(*)
+            })
+
+DEFINE_CMD(div_r, 31, 3, false, true, 0, 0,
+            {
+                PC += 1; // to skip cmd
+
+                size_t destination = 0;
+                double temp1       = 0;
+                double temp2       = 0;
+                DECODE_DESTINATION(destination);
+                DECODE_SOURCE(temp1);
+                DECODE_SOURCE(temp2);
+
+                if (temp2 == 0) { CPU_SET_ERROR(CPU_MATH_ERROR); }
+
+                SET_REGISTER(destination, temp1 / temp2);
+            })
+
+DEFINE_CMD(jae_r, 32, 3, true, true, 0, 0,
+            {
+                REGISTER_JUMP_TEMPLATE(>=)
+            })
+
+DEFINE_CMD(ja_r, 33, 3, true, true, 0, 0,
+            {
+                REGISTER_JUMP_TEMPLATE(>)
+            })
+
+DEFINE_CMD(jb_r, 34, 3, true, true, 0, 0,
+            {
+                REGISTER_JUMP_TEMPLATE(<)
+            })
+
+DEFINE_CMD(jbe_r, 35, 3, true, true, 0, 0,
+            {
+                REGISTER_JUMP_TEMPLATE(<=)
+            })
+
+DEFINE_CMD(je_r, 36, 3, true, true, 0, 0,
+            {
+                REGISTER_JUMP_TEMPLATE(==)
+            })
+
+DEFINE_CMD(jne_r, 37, 3, true, true, 0, 0,
+            {
+                REGISTER_JUMP_TEMPLATE(!=)
+            })
+
+// sin, cos and pow of the RAM cells [cell, cell + count) in place, evaluated as arrays
+DEFINE_CMD(vsin, 38, 0, false, false, 2, 0,
+            {
+                size_t count = (size_t) STACK_POP;
+                size_t cell  = (size_t) STACK_POP;
+
+                TRACE_RAM_ACCESS(cell);
+
+                double* cells = getRamCells(RAM_PTR, cell);
+                mathSinArray(MATH_MODE, cells, cells, count);
+
+                PC++;
+            })
+
+DEFINE_CMD(vcos, 39, 0, false, false, 2, 0,
+            {
+                size_t count = (size_t) STACK_POP;
+                size_t cell  = (size_t) STACK_POP;
+
+                TRACE_RAM_ACCESS(cell);
+
+                double* cells = getRamCells(RAM_PTR, cell);
+                mathCosArray(MATH_MODE, cells, cells, count);
+
+                PC++;
+            })
+
+// the bases are replaced by the powers, the exponents are in the second range
+DEFINE_CMD(vpow, 40, 0, false, false, 3, 0,
+            {
+                size_t count         = (size_t) STACK_POP;
+                size_t exponentsCell = (size_t) STACK_POP;
+                size_t cell          = (size_t) STACK_POP;
+
+                TRACE_RAM_ACCESS(cell);
+                TRACE_RAM_ACCESS(exponentsCell);
+
+                double* cells = getRamCells(RAM_PTR, cell);
+                mathPowArray(MATH_MODE, cells, getRamCells(RAM_PTR, exponentsCell), cells, count);
+
+                PC++;
+            })
+
+// runs the kernel at the target for every pixel of the rectangle x, y, width, height (see
+// kernel_pool.h), an error stops the CPU at launch
+DEFINE_CMD(launch, 41, 1, true, false, 4, 0,
+            {
+                double height = STACK_POP;
+                double width  = STACK_POP;
+                double y      = STACK_POP;
+                double x      = STACK_POP;
+
+                CpuError error = launchKernel(CPU_PTR, decodeTarget(CODE, PC + 1), x, y, width, height);
+
+                if (error == CPU_NO_ERROR) { PC += 1 + TARGET_NUM_BYTES; }
+                else                       { CPU_SET_ERROR(error); CPU_STOP; }
+            })
+
 #undef CPU_PTR                 
 #undef STACK_PTR
 #undef CALL_STACK_PTR
 #undef PC               
 #undef CURR_CODE               
+#undef MATH_MODE
 #undef SET_REGISTER
 #undef CPU_SET_ERROR  
 #undef CPU_STOP                
 
 #undef CMD_NUM_BYTES           
-#undef VAL_NUM_BYTES           
+#undef TARGET_NUM_BYTES
 #undef PC_INCREMENT     
 
 #undef STACK_PUSH      
 #undef STACK_POP               
-#undef STACK_CHECK_SIZE
 
 #undef READ             
 #undef WRITE            
\ No newline at end of file
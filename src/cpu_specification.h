@@ -1,6 +1,12 @@
 #pragma once
+#include <stdint.h>
+#include <stdio.h>
 #include <stdlib.h>
+#include <atomic>
+#include "devices.h"
 #include "display.h"
+#include "fast_math.h"
+#include "operand_stack.h"
 
 typedef double stk_elem_t;
 #include "../libs/stack.h"
@@ -14,7 +20,11 @@ enum CpuError
     CPU_IO_ERROR,
     CPU_INVALID_CMD_ARGUMENT,
     CPU_REACHED_PROGRAM_END_NOT_HALTED,
-    CPU_INVALID_COMMAND
+    CPU_INVALID_COMMAND,
+    CPU_STACK_OVERFLOW,
+    CPU_INVALID_RAM_ADDRESS,
+    CPU_TRAP, // not an error, execution stopped at a brk instruction
+    CPU_LAUNCH_ERROR // the threads of launch couldn't be started, or launch or brk in a kernel
 };
 
 enum CpuInitError
@@ -24,7 +34,15 @@ enum CpuInitError
     CPU_INIT_ARGS_EMPTY,
     CPU_INIT_BCD_FILE_UNSPECIFIED,
     CPU_INIT_BYTECODE_FILE_READ_ERROR,
-    CPU_INIT_RAM_NOT_ENOUGH_MEMORY
+    CPU_INIT_RAM_NOT_ENOUGH_MEMORY,
+    CPU_INIT_PROFILER_NOT_ENOUGH_MEMORY,
+    CPU_INIT_INVALID_OPTION,
+    CPU_INIT_TRACER_ERROR,
+    CPU_INIT_STACK_NOT_ENOUGH_MEMORY,
+    CPU_INIT_DEVICES_ERROR,
+    CPU_INIT_ASSEMBLY_ERROR,
+    CPU_INIT_METRICS_ERROR,
+    CPU_INIT_DISPLAY_ERROR
 };
 
 enum CpuArgumentMasks
@@ -44,52 +62,186 @@ enum CpuArgumentType
     CPU_ARGUMENT_TYPE_RAM_REG_PLUS_CST = CPU_ARGUMENT_MASK_RAM | CPU_ARGUMENT_MASK_REG | CPU_ARGUMENT_MASK_CST
 };
 
+// mode byte of a push or pop argument in the compact encoding (see bytecode.h)
+enum CpuModeMasks
+{
+    CPU_MODE_MASK_REGISTER  = 0x0F, // 0 - no register, index + 1 or CPU_MODE_REGISTER_EXTENDED
+    CPU_MODE_MASK_IMMEDIATE = 0x70, // CpuImmediateKind
+    CPU_MODE_MASK_RAM       = 0x80
+};
+
+enum CpuImmediateKind
+{
+    CPU_IMMEDIATE_NONE,
+    CPU_IMMEDIATE_INT8,
+    CPU_IMMEDIATE_INT16,
+    CPU_IMMEDIATE_INT32,
+    CPU_IMMEDIATE_DOUBLE
+};
+
+static const unsigned char CPU_MODE_REGISTER_EXTENDED = CPU_MODE_MASK_REGISTER; // the index is in the next byte
+static const unsigned      CPU_MODE_IMMEDIATE_SHIFT   = 4;
+static const size_t        CPU_IMMEDIATE_SIZES[]      = { 0, sizeof(int8_t), sizeof(int16_t), sizeof(int32_t), sizeof(double) };
+static const size_t        CPU_TARGET_NUM_BYTES       = sizeof(uint32_t);
+
 enum CpuCommands
 {
-    #define DEFINE_CMD(name, number, args, isControlFlow, code) \
+    #define DEFINE_CMD(name, number, args, isControlFlow, isRegister, stackPops, stackPushes, code) \
         CPU_CMD_##name = number,
 
     #include "cpu_commands.h"
     #undef DEFINE_CMD   
 };
 
-#define DEFINE_CMD(name, number, args, isControlFlow, code) +1
+#define DEFINE_CMD(name, number, args, isControlFlow, isRegister, stackPops, stackPushes, code) +1
 static const size_t CPU_COMMANDS_COUNT = 0 
                                          #include "cpu_commands.h"
                                          ;
 #undef DEFINE_CMD
 
-static const size_t CPU_REGISTERS_COUNT = 18;
-static const size_t VRAM_START_INDEX    = 1024;
-static const size_t VRAM_SIZE           = DISPLAY_DEFAULT_WIDTH * DISPLAY_DEFAULT_HEIGHT * 4;
-static const size_t CPU_RAM_SIZE        = sizeof(double) * VRAM_START_INDEX + VRAM_SIZE;
+static const size_t CPU_REGISTERS_COUNT   = 18;
+static const size_t CPU_DEFAULT_RAM_CELLS = 1024;
+static const size_t VRAM_SIZE             = DISPLAY_DEFAULT_WIDTH * DISPLAY_DEFAULT_HEIGHT * 4;
 
+// Cells [0, cellsCount) are doubles, cells [vramStart, vramStart + vramSize) are VRAM bytes. Both
+// end right at a guard page and are reserved without committing memory, only the pages which are
+// touched take memory. An address out of range is clamped onto the guard page, so it faults
+// without a branch and the CPU turns the fault into CPU_INVALID_RAM_ADDRESS. The device registers
+// are above the VRAM, [devicesStart, devicesStart + DEVICE_BUS_CELLS).
 struct RAM
 {
-    size_t         size     = 0;
-    double*        cells    = NULL;
-    unsigned char* vram     = NULL;
-    size_t         vramSize = 0;
+    unsigned char* pages        = NULL; // the whole reservation, guard pages included
+    size_t         size         = 0;
+
+    double*        cells        = NULL;
+    size_t         cellsCount   = 0;
+    unsigned char* vram         = NULL;
+    size_t         vramStart    = 0;
+    size_t         vramSize     = 0;
+
+    DeviceBus*     devices      = NULL; // owned by the CPU
+    size_t         devicesStart = SIZE_MAX;
+};
+
+inline bool isRamCell(const RAM* ram, size_t cell)
+{
+    return cell < ram->cellsCount || (cell >= ram->vramStart && cell - ram->vramStart < ram->vramSize);
+}
+
+inline double readRam(const RAM* ram, size_t cell)
+{
+    if (cell >= ram->vramStart)
+    {
+        if (cell >= ram->devicesStart && cell - ram->devicesStart < DEVICE_BUS_CELLS) { return readDevice(ram->devices, cell - ram->devicesStart); }
+
+        size_t offset = cell - ram->vramStart;
+        return ram->vram[offset < ram->vramSize ? offset : ram->vramSize];
+    }
+
+    return ram->cells[cell < ram->cellsCount ? cell : ram->cellsCount];
+}
+
+inline void writeRam(RAM* ram, size_t cell, double value)
+{
+    if (cell >= ram->vramStart)
+    {
+        if (cell >= ram->devicesStart && cell - ram->devicesStart < DEVICE_BUS_CELLS) { writeDevice(ram->devices, cell - ram->devicesStart, value); return; }
+
+        size_t offset = cell - ram->vramStart;
+        ram->vram[offset < ram->vramSize ? offset : ram->vramSize] = (unsigned char) value;
+        return;
+    }
+
+    ram->cells[cell < ram->cellsCount ? cell : ram->cellsCount] = value;
+}
+
+// the cells from the cell on, for the instructions which work on a range of them; a range which
+// doesn't fit, or starts out of the cells (e.g. in VRAM), faults on the guard page
+inline double* getRamCells(RAM* ram, size_t cell)
+{
+    return ram->cells + (cell < ram->cellsCount ? cell : ram->cellsCount);
+}
+
+struct CpuOptions
+{
+    bool        isDebugged    = false;
+    bool        isHeadless    = false; // no display, upd does nothing
+    size_t      stackCapacity = OPERAND_STACK_DEFAULT_CAPACITY;
+    size_t      ramCells      = CPU_DEFAULT_RAM_CELLS;
+    size_t      vramStart     = 0; // 0 is right after the RAM
+    MathMode    mathMode      = MATH_MODE_EXACT;
+    size_t      devicesStart  = DEVICE_DEFAULT_START;
+    const char* blockFileName = NULL;
+    bool        isOptimized   = false; // -O, for a source run directly (see source_cache.h)
+    const char* cacheDir      = NULL;  // --cache, DEFAULT_BUILD_CACHE_DIR if NULL
+    size_t      kernelThreads = 0;     // --threads of launch (see kernel_pool.h), 0 is one per core
+
+    // --metrics, --metrics-socket, --metrics-interval in ms (see metrics.h), 0 is the default
+    const char* metricsFileName   = NULL;
+    const char* metricsSocketName = NULL;
+    size_t      metricsInterval   = 0;
+
+#ifdef CPU_TRACE_MODE
+    const char* traceFileName = NULL;
+    size_t      traceRecords  = 0;
+    bool        traceAll      = true;
+#endif
 };
 
+struct Profiler;
+struct Tracer;
+struct SymbolTable;
+struct BytecodeImage;
+struct KernelPool;
+struct Metrics;
+
 struct CPU
 {
-    CpuError status = CPU_NO_ERROR;
-
-    Stack    stack        = {};
-    Stack    callStack    = {};
-    char*    program      = NULL;
-    size_t   programBytes = 0;
-    size_t   pc           = 0;
-    bool     halt         = false;
-    RAM      ram          = {};
-    Display* display      = NULL;
-    double   regs[CPU_REGISTERS_COUNT] = {};
+    CpuError     status            = CPU_NO_ERROR;
+    CpuOptions   options           = {};
+
+    OperandStack stack             = {};
+    Stack        callStack         = {};
+    char*        program           = NULL;
+    size_t       programBytes      = 0;
+    size_t       pc                = 0;
+    std::atomic<uint64_t> instructionsCount {0}; // read by the metrics thread while the CPU runs
+    bool         halt              = false;
+    RAM          ram               = {};
+    Display*     display           = NULL;
+    SymbolTable* symbols           = NULL;
+    double       regs[CPU_REGISTERS_COUNT] = {};
+    KernelPool*  kernels           = NULL;  // started by the first launch
+    bool         isKernel          = false; // runs an invocation of a kernel for another CPU
+    Metrics*     metrics           = NULL;  // --metrics or --metrics-socket
+    FILE*        messages          = NULL;  // errors of the initialization and of the threads, stdout if NULL
+
+#ifdef CPU_PROFILE_MODE
+    Profiler*    profiler          = NULL;
+#endif
+
+#ifdef CPU_TRACE_MODE
+    Tracer*      tracer            = NULL;
+#endif
 };
 
-CpuInitError initCpu        (CPU* cpu, int argc, char* argv[]);
-void         deleteCpu      (CPU* cpu);
-void         cpuSetError    (CPU* cpu, CpuError error);
-CpuError     executeProgram (CPU* cpu);
-void         dump           (CPU* cpu);
+inline FILE* getCpuMessages(const CPU* cpu)
+{
+    return cpu != NULL && cpu->messages != NULL ? cpu->messages : stdout;
+}
+
+// only the interpreter thread counts, so a relaxed load and store is enough, unlike ++ on the
+// atomic it isn't a locked instruction
+inline void countInstructions(CPU* cpu, uint64_t count)
+{
+    cpu->instructionsCount.store(cpu->instructionsCount.load(std::memory_order_relaxed) + count, std::memory_order_relaxed);
+}
+
+CpuInitError initCpu            (CPU* cpu, int argc, char* argv[]);
+CpuInitError initCpuFromImage   (CPU* cpu, BytecodeImage* image);
+void         deleteCpu          (CPU* cpu);
+void         cpuSetError        (CPU* cpu, CpuError error);
+CpuError     executeProgram     (CPU* cpu);
+CpuError     executeInstruction (CPU* cpu);
+void         dump               (CPU* cpu);
 
@@ -0,0 +1,691 @@
+#include <assert.h>
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "debugger.h"
+#include "instructions.h"
+#include "pages.h"
+#include "symbols.h"
+
+static const size_t DEBUGGER_NO_BREAKPOINT       = (size_t) -1;
+static const size_t DEBUGGER_DEFAULT_LIST_COUNT  = 10;
+static const size_t DEBUGGER_MAX_LOCATION_LENGTH = 128;
+
+static Debugger*        watchingDebugger = NULL; // signal handlers have no context parameter
+static struct sigaction oldSegvAction    = {};
+static struct sigaction oldBusAction     = {};
+
+bool     executeDebuggerCommand  (Debugger* debugger, char* command);
+CpuError resumeExecution         (Debugger* debugger, bool isSingleStep);
+void     stepInstruction         (Debugger* debugger);
+void     continueExecution       (Debugger* debugger);
+void     stepOverInstruction     (Debugger* debugger);
+bool     isStopped               (Debugger* debugger, CpuError status);
+void     reportStop              (Debugger* debugger, CpuError status);
+
+size_t   findBreakpoint          (Debugger* debugger, size_t offset);
+bool     setBreakpoint           (Debugger* debugger, size_t offset, bool isTemporary);
+void     removeBreakpoint        (Debugger* debugger, size_t index);
+bool     isInstructionStart      (Debugger* debugger, size_t offset);
+
+bool     setWatchpoint           (Debugger* debugger, size_t cell, bool isReadWatched);
+bool     removeWatchpoint        (Debugger* debugger, size_t cell);
+void     protectWatchedPages     (Debugger* debugger);
+void     unprotectWatchedPages   (Debugger* debugger);
+void     handleWatchFault        (int signalNumber, siginfo_t* info, void* context);
+
+bool     parseLocation           (Debugger* debugger, const char* string, size_t* offset);
+bool     parseCell               (Debugger* debugger, const char* string, size_t* cell);
+double   readCell                (Debugger* debugger, size_t cell);
+void     formatLocation          (Debugger* debugger, size_t offset, char* buffer, size_t bufferSize);
+void     printCurrentInstruction (Debugger* debugger);
+void     listInstructions        (Debugger* debugger, size_t offset, size_t count);
+void     printRegisters          (Debugger* debugger);
+void     printStack              (Debugger* debugger);
+void     printBacktrace          (Debugger* debugger);
+void     printMemory             (Debugger* debugger, size_t cell, size_t count);
+void     printDebuggerHelp       ();
+
+Debugger* newDebugger(CPU* cpu)
+{
+    assert(cpu != NULL);
+
+    Debugger* debugger = new Debugger();
+
+    debugger->cpu             = cpu;
+    debugger->symbols         = cpu->symbols;
+    debugger->originalProgram = (unsigned char*) calloc(cpu->programBytes, sizeof(unsigned char));
+    if (debugger->originalProgram == NULL) { delete debugger; return NULL; }
+
+    memcpy(debugger->originalProgram, cpu->program, cpu->programBytes);
+
+    struct sigaction action = {};
+    action.sa_sigaction = handleWatchFault;
+    action.sa_flags     = SA_SIGINFO;
+    sigemptyset(&action.sa_mask);
+
+    watchingDebugger = debugger;
+    sigaction(SIGSEGV, &action, &oldSegvAction);
+    sigaction(SIGBUS,  &action, &oldBusAction);
+
+    return debugger;
+}
+
+void deleteDebugger(Debugger* debugger)
+{
+    if (debugger == NULL) { return; }
+
+    unprotectWatchedPages(debugger);
+
+    if (watchingDebugger == debugger)
+    {
+        sigaction(SIGSEGV, &oldSegvAction, NULL);
+        sigaction(SIGBUS,  &oldBusAction,  NULL);
+
+        watchingDebugger = NULL;
+    }
+
+    // the program may be executed again without the debugger
+    memcpy(debugger->cpu->program, debugger->originalProgram, debugger->cpu->programBytes);
+
+    free(debugger->originalProgram);
+    delete debugger;
+}
+
+CpuError runDebugger(Debugger* debugger)
+{
+    assert(debugger != NULL);
+
+    printf("Debugger: %zu bytes of bytecode, %zu labels, type 'h' for help\n",
+           debugger->cpu->programBytes, debugger->symbols == NULL ? 0 : debugger->symbols->count);
+    printCurrentInstruction(debugger);
+
+    char command[DEBUGGER_MAX_COMMAND_LENGTH] = {};
+    while (true)
+    {
+        printf("(sdb) ");
+        fflush(stdout);
+
+        if (fgets(command, DEBUGGER_MAX_COMMAND_LENGTH, stdin) == NULL) { break; }
+        if (!executeDebuggerCommand(debugger, command))                { break; }
+    }
+
+    return debugger->cpu->status;
+}
+
+// returns false to quit
+bool executeDebuggerCommand(Debugger* debugger, char* command)
+{
+    assert(debugger != NULL);
+    assert(command  != NULL);
+
+    const char* name  = strtok(command, " \t\r\n");
+    const char* arg1  = strtok(NULL,    " \t\r\n");
+    const char* arg2  = strtok(NULL,    " \t\r\n");
+    size_t      value = 0;
+
+    if (name == NULL) { return true; }
+
+    if (strcmp(name, "q") == 0) { return false; }
+    if (strcmp(name, "h") == 0) { printDebuggerHelp(); return true; }
+    if (strcmp(name, "r") == 0) { printRegisters(debugger); return true; }
+    if (strcmp(name, "st") == 0) { printStack(debugger); return true; }
+    if (strcmp(name, "bt") == 0) { printBacktrace(debugger); return true; }
+
+    if (strcmp(name, "s") == 0 || strcmp(name, "n") == 0 || strcmp(name, "c") == 0)
+    {
+        if (debugger->isFinished) { printf("The program has finished\n"); return true; }
+
+        if (strcmp(name, "c") == 0) { continueExecution(debugger);   }
+        if (strcmp(name, "n") == 0) { stepOverInstruction(debugger); }
+        if (strcmp(name, "s") == 0)
+        {
+            size_t count = arg1 == NULL ? 1 : strtoul(arg1, NULL, 10);
+            for (size_t i = 0; i < count && !debugger->isFinished; i++) { stepInstruction(debugger); }
+        }
+
+        if (!debugger->isFinished) { printCurrentInstruction(debugger); }
+        return true;
+    }
+
+    if ((strcmp(name, "b") == 0 || strcmp(name, "d") == 0) && arg1 != NULL)
+    {
+        if (!parseLocation(debugger, arg1, &value)) { printf("Unknown location '%s'\n", arg1); return true; }
+
+        if (strcmp(name, "b") == 0)
+        {
+            if (setBreakpoint(debugger, value, false)) { printf("Breakpoint at 0x%08zX\n", value); }
+            return true;
+        }
+
+        size_t index = findBreakpoint(debugger, value);
+        if (index == DEBUGGER_NO_BREAKPOINT) { printf("No breakpoint at 0x%08zX\n", value); return true; }
+
+        removeBreakpoint(debugger, index);
+        return true;
+    }
+
+    if ((strcmp(name, "w") == 0 || strcmp(name, "rw") == 0 || strcmp(name, "uw") == 0) && arg1 != NULL)
+    {
+        if (!parseCell(debugger, arg1, &value)) { printf("Invalid RAM cell '%s'\n", arg1); return true; }
+
+        if (strcmp(name, "uw") == 0)
+        {
+            if (!removeWatchpoint(debugger, value)) { printf("No watchpoint on ram[%zu]\n", value); }
+            return true;
+        }
+
+        if (setWatchpoint(debugger, value, strcmp(name, "rw") == 0)) { printf("Watchpoint on ram[%zu]\n", value); }
+        return true;
+    }
+
+    if (strcmp(name, "m") == 0 && arg1 != NULL)
+    {
+        if (!parseCell(debugger, arg1, &value)) { printf("Invalid RAM cell '%s'\n", arg1); return true; }
+
+        printMemory(debugger, value, arg2 == NULL ? 1 : strtoul(arg2, NULL, 10));
+        return true;
+    }
+
+    if (strcmp(name, "l") == 0)
+    {
+        value = debugger->cpu->pc;
+        if (arg1 != NULL && !parseLocation(debugger, arg1, &value)) { printf("Unknown location '%s'\n", arg1); return true; }
+
+        listInstructions(debugger, value, arg2 == NULL ? DEBUGGER_DEFAULT_LIST_COUNT : strtoul(arg2, NULL, 10));
+        return true;
+    }
+
+    printf("Unknown command '%s', type 'h' for help\n", name);
+    return true;
+}
+
+// the program runs in the regular interpreter loop, watched pages are protected only while it runs
+CpuError resumeExecution(Debugger* debugger, bool isSingleStep)
+{
+    assert(debugger != NULL);
+
+    CPU* cpu = debugger->cpu;
+
+    protectWatchedPages(debugger);
+    CpuError status = isSingleStep ? executeInstruction(cpu) : executeProgram(cpu);
+    unprotectWatchedPages(debugger);
+
+    // the signal handler stops the loop after the instruction which touched a watched page
+    if (debugger->isWatchFaulted)
+    {
+        debugger->isWatchFaulted = 0;
+        if (status == CPU_NO_ERROR) { cpu->halt = false; }
+    }
+
+    // brk written in the program itself, rather than a breakpoint, is skipped
+    if (status == CPU_TRAP && findBreakpoint(debugger, cpu->pc) == DEBUGGER_NO_BREAKPOINT) { cpu->pc++; }
+
+    return status;
+}
+
+void stepInstruction(Debugger* debugger)
+{
+    assert(debugger != NULL);
+
+    CPU* cpu = debugger->cpu;
+
+    size_t index = findBreakpoint(debugger, cpu->pc);
+    if (index != DEBUGGER_NO_BREAKPOINT) { cpu->program[cpu->pc] = (char) debugger->breakpoints[index].opcode; }
+
+    size_t   breakpointOffset = cpu->pc;
+    CpuError status           = resumeExecution(debugger, true);
+
+    if (index != DEBUGGER_NO_BREAKPOINT) { cpu->program[breakpointOffset] = (char) CPU_CMD_brk; }
+
+    reportStop(debugger, status);
+}
+
+void continueExecution(Debugger* debugger)
+{
+    assert(debugger != NULL);
+
+    CPU* cpu = debugger->cpu;
+
+    // leave the current breakpoint first, otherwise it would trap right away
+    size_t index = findBreakpoint(debugger, cpu->pc);
+    if (index != DEBUGGER_NO_BREAKPOINT)
+    {
+        size_t breakpointOffset = cpu->pc;
+
+        cpu->program[breakpointOffset] = (char) debugger->breakpoints[index].opcode;
+        CpuError status = resumeExecution(debugger, true);
+        cpu->program[breakpointOffset] = (char) CPU_CMD_brk;
+
+        if (isStopped(debugger, status)) { reportStop(debugger, status); return; }
+    }
+
+    while (true)
+    {
+        CpuError status = resumeExecution(debugger, false);
+
+        // temporary breakpoints of 'n' only stop in the frame they were set in
+        index = status == CPU_TRAP ? findBreakpoint(debugger, cpu->pc) : DEBUGGER_NO_BREAKPOINT;
+        if (index != DEBUGGER_NO_BREAKPOINT && debugger->breakpoints[index].isTemporary &&
+            cpu->callStack.size > debugger->breakpoints[index].callDepth)
+        {
+            size_t breakpointOffset = cpu->pc;
+
+            cpu->program[breakpointOffset] = (char) debugger->breakpoints[index].opcode;
+            status = resumeExecution(debugger, true);
+            cpu->program[breakpointOffset] = (char) CPU_CMD_brk;
+        }
+
+        if (isStopped(debugger, status)) { reportStop(debugger, status); return; }
+    }
+}
+
+// steps over call, by running until a temporary breakpoint after it
+void stepOverInstruction(Debugger* debugger)
+{
+    assert(debugger != NULL);
+
+    CPU*   cpu    = debugger->cpu;
+    size_t length = getInstructionLength(&debugger->originalProgram[cpu->pc], cpu->programBytes - cpu->pc);
+
+    if (debugger->originalProgram[cpu->pc] != CPU_CMD_call || length == 0)
+    {
+        stepInstruction(debugger);
+        return;
+    }
+
+    size_t returnOffset = cpu->pc + length;
+    bool   isTemporary  = findBreakpoint(debugger, returnOffset) == DEBUGGER_NO_BREAKPOINT;
+    if (isTemporary && !setBreakpoint(debugger, returnOffset, true)) { return; }
+
+    continueExecution(debugger);
+
+    // it's removed even if the program stopped somewhere else
+    size_t index = findBreakpoint(debugger, returnOffset);
+    if (isTemporary && index != DEBUGGER_NO_BREAKPOINT) { removeBreakpoint(debugger, index); }
+}
+
+bool isStopped(Debugger* debugger, CpuError status)
+{
+    assert(debugger != NULL);
+
+    if (status != CPU_NO_ERROR || debugger->cpu->halt) { return true; }
+
+    for (size_t i = 0; i < debugger->watchpointsCount; i++)
+    {
+        if (debugger->watchpoints[i].isHit) { return true; }
+    }
+
+    return false;
+}
+
+void reportStop(Debugger* debugger, CpuError status)
+{
+    assert(debugger != NULL);
+
+    CPU* cpu = debugger->cpu;
+
+    for (size_t i = 0; i < debugger->watchpointsCount; i++)
+    {
+        Watchpoint* watchpoint = &debugger->watchpoints[i];
+        if (!watchpoint->isHit) { continue; }
+
+        double value = readCell(debugger, watchpoint->cell);
+        printf("Watchpoint ram[%zu]: %lg -> %lg\n", watchpoint->cell, watchpoint->lastValue, value);
+
+        watchpoint->lastValue = value;
+        watchpoint->isHit     = false;
+    }
+
+    char location[DEBUGGER_MAX_LOCATION_LENGTH] = {};
+
+    if (status == CPU_TRAP)
+    {
+        size_t index = findBreakpoint(debugger, cpu->pc);
+        if (index == DEBUGGER_NO_BREAKPOINT)
+        {
+            formatLocation(debugger, cpu->pc - 1, location, DEBUGGER_MAX_LOCATION_LENGTH);
+            printf("brk at %s\n", location);
+        }
+        else if (!debugger->breakpoints[index].isTemporary)
+        {
+            formatLocation(debugger, cpu->pc, location, DEBUGGER_MAX_LOCATION_LENGTH);
+            printf("Breakpoint at %s\n", location);
+        }
+    }
+    else if (status != CPU_NO_ERROR)
+    {
+        formatLocation(debugger, cpu->pc, location, DEBUGGER_MAX_LOCATION_LENGTH);
+        printf("Program stopped with error %d at %s after %llu instructions\n",
+               status, location, (unsigned long long) cpu->instructionsCount);
+        debugger->isFinished = true;
+    }
+    else if (cpu->halt)
+    {
+        printf("Program halted after %llu instructions\n", (unsigned long long) cpu->instructionsCount);
+        debugger->isFinished = true;
+    }
+}
+
+size_t findBreakpoint(Debugger* debugger, size_t offset)
+{
+    assert(debugger != NULL);
+
+    for (size_t i = 0; i < debugger->breakpointsCount; i++)
+    {
+        if (debugger->breakpoints[i].offset == offset) { return i; }
+    }
+
+    return DEBUGGER_NO_BREAKPOINT;
+}
+
+bool setBreakpoint(Debugger* debugger, size_t offset, bool isTemporary)
+{
+    assert(debugger != NULL);
+
+    if (findBreakpoint(debugger, offset) != DEBUGGER_NO_BREAKPOINT) { return true; }
+    if (debugger->breakpointsCount == DEBUGGER_MAX_BREAKPOINTS)     { printf("Too many breakpoints\n"); return false; }
+    if (!isInstructionStart(debugger, offset))                      { printf("0x%08zX is not an instruction\n", offset); return false; }
+
+    Breakpoint* breakpoint = &debugger->breakpoints[debugger->breakpointsCount++];
+    breakpoint->offset      = offset;
+    breakpoint->opcode      = debugger->originalProgram[offset];
+    breakpoint->isTemporary = isTemporary;
+    breakpoint->callDepth   = debugger->cpu->callStack.size;
+
+    debugger->cpu->program[offset] = (char) CPU_CMD_brk;
+
+    return true;
+}
+
+void removeBreakpoint(Debugger* debugger, size_t index)
+{
+    assert(debugger != NULL);
+    assert(index < debugger->breakpointsCount);
+
+    Breakpoint* breakpoint = &debugger->breakpoints[index];
+    debugger->cpu->program[breakpoint->offset] = (char) breakpoint->opcode;
+
+    *breakpoint = debugger->breakpoints[--debugger->breakpointsCount];
+}
+
+bool isInstructionStart(Debugger* debugger, size_t offset)
+{
+    assert(debugger != NULL);
+
+    size_t currOffset = 0;
+    while (currOffset < offset)
+    {
+        size_t length = getInstructionLength(&debugger->originalProgram[currOffset], debugger->cpu->programBytes - currOffset);
+        if (length == 0) { return false; }
+
+        currOffset += length;
+    }
+
+    return currOffset == offset && offset < debugger->cpu->programBytes;
+}
+
+bool setWatchpoint(Debugger* debugger, size_t cell, bool isReadWatched)
+{
+    assert(debugger != NULL);
+
+    if (debugger->watchpointsCount == DEBUGGER_MAX_WATCHPOINTS) { printf("Too many watchpoints\n"); return false; }
+    if (!isRamCell(&debugger->cpu->ram, cell))                   { printf("ram[%zu] is out of RAM\n", cell); return false; }
+
+    Watchpoint* watchpoint = &debugger->watchpoints[debugger->watchpointsCount++];
+    watchpoint->cell          = cell;
+    watchpoint->isReadWatched = isReadWatched;
+    watchpoint->lastValue     = readCell(debugger, cell);
+    watchpoint->isHit         = false;
+
+    if (cell < debugger->cpu->ram.cellsCount)
+    {
+        watchpoint->address = (unsigned char*) &debugger->cpu->ram.cells[cell];
+        watchpoint->size    = sizeof(double);
+    }
+    else
+    {
+        watchpoint->address = &debugger->cpu->ram.vram[cell - debugger->cpu->ram.vramStart];
+        watchpoint->size    = sizeof(unsigned char);
+    }
+
+    return true;
+}
+
+bool removeWatchpoint(Debugger* debugger, size_t cell)
+{
+    assert(debugger != NULL);
+
+    for (size_t i = 0; i < debugger->watchpointsCount; i++)
+    {
+        if (debugger->watchpoints[i].cell == cell)
+        {
+            debugger->watchpoints[i] = debugger->watchpoints[--debugger->watchpointsCount];
+            return true;
+        }
+    }
+
+    return false;
+}
+
+// read watches are applied last, as they are stricter when a page has both kinds
+void protectWatchedPages(Debugger* debugger)
+{
+    assert(debugger != NULL);
+
+    for (size_t i = 0; i < debugger->watchpointsCount; i++)
+    {
+        Watchpoint* watchpoint = &debugger->watchpoints[i];
+        if (!watchpoint->isReadWatched) { protectPages(watchpoint->address, watchpoint->size, PAGE_ACCESS_READ); }
+    }
+
+    for (size_t i = 0; i < debugger->watchpointsCount; i++)
+    {
+        Watchpoint* watchpoint = &debugger->watchpoints[i];
+        if (watchpoint->isReadWatched) { protectPages(watchpoint->address, watchpoint->size, PAGE_ACCESS_NONE); }
+    }
+}
+
+void unprotectWatchedPages(Debugger* debugger)
+{
+    assert(debugger != NULL);
+
+    for (size_t i = 0; i < debugger->watchpointsCount; i++)
+    {
+        protectPages(debugger->watchpoints[i].address, debugger->watchpoints[i].size, PAGE_ACCESS_READ_WRITE);
+    }
+}
+
+// unprotects the page, so that the instruction can finish, and stops the interpreter loop after it
+void handleWatchFault(int signalNumber, siginfo_t* info, void* context)
+{
+    Debugger*      debugger     = watchingDebugger;
+    unsigned char* faultAddress = (unsigned char*) info->si_addr;
+    size_t         pageSize     = getPageSize();
+    bool           isWatched    = false;
+
+    for (size_t i = 0; debugger != NULL && i < debugger->watchpointsCount; i++)
+    {
+        Watchpoint*    watchpoint = &debugger->watchpoints[i];
+        unsigned char* firstPage  = (unsigned char*) ((size_t) watchpoint->address / pageSize * pageSize);
+        unsigned char* pagesEnd   = (unsigned char*) roundUpToPages((size_t) watchpoint->address + watchpoint->size);
+
+        if (faultAddress >= firstPage && faultAddress < pagesEnd)
+        {
+            isWatched = true;
+            if (faultAddress < watchpoint->address + watchpoint->size &&
+                faultAddress + sizeof(double) > watchpoint->address) { watchpoint->isHit = true; }
+        }
+    }
+
+    if (isWatched)
+    {
+        protectPages(faultAddress, 1, PAGE_ACCESS_READ_WRITE);
+
+        debugger->isWatchFaulted = 1;
+        debugger->cpu->halt      = true;
+        return;
+    }
+
+    // not ours, pass it on to the previous handler
+    struct sigaction* oldAction = signalNumber == SIGSEGV ? &oldSegvAction : &oldBusAction;
+
+    if (oldAction->sa_flags & SA_SIGINFO)                                     { oldAction->sa_sigaction(signalNumber, info, context); return; }
+    if (oldAction->sa_handler != SIG_DFL && oldAction->sa_handler != SIG_IGN) { oldAction->sa_handler(signalNumber); return; }
+
+    signal(signalNumber, SIG_DFL);
+    raise(signalNumber);
+}
+
+// location is a label name or an offset in the bytecode
+bool parseLocation(Debugger* debugger, const char* string, size_t* offset)
+{
+    assert(debugger != NULL);
+    assert(string   != NULL);
+    assert(offset   != NULL);
+
+    const Symbol* symbol = findSymbol(debugger->symbols, string);
+    if (symbol != NULL) { *offset = symbol->offset; return true; }
+
+    char* end = NULL;
+    *offset = strtoul(string, &end, 0);
+
+    return *end == '\0' && *offset < debugger->cpu->programBytes;
+}
+
+bool parseCell(Debugger* debugger, const char* string, size_t* cell)
+{
+    assert(debugger != NULL);
+    assert(string   != NULL);
+    assert(cell     != NULL);
+
+    char* end = NULL;
+    *cell = strtoul(string, &end, 0);
+
+    return *end == '\0' && isRamCell(&debugger->cpu->ram, *cell);
+}
+
+double readCell(Debugger* debugger, size_t cell)
+{
+    assert(debugger != NULL);
+
+    return readRam(&debugger->cpu->ram, cell);
+}
+
+void formatLocation(Debugger* debugger, size_t offset, char* buffer, size_t bufferSize)
+{
+    assert(debugger != NULL);
+    assert(buffer   != NULL);
+
+    const Symbol* symbol = findNearestSymbol(debugger->symbols, offset);
+
+    if      (symbol == NULL)           { snprintf(buffer, bufferSize, "0x%08zX", offset); }
+    else if (symbol->offset == offset) { snprintf(buffer, bufferSize, "0x%08zX <%s>", offset, symbol->name); }
+    else                               { snprintf(buffer, bufferSize, "0x%08zX <%s+%zu>", offset, symbol->name, offset - symbol->offset); }
+}
+
+void printCurrentInstruction(Debugger* debugger)
+{
+    assert(debugger != NULL);
+
+    listInstructions(debugger, debugger->cpu->pc, 1);
+}
+
+void listInstructions(Debugger* debugger, size_t offset, size_t count)
+{
+    assert(debugger != NULL);
+
+    CPU* cpu = debugger->cpu;
+
+    char location[DEBUGGER_MAX_LOCATION_LENGTH]  = {};
+    char instruction[MAX_INSTRUCTION_STR_LENGTH] = {};
+
+    for (size_t i = 0; i < count && offset < cpu->programBytes; i++)
+    {
+        size_t length = formatInstruction(instruction, MAX_INSTRUCTION_STR_LENGTH,
+                                          &debugger->originalProgram[offset], cpu->programBytes - offset);
+        if (length == 0) { printf("invalid instruction at 0x%08zX\n", offset); return; }
+
+        formatLocation(debugger, offset, location, DEBUGGER_MAX_LOCATION_LENGTH);
+        printf("%c%c %-32s %s\n",
+               offset == cpu->pc                                            ? '>' : ' ',
+               findBreakpoint(debugger, offset) != DEBUGGER_NO_BREAKPOINT   ? '*' : ' ',
+               location, instruction);
+
+        offset += length;
+    }
+}
+
+void printRegisters(Debugger* debugger)
+{
+    assert(debugger != NULL);
+
+    for (size_t i = 0; i < CPU_REGISTERS_COUNT; i++)
+    {
+        printf("r%cx = %-14lg%s", (char) ('a' + i), debugger->cpu->regs[i], i % 4 == 3 ? "\n" : " ");
+    }
+
+    printf("\n");
+}
+
+// top of the stack first
+void printStack(Debugger* debugger)
+{
+    assert(debugger != NULL);
+
+    OperandStack* stack = &debugger->cpu->stack;
+    size_t        size  = getOperandStackSize(stack);
+    if (size == 0) { printf("stack is empty\n"); return; }
+
+    for (size_t i = size; i > 0; i--)
+    {
+        printf("[%zu] %lg\n", i - 1, stack->base[i - 1]);
+    }
+}
+
+void printBacktrace(Debugger* debugger)
+{
+    assert(debugger != NULL);
+
+    CPU* cpu = debugger->cpu;
+    char location[DEBUGGER_MAX_LOCATION_LENGTH] = {};
+
+    formatLocation(debugger, cpu->pc, location, DEBUGGER_MAX_LOCATION_LENGTH);
+    printf("#0 %s\n", location);
+
+    for (size_t i = cpu->callStack.size; i > 0; i--)
+    {
+        formatLocation(debugger, (size_t) cpu->callStack.dynamicArray[i - 1], location, DEBUGGER_MAX_LOCATION_LENGTH);
+        printf("#%zu %s\n", cpu->callStack.size - i + 1, location);
+    }
+}
+
+void printMemory(Debugger* debugger, size_t cell, size_t count)
+{
+    assert(debugger != NULL);
+
+    for (size_t i = cell; i < cell + count && isRamCell(&debugger->cpu->ram, i); i++)
+    {
+        printf("ram[%zu] = %lg\n", i, readCell(debugger, i));
+    }
+}
+
+void printDebuggerHelp()
+{
+    printf("c                 continue\n"
+           "s [n]             step n instructions\n"
+           "n                 step over call\n"
+           "b <location>      set breakpoint at a label or an offset\n"
+           "d <location>      delete breakpoint\n"
+           "w <cell>          watch writes to a RAM cell\n"
+           "rw <cell>         watch reads and writes of a RAM cell\n"
+           "uw <cell>         remove watchpoint\n"
+           "l [location] [n]  list n instructions\n"
+           "r                 registers\n"
+           "st                stack\n"
+           "bt                call stack\n"
+           "m <cell> [n]      print n RAM cells\n"
+           "q                 quit\n");
+}
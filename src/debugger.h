@@ -0,0 +1,49 @@
+#pragma once
+#include <signal.h>
+#include <stddef.h>
+#include "cpu_specification.h"
+
+// Breakpoints replace the first byte of an instruction with the brk opcode, so the program
+// runs in the regular interpreter loop until it reaches one. Watchpoints protect the pages
+// of RAM with the watched cells and catch accesses to them in a SIGSEGV handler.
+
+static const size_t DEBUGGER_MAX_BREAKPOINTS    = 256;
+static const size_t DEBUGGER_MAX_WATCHPOINTS    = 16;
+static const size_t DEBUGGER_MAX_COMMAND_LENGTH = 256;
+
+struct Breakpoint
+{
+    size_t        offset      = 0;
+    unsigned char opcode      = 0; // replaced by brk
+    bool          isTemporary = false; // set by 'n', stops only when the call stack is back to callDepth
+    size_t        callDepth   = 0;
+};
+
+struct Watchpoint
+{
+    size_t         cell          = 0;
+    unsigned char* address       = NULL;
+    size_t         size          = 0;
+    bool           isReadWatched = false; // otherwise only writes are caught
+    double         lastValue     = 0;
+    bool           isHit         = false;
+};
+
+struct Debugger
+{
+    CPU*                  cpu              = NULL;
+    unsigned char*        originalProgram  = NULL; // without breakpoints
+    const SymbolTable*    symbols          = NULL;
+
+    Breakpoint            breakpoints[DEBUGGER_MAX_BREAKPOINTS] = {};
+    size_t                breakpointsCount = 0;
+    Watchpoint            watchpoints[DEBUGGER_MAX_WATCHPOINTS] = {};
+    size_t                watchpointsCount = 0;
+
+    volatile sig_atomic_t isWatchFaulted   = 0; // a watched page was unprotected by the signal handler
+    bool                  isFinished       = false;
+};
+
+Debugger* newDebugger    (CPU* cpu);
+void      deleteDebugger (Debugger* debugger);
+CpuError  runDebugger    (Debugger* debugger);
@@ -0,0 +1,211 @@
+#include <assert.h>
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <sys/types.h>
+#include <chrono>
+
+#include "devices.h"
+
+struct DeviceBus
+{
+    double*                               cells       = NULL;
+    size_t                                cellsCount  = 0;
+
+    std::chrono::steady_clock::time_point start       = {};
+
+    Display*                              display     = NULL;
+    int32_t                               key         = 0; // written to DEVICE_INPUT_KEY
+
+    // the registers of the block device are kept as written and checked by the commands
+    FILE*                                 blockFile   = NULL;
+    double                                fileCell    = 0;
+    double                                ramCell     = 0;
+    double                                count       = 0;
+    BlockStatus                           status      = BLOCK_STATUS_OK;
+    size_t                                transferred = 0;
+};
+
+double      readInput         (DeviceBus* bus, size_t registerCell);
+void        runBlockCommand   (DeviceBus* bus, double command);
+BlockStatus transferBlock     (DeviceBus* bus, BlockCommand command);
+size_t      getBlockFileCells (DeviceBus* bus);
+bool        getCellsValue     (double value, size_t* cells);
+
+DeviceBus* newDeviceBus(double* cells, size_t cellsCount, Display* display, const char* blockFileName, FILE* messages)
+{
+    assert(cells    != NULL || cellsCount == 0);
+    assert(messages != NULL);
+
+    DeviceBus* bus = (DeviceBus*) calloc(1, sizeof(DeviceBus));
+    if (bus == NULL) { return NULL; }
+
+    *bus = {};
+    bus->cells      = cells;
+    bus->cellsCount = cellsCount;
+    bus->start      = std::chrono::steady_clock::now();
+    bus->display    = display;
+
+    if (blockFileName != NULL)
+    {
+        bus->blockFile = fopen(blockFileName, "r+b");
+        if (bus->blockFile == NULL) { bus->blockFile = fopen(blockFileName, "w+b"); }
+
+        if (bus->blockFile == NULL)
+        {
+            fprintf(messages, "Cpu error: couldn't open block device file '%s'\n", blockFileName);
+            free(bus);
+            return NULL;
+        }
+    }
+
+    return bus;
+}
+
+void deleteDeviceBus(DeviceBus* bus)
+{
+    if (bus == NULL) { return; }
+
+    if (bus->blockFile != NULL) { fclose(bus->blockFile); }
+    free(bus);
+}
+
+double readDevice(DeviceBus* bus, size_t registerCell)
+{
+    assert(bus != NULL);
+
+    switch (registerCell)
+    {
+        case DEVICE_TIMER_NANOSECONDS:
+        case DEVICE_TIMER_SECONDS:
+        {
+            double nanoseconds = (double) std::chrono::duration_cast<std::chrono::nanoseconds>(
+                                     std::chrono::steady_clock::now() - bus->start).count();
+
+            return registerCell == DEVICE_TIMER_SECONDS ? nanoseconds / 1e9 : nanoseconds;
+        }
+
+        case DEVICE_INPUT_MOUSE_X:
+        case DEVICE_INPUT_MOUSE_Y:
+        case DEVICE_INPUT_MOUSE_BUTTONS:
+        case DEVICE_INPUT_LAST_KEY:
+        case DEVICE_INPUT_KEY_PRESSES:
+        case DEVICE_INPUT_KEY:
+        case DEVICE_INPUT_KEY_HELD:     { return readInput(bus, registerCell); }
+
+        case DEVICE_BLOCK_FILE_CELL:    { return bus->fileCell;                   }
+        case DEVICE_BLOCK_RAM_CELL:     { return bus->ramCell;                    }
+        case DEVICE_BLOCK_COUNT:        { return bus->count;                      }
+        case DEVICE_BLOCK_STATUS:       { return (double) bus->status;            }
+        case DEVICE_BLOCK_TRANSFERRED:  { return (double) bus->transferred;       }
+        case DEVICE_BLOCK_FILE_CELLS:   { return (double) getBlockFileCells(bus); }
+
+        default:                        { return 0; } // DEVICE_BLOCK_COMMAND too, transfers are done at once
+    }
+}
+
+void writeDevice(DeviceBus* bus, size_t registerCell, double value)
+{
+    assert(bus != NULL);
+
+    switch (registerCell)
+    {
+        case DEVICE_INPUT_KEY:       { bus->key      = (int32_t) value; break; }
+
+        case DEVICE_BLOCK_COMMAND:   { runBlockCommand(bus, value);     break; }
+        case DEVICE_BLOCK_FILE_CELL: { bus->fileCell = value;           break; }
+        case DEVICE_BLOCK_RAM_CELL:  { bus->ramCell  = value;           break; }
+        case DEVICE_BLOCK_COUNT:     { bus->count    = value;           break; }
+
+        default:                     { break; }
+    }
+}
+
+// the events are polled on every read, so that programs which wait for input see it without upd
+double readInput(DeviceBus* bus, size_t registerCell)
+{
+    assert(bus != NULL);
+
+    if (registerCell == DEVICE_INPUT_KEY) { return (double) bus->key; }
+    if (bus->display == NULL)             { return 0; }
+
+    pollDisplayEvents(bus->display);
+
+    DisplayInput input = {};
+    getDisplayInput(bus->display, &input);
+
+    switch (registerCell)
+    {
+        case DEVICE_INPUT_MOUSE_X:       { return input.mouseX;                                     }
+        case DEVICE_INPUT_MOUSE_Y:       { return input.mouseY;                                     }
+        case DEVICE_INPUT_MOUSE_BUTTONS: { return (double) input.mouseButtons;                      }
+        case DEVICE_INPUT_LAST_KEY:      { return (double) input.lastKey;                           }
+        case DEVICE_INPUT_KEY_PRESSES:   { return (double) input.keyPresses;                        }
+        default:                         { return isDisplayKeyHeld(bus->display, bus->key) ? 1 : 0; }
+    }
+}
+
+void runBlockCommand(DeviceBus* bus, double command)
+{
+    assert(bus != NULL);
+
+    bus->transferred = 0;
+
+    if      (bus->blockFile == NULL)                                         { bus->status = BLOCK_STATUS_NO_FILE;         }
+    else if (command != BLOCK_COMMAND_READ && command != BLOCK_COMMAND_WRITE) { bus->status = BLOCK_STATUS_INVALID_COMMAND; }
+    else                                                                     { bus->status = transferBlock(bus, (BlockCommand) command); }
+}
+
+// straight between the file and the RAM cells, the cells are the raw doubles of the host
+BlockStatus transferBlock(DeviceBus* bus, BlockCommand command)
+{
+    assert(bus != NULL);
+
+    size_t fileCell = 0;
+    size_t ramCell  = 0;
+    size_t count    = 0;
+
+    if (!getCellsValue(bus->fileCell, &fileCell) || !getCellsValue(bus->ramCell, &ramCell) || !getCellsValue(bus->count, &count) ||
+        ramCell > bus->cellsCount || count > bus->cellsCount - ramCell)
+    {
+        return BLOCK_STATUS_INVALID_RANGE;
+    }
+
+    clearerr(bus->blockFile);
+    if (fseeko(bus->blockFile, (off_t) (fileCell * sizeof(double)), SEEK_SET) != 0) { return BLOCK_STATUS_IO_ERROR; }
+
+    if (command == BLOCK_COMMAND_READ)
+    {
+        bus->transferred = fread(bus->cells + ramCell, sizeof(double), count, bus->blockFile);
+        if (bus->transferred == count) { return BLOCK_STATUS_OK; }
+
+        return ferror(bus->blockFile) ? BLOCK_STATUS_IO_ERROR : BLOCK_STATUS_END_OF_FILE;
+    }
+
+    bus->transferred = fwrite(bus->cells + ramCell, sizeof(double), count, bus->blockFile);
+
+    return bus->transferred == count && fflush(bus->blockFile) == 0 ? BLOCK_STATUS_OK : BLOCK_STATUS_IO_ERROR;
+}
+
+size_t getBlockFileCells(DeviceBus* bus)
+{
+    assert(bus != NULL);
+
+    if (bus->blockFile == NULL || fseeko(bus->blockFile, 0, SEEK_END) != 0) { return 0; }
+
+    off_t size = ftello(bus->blockFile);
+
+    return size > 0 ? (size_t) size / sizeof(double) : 0;
+}
+
+// a whole number of cells which fits into a file offset
+bool getCellsValue(double value, size_t* cells)
+{
+    assert(cells != NULL);
+
+    if (!(value >= 0 && value < (double) ((uint64_t) 1 << 53) / sizeof(double)) || value != floor(value)) { return false; }
+
+    *cells = (size_t) value;
+
+    return true;
+}
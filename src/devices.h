@@ -0,0 +1,66 @@
+#pragma once
+#include <stddef.h>
+#include <stdint.h>
+#include "display.h"
+
+// Devices are mapped into the addresses of the CPU from the device base on (--devices, 2^32 by
+// default), their registers are read and written as cells with push [cell] and pop [cell]:
+//
+//     base + 0   timer, monotonic time since the CPU was created
+//     base + 16  input, the state of the mouse and the keyboard from the events of the display
+//     base + 32  block device, copies cells between a file (--block) and the RAM in one command
+//
+// Registers which aren't listed read as 0 and ignore writes.
+
+enum DeviceRegister
+{
+    DEVICE_TIMER_NANOSECONDS   = 0,
+    DEVICE_TIMER_SECONDS       = 1,
+
+    DEVICE_INPUT_MOUSE_X       = 16,
+    DEVICE_INPUT_MOUSE_Y       = 17,
+    DEVICE_INPUT_MOUSE_BUTTONS = 18, // bit i is set while the button i + 1 is held
+    DEVICE_INPUT_LAST_KEY      = 19, // SDL key code of the last key pressed
+    DEVICE_INPUT_KEY_PRESSES   = 20, // changes with every key pressed
+    DEVICE_INPUT_KEY           = 21, // a key code written here...
+    DEVICE_INPUT_KEY_HELD      = 22, // ...reads as 1 here while the key is held
+
+    DEVICE_BLOCK_COMMAND       = 32, // BlockCommand, the transfer is done when the write returns
+    DEVICE_BLOCK_FILE_CELL     = 33, // in cells of 8 bytes from the start of the file
+    DEVICE_BLOCK_RAM_CELL      = 34,
+    DEVICE_BLOCK_COUNT         = 35, // cells to transfer
+    DEVICE_BLOCK_STATUS        = 36, // BlockStatus of the last command
+    DEVICE_BLOCK_TRANSFERRED   = 37, // cells transferred by the last command
+    DEVICE_BLOCK_FILE_CELLS    = 38  // size of the file in cells
+};
+
+enum BlockCommand
+{
+    BLOCK_COMMAND_NONE,
+    BLOCK_COMMAND_READ,  // file to RAM
+    BLOCK_COMMAND_WRITE  // RAM to file
+};
+
+enum BlockStatus
+{
+    BLOCK_STATUS_OK,
+    BLOCK_STATUS_NO_FILE,
+    BLOCK_STATUS_INVALID_COMMAND,
+    BLOCK_STATUS_INVALID_RANGE,
+    BLOCK_STATUS_END_OF_FILE, // a read stopped at the end of the file, see DEVICE_BLOCK_TRANSFERRED
+    BLOCK_STATUS_IO_ERROR
+};
+
+static const size_t DEVICE_BUS_CELLS     = 48;
+static const size_t DEVICE_DEFAULT_START = (size_t) 1 << 32;
+
+struct DeviceBus;
+
+// cells are the RAM the block device transfers to and from, display can be NULL (no input), and
+// blockFileName too (no block device); the file is created if it doesn't exist
+DeviceBus* newDeviceBus    (double* cells, size_t cellsCount, Display* display, const char* blockFileName, FILE* messages);
+void       deleteDeviceBus (DeviceBus* bus);
+
+// registerCell is the cell from the device base, below DEVICE_BUS_CELLS
+double     readDevice      (DeviceBus* bus, size_t registerCell);
+void       writeDevice     (DeviceBus* bus, size_t registerCell, double value);
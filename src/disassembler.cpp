@@ -2,16 +2,18 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
-#include "..\libs\file_manager.h"
 
+#include "bytecode.h"
 #include "cpu_specification.h"
-#include "assembler_specification.h"
 #include "disassembler_specification.h"
+#include "instructions.h"
 
 const char*  DEFAULT_DISASSEMBLY_FILE_NAME = "bin/disassembly.asy";
-const size_t MAX_LITERAL_STR_LENGTH        = 32;
 
-void pushBackStringToken(DynamicArray* arr, const char* token);
+bool parseOffset      (const char* string, size_t* offset);
+bool openBytecodeFile (Disassembler* disassembler, const char* bytecodeFileName);
+bool fillInput        (Disassembler* disassembler);
+bool flushOutput      (Disassembler* disassembler);
 
 int main(int argc, char* argv[])
 {
@@ -39,30 +41,36 @@ DisassemblerInitError initDisassembler(Disassembler* disassembler, int argc, cha
     const char* bytecodeFileName    = NULL;
     const char* disassemblyFileName = DEFAULT_DISASSEMBLY_FILE_NAME;
     bytecodeFileName = argv[1];
-    if (argc >= 3)
+
+    for (int i = 2; i < argc; i++)
     {
-        disassemblyFileName = argv[2];
+        if (strcmp(argv[i], "--range") == 0)
+        {
+            if (i + 2 >= argc || !parseOffset(argv[i + 1], &disassembler->rangeStart) || !parseOffset(argv[i + 2], &disassembler->rangeEnd))
+            {
+                DISASM_INIT_ERROR(DISASSEMBLER_INIT_INVALID_OPTION);
+            }
+
+            i += 2;
+        }
+        else if (argv[i][0] == '-')
+        {
+            printf("Unknown option '%s'.\n", argv[i]);
+            DISASM_INIT_ERROR(DISASSEMBLER_INIT_INVALID_OPTION);
+        }
+        else
+        {
+            disassemblyFileName = argv[i];
+        }
     }
 
     if (bytecodeFileName    == NULL) { DISASM_INIT_ERROR(DISASSEMBLER_INIT_BCD_FILE_UNSPECIFIED); }
     if (disassemblyFileName == NULL) { DISASM_INIT_ERROR(DISASSEMBLER_INIT_DISASSEMBLY_FILE_WRITE_ERROR); }
 
-    disassembler->bytecodeSize = getFileSize(bytecodeFileName);
-    disassembler->bytecode     = (unsigned char*) calloc(disassembler->bytecodeSize, sizeof(unsigned char));
-    if (disassembler->bytecode == NULL) { DISASM_INIT_ERROR(DISASSEMBLER_INIT_NOT_ENOUGH_MEMORY); }
-
-    FILE* bytecodeFile = fopen(bytecodeFileName, "rb");
-    if (bytecodeFile == NULL) { DISASM_INIT_ERROR(DISASSEMBLER_INIT_BYTECODE_FILE_READ_ERROR); }
-
-    if (fread(disassembler->bytecode, sizeof(unsigned char), disassembler->bytecodeSize, bytecodeFile) != disassembler->bytecodeSize) 
-  	{ 
-  		DISASM_INIT_ERROR(DISASSEMBLER_INIT_BYTECODE_FILE_READ_ERROR);
-  	}
-
-    fclose(bytecodeFile);
+    if (!openBytecodeFile(disassembler, bytecodeFileName)) { DISASM_INIT_ERROR(DISASSEMBLER_INIT_BYTECODE_FILE_READ_ERROR); }
 
-    disassembler->disassembled = newDynamicArray();
-    if (disassembler->disassembled == NULL) { DISASM_INIT_ERROR(DISASSEMBLER_INIT_NOT_ENOUGH_MEMORY); }
+    disassembler->output = (char*) calloc(DISASSEMBLER_OUTPUT_BUFFER_SIZE, sizeof(char));
+    if (disassembler->output == NULL) { DISASM_INIT_ERROR(DISASSEMBLER_INIT_NOT_ENOUGH_MEMORY); }
 
     disassembler->disassemblyFile = fopen(disassemblyFileName, "w");
     if (disassembler->disassemblyFile == NULL) { DISASM_INIT_ERROR(DISASSEMBLER_INIT_DISASSEMBLY_FILE_WRITE_ERROR); }
@@ -74,19 +82,20 @@ void finishDisassembler(Disassembler* disassembler)
 {
     assert(disassembler != NULL);
 
-    if (disassembler->bytecode != NULL)
+    if (disassembler->bytecodeFile != NULL)
     {
-        free(disassembler->bytecode);
-        disassembler->bytecode = NULL;
+        fclose(disassembler->bytecodeFile);
+        disassembler->bytecodeFile = NULL;
     }
 
-    disassembler->bytecodeSize = 0;
+    free(disassembler->input);
+    disassembler->input     = NULL;
+    disassembler->inputSize = 0;
+    disassembler->inputPos  = 0;
 
-    if (disassembler->disassembled != NULL)
-    {
-        deleteDynamicArray(disassembler->disassembled);
-        disassembler->disassembled = NULL;
-    }
+    free(disassembler->output);
+    disassembler->output     = NULL;
+    disassembler->outputSize = 0;
 
     if (disassembler->disassemblyFile != NULL)
     {
@@ -95,103 +104,136 @@ void finishDisassembler(Disassembler* disassembler)
     }
 }
 
+// instructions are decoded straight from the input buffer and written into the output buffer,
+// those before the range are only measured
 bool disassemble(Disassembler* disassembler)
 {
     assert(disassembler                  != NULL);
-    assert(disassembler->bytecode        != NULL);
-    assert(disassembler->disassembled    != NULL);
+    assert(disassembler->input           != NULL);
+    assert(disassembler->output          != NULL);
     assert(disassembler->disassemblyFile != NULL);
 
-    size_t        numOfArgs = 0;
-    unsigned char argType   = 0;
-    double        temp      = 0;
-
-    char* auxBuffer = (char*) calloc(MAX_LITERAL_STR_LENGTH, sizeof(char));
-    if (auxBuffer == NULL) { printf("ERROR: Not enough RAM.\n"); return false; }
-
-    for (unsigned char* currByte = disassembler->bytecode; currByte - disassembler->bytecode < disassembler->bytecodeSize;)
+    while (true)
     {
-   	    // command number
-   	    if (*currByte >= CPU_COMMANDS_COUNT) { printf("ERROR: Invalid command number (%u).\n", *currByte); return false; }
-
-   	    pushBackStringToken(disassembler->disassembled, assemblerCommands[*currByte]);
+        if (!fillInput(disassembler)) { printf("ERROR: Couldn't read bytecode file.\n"); return false; }
+
+        size_t               bytesLeft   = disassembler->inputSize - disassembler->inputPos;
+        size_t               offset      = disassembler->inputOffset + disassembler->inputPos;
+        const unsigned char* instruction = disassembler->input + disassembler->inputPos;
+        if (bytesLeft == 0 || offset >= disassembler->rangeEnd) { break; }
+
+        // command number
+        if (*instruction >= CPU_COMMANDS_COUNT) { printf("ERROR: Invalid command number (%u) at offset %zu.\n", *instruction, offset); return false; }
+
+        size_t instrLength = 0;
+        if (offset < disassembler->rangeStart)
+        {
+            instrLength = getInstructionLength(instruction, bytesLeft);
+        }
+        else
+        {
+            if (disassembler->outputSize + MAX_INSTRUCTION_STR_LENGTH + 1 > DISASSEMBLER_OUTPUT_BUFFER_SIZE && !flushOutput(disassembler))
+            {
+                return false;
+            }
 
-   	    #define DEFINE_CMD(name, number, args, isControlFlow, code) if (*currByte == number) { numOfArgs = args; }
-   	    #include "cpu_commands.h"
-   	    #undef DEFINE_CMD
+            char* formatted = disassembler->output + disassembler->outputSize;
+            instrLength     = formatInstruction(formatted, MAX_INSTRUCTION_STR_LENGTH, instruction, bytesLeft);
 
-        currByte++;
-   	    for (size_t j = 0; j < numOfArgs; j++)
-   	    {
-            argType = *currByte;
-            currByte++; 
+            disassembler->outputSize += strlen(formatted);
+            disassembler->output[disassembler->outputSize++] = '\n';
+        }
 
-            if (argType == 0) { printf("ERROR: Invalid argument type (%u).\n", argType); return false; }
+        if (instrLength == 0)
+        {
+            printf("ERROR: Invalid arguments of command '%s' at offset %zu.\n", getInstructionName(*instruction), offset);
+            return false;
+        }
 
-            // ram specifier
-            if ((argType & CPU_ARGUMENT_MASK_RAM) != 0)
-            {
-                pushBackStringToken(disassembler->disassembled, " [");
-            }
+        disassembler->inputPos += instrLength;
+    }
 
-            // register specifier
-            if ((argType & CPU_ARGUMENT_MASK_REG) != 0)
-            {
-                pushBackStringToken(disassembler->disassembled, " r");
-                pushBack(disassembler->disassembled, 'a' + *currByte - 1);
-                pushBackStringToken(disassembler->disassembled, "x ");
+    return flushOutput(disassembler);
+}
 
-                currByte++;
-            }
+bool parseOffset(const char* string, size_t* offset)
+{
+    assert(string != NULL);
+    assert(offset != NULL);
 
-            // both register and const specifier
-            if ((argType & CPU_ARGUMENT_MASK_REG) != 0 && (argType & CPU_ARGUMENT_MASK_CST) != 0)
-            {
-                pushBackStringToken(disassembler->disassembled, " + ");
-            }
+    char* end = NULL;
+    *offset   = strtoul(string, &end, 0);
 
-            // const specifier
-            if ((argType & CPU_ARGUMENT_MASK_CST) != 0)
-            {
+    return end != string && *end == '\0';
+}
 
-                temp = *((double*) currByte);
-                sprintf(auxBuffer, " %lg ", temp);
-                pushBackStringToken(disassembler->disassembled, auxBuffer);
+// old wide files, without a header, are compacted as a whole, so jump targets are always
+// printed as compact offsets
+bool openBytecodeFile(Disassembler* disassembler, const char* bytecodeFileName)
+{
+    assert(disassembler     != NULL);
+    assert(bytecodeFileName != NULL);
 
-                currByte += sizeof(temp);
-            }
+    disassembler->bytecodeFile = fopen(bytecodeFileName, "rb");
+    if (disassembler->bytecodeFile == NULL) { return false; }
 
-            // ram specifier
-            if ((argType & CPU_ARGUMENT_MASK_RAM) != 0)
-            {
-                pushBackStringToken(disassembler->disassembled, " ] ");
-            }
-   	    }
+    BytecodeHeader header = {};
+    if (fread(&header, sizeof(header), 1, disassembler->bytecodeFile) == 1 &&
+        memcmp(header.magic, BYTECODE_MAGIC, sizeof(header.magic)) == 0)
+    {
+        disassembler->input = (unsigned char*) calloc(DISASSEMBLER_INPUT_BUFFER_SIZE, sizeof(unsigned char));
 
-   	    pushBack(disassembler->disassembled, '\n');
+        return header.version == BYTECODE_VERSION && disassembler->input != NULL;
     }
 
-    if (fwrite(disassembler->disassembled->data, 
-   	           sizeof(char), 
-   	           disassembler->disassembled->iteratorPos,  
-   	           disassembler->disassemblyFile) != disassembler->disassembled->iteratorPos)
-    {
-        printf("Couldn't write to file.\n");
-        return false;
-    }
+    fclose(disassembler->bytecodeFile);
+    disassembler->bytecodeFile = NULL;
+
+    BytecodeImage image = {};
+    if (!loadBytecode(bytecodeFileName, &image)) { clearBytecodeImage(&image); return false; }
 
-    free(auxBuffer);
+    free(image.offsetMap);
+    disassembler->input      = image.code;
+    disassembler->inputSize  = image.size;
+    disassembler->isInputEnd = true;
 
     return true;
 }
 
-void pushBackStringToken(DynamicArray* arr, const char* token)
+// keeps at least one whole instruction in the buffer until the end of the file
+bool fillInput(Disassembler* disassembler)
+{
+    assert(disassembler != NULL);
+
+    const size_t MAX_LENGTH = getMaxInstructionLength(false);
+
+    size_t bytesLeft = disassembler->inputSize - disassembler->inputPos;
+    if (disassembler->isInputEnd || bytesLeft >= MAX_LENGTH) { return true; }
+
+    memmove(disassembler->input, disassembler->input + disassembler->inputPos, bytesLeft);
+    disassembler->inputOffset += disassembler->inputPos;
+    disassembler->inputPos     = 0;
+
+    size_t readSize = fread(disassembler->input + bytesLeft, sizeof(unsigned char),
+                            DISASSEMBLER_INPUT_BUFFER_SIZE - bytesLeft, disassembler->bytecodeFile);
+
+    disassembler->inputSize  = bytesLeft + readSize;
+    disassembler->isInputEnd = disassembler->inputSize < DISASSEMBLER_INPUT_BUFFER_SIZE;
+
+    return !ferror(disassembler->bytecodeFile);
+}
+
+bool flushOutput(Disassembler* disassembler)
 {
-	assert(arr   != NULL);
-	assert(token != NULL);
+    assert(disassembler != NULL);
 
-	for (size_t j = 0; token[j] != '\0'; j++)
+    if (fwrite(disassembler->output, sizeof(char), disassembler->outputSize, disassembler->disassemblyFile) != disassembler->outputSize)
     {
-   	    pushBack(arr, token[j]);
+        printf("Couldn't write to file.\n");
+        return false;
     }
-}
+
+    disassembler->outputSize = 0;
+
+    return true;
+}
\ No newline at end of file
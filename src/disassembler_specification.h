@@ -1,7 +1,10 @@
 #pragma once
+#include <stddef.h>
+#include <stdio.h>
 
-typedef char da_elem_t;
-#include "../libs/dynamic_array.h"
+// the disassembler reads and writes through buffers of these sizes, whatever the size of the program
+static const size_t DISASSEMBLER_INPUT_BUFFER_SIZE  = 1 << 20;
+static const size_t DISASSEMBLER_OUTPUT_BUFFER_SIZE = 1 << 20;
 
 enum DisassemblerInitError
 {
@@ -12,14 +15,26 @@ enum DisassemblerInitError
 	DISASSEMBLER_INIT_BCD_FILE_UNSPECIFIED,
 	DISASSEMBLER_INIT_NOT_ENOUGH_MEMORY,
 	DISASSEMBLER_INIT_BYTECODE_FILE_READ_ERROR,
-	DISASSEMBLER_INIT_DISASSEMBLY_FILE_WRITE_ERROR
+	DISASSEMBLER_INIT_DISASSEMBLY_FILE_WRITE_ERROR,
+	DISASSEMBLER_INIT_INVALID_OPTION
 };
 
 struct Disassembler
 {
-    unsigned char* bytecode        = NULL;
-    size_t         bytecodeSize    = 0;
-    DynamicArray*  disassembled    = NULL;
+    // compact files are read in chunks, old wide files have to be compacted as a whole first
+    FILE*          bytecodeFile    = NULL;
+    unsigned char* input           = NULL;
+    size_t         inputSize       = 0;
+    size_t         inputPos        = 0;
+    size_t         inputOffset     = 0; // bytecode offset of input[0]
+    bool           isInputEnd      = false;
+
+    // offsets of the instructions to disassemble, [rangeStart, rangeEnd)
+    size_t         rangeStart      = 0;
+    size_t         rangeEnd        = (size_t) -1;
+
+    char*          output          = NULL;
+    size_t         outputSize      = 0;
     FILE*          disassemblyFile = NULL;
 };
 
@@ -1,9 +1,13 @@
 #include <assert.h>
 #include <stdlib.h>
 #include <stdio.h>
-#include "SDL2\SDL.h"
+#include <SDL2/SDL.h>
 #include "display.h"
 
+// keys with an ASCII code are held at their code, the others (SDLK_SCANCODE_MASK | scancode) after them
+static const size_t DISPLAY_ASCII_KEYS_COUNT = 128;
+static const size_t DISPLAY_KEYS_COUNT       = 512;
+
 struct Display
 {
     size_t        width    = 0;
@@ -11,19 +15,28 @@ struct Display
     SDL_Window*   window   = NULL;
     SDL_Renderer* renderer = NULL;
     SDL_Texture * texture  = NULL;
+
+    DisplayInput  input    = {};
+    bool          keys[DISPLAY_KEYS_COUNT] = {};
+    bool          isClosed = false;
 };
 
-Display* newDisplay(size_t width, size_t height)
+size_t getKeyIndex (int32_t key);
+
+// the video subsystem is reference counted by SDL, every display holds it until it's deleted
+Display* newDisplay(size_t width, size_t height, FILE* messages)
 {
-    if (SDL_Init(SDL_INIT_VIDEO) < 0)
+    assert(messages != NULL);
+
+    if (SDL_InitSubSystem(SDL_INIT_VIDEO) < 0)
     {
-        printf("SDL could not initialize! SDL Error: %s\n", SDL_GetError());
+        fprintf(messages, "SDL could not initialize! SDL Error: %s\n", SDL_GetError());
 
         return NULL;
     }
     
     Display* display = (Display*) calloc(1, sizeof(Display));
-    assert(display != NULL);
+    if (display == NULL) { SDL_QuitSubSystem(SDL_INIT_VIDEO); return NULL; }
 
     display->width  = width;
     display->height = height;
@@ -32,29 +45,47 @@ Display* newDisplay(size_t width, size_t height)
                                        SDL_WINDOWPOS_CENTERED, SDL_WINDOWPOS_CENTERED,
                                        DISPLAY_PXL_SIZE * width, DISPLAY_PXL_SIZE * height,
                                        0);
-    assert(display->window != NULL);
 
-    display->renderer = SDL_CreateRenderer(display->window, -1, 
-                                           SDL_RENDERER_ACCELERATED);
-    assert(display->renderer != NULL);
+    if (display->window != NULL)
+    {
+        display->renderer = SDL_CreateRenderer(display->window, -1, 
+                                               SDL_RENDERER_ACCELERATED);
+    }
+
+    if (display->renderer != NULL)
+    {
+        display->texture = SDL_CreateTexture(display->renderer,
+                                             SDL_PIXELFORMAT_RGBA8888, 
+                                             SDL_TEXTUREACCESS_STREAMING,
+                                             width, height);
+    }
+
+    if (display->texture == NULL)
+    {
+        fprintf(messages, "SDL could not create the display! SDL Error: %s\n", SDL_GetError());
 
-    display->texture = SDL_CreateTexture(display->renderer,
-                                         SDL_PIXELFORMAT_RGBA8888, 
-                                         SDL_TEXTUREACCESS_STREAMING,
-                                         width, height);
-    assert(display->texture != NULL);
+        deleteDisplay(display);
+        return NULL;
+    }
 
     return display;
 }
 
-Display* newDisplay()
+Display* newDisplay(FILE* messages)
 {
-    return newDisplay(DISPLAY_DEFAULT_WIDTH, DISPLAY_DEFAULT_HEIGHT);
+    return newDisplay(DISPLAY_DEFAULT_WIDTH, DISPLAY_DEFAULT_HEIGHT, messages);
 }
 
 void deleteDisplay(Display* display)
 {
+    if (display == NULL) { return; }
+
+    if (display->texture  != NULL) { SDL_DestroyTexture(display->texture);   }
+    if (display->renderer != NULL) { SDL_DestroyRenderer(display->renderer); }
+    if (display->window   != NULL) { SDL_DestroyWindow(display->window);     }
     free(display);
+
+    SDL_QuitSubSystem(SDL_INIT_VIDEO);
 }
 
 void updateDisplay(Display* display, unsigned char* buffer)
@@ -62,10 +93,7 @@ void updateDisplay(Display* display, unsigned char* buffer)
     assert(display != NULL);
     assert(buffer  != NULL);
 
-    SDL_Event event = {};
-    while (SDL_PollEvent(&event))
-        if (event.type == SDL_QUIT) 
-            exit(0);
+    pollDisplayEvents(display);
 
     SDL_RenderClear(display->renderer);
     SDL_UpdateTexture(display->texture, 
@@ -84,3 +112,84 @@ size_t getDisplayBufferSize(Display* display)
     return display->width * display->height * 4;
 }
 
+// keeps the input state, the CPU reads it through the input device
+void pollDisplayEvents(Display* display)
+{
+    assert(display != NULL);
+
+    DisplayInput* input = &display->input;
+
+    SDL_Event event = {};
+    while (SDL_PollEvent(&event))
+    {
+        switch (event.type)
+        {
+            case SDL_QUIT: { display->isClosed = true; break; }
+
+            case SDL_KEYDOWN:
+            case SDL_KEYUP:
+            {
+                size_t index = getKeyIndex(event.key.keysym.sym);
+                if (index < DISPLAY_KEYS_COUNT) { display->keys[index] = event.type == SDL_KEYDOWN; }
+
+                if (event.type == SDL_KEYDOWN) { input->lastKey = event.key.keysym.sym; input->keyPresses++; }
+                break;
+            }
+
+            case SDL_MOUSEMOTION:
+            {
+                input->mouseX = (double) (event.motion.x / (int32_t) DISPLAY_PXL_SIZE);
+                input->mouseY = (double) (event.motion.y / (int32_t) DISPLAY_PXL_SIZE);
+                break;
+            }
+
+            case SDL_MOUSEBUTTONDOWN:
+            case SDL_MOUSEBUTTONUP:
+            {
+                unsigned bit = event.button.button >= 1 && event.button.button <= 32 ? 1u << (event.button.button - 1) : 0;
+
+                if (event.type == SDL_MOUSEBUTTONDOWN) { input->mouseButtons |=  bit; }
+                else                                   { input->mouseButtons &= ~bit; }
+                break;
+            }
+
+            default: { break; }
+        }
+    }
+}
+
+// the window was closed, it's up to the CPU to stop
+bool isDisplayClosed(Display* display)
+{
+    assert(display != NULL);
+
+    return display->isClosed;
+}
+
+void getDisplayInput(Display* display, DisplayInput* input)
+{
+    assert(display != NULL);
+    assert(input   != NULL);
+
+    *input = display->input;
+}
+
+bool isDisplayKeyHeld(Display* display, int32_t key)
+{
+    assert(display != NULL);
+
+    size_t index = getKeyIndex(key);
+
+    return index < DISPLAY_KEYS_COUNT && display->keys[index];
+}
+
+// DISPLAY_KEYS_COUNT for the keys which aren't kept
+size_t getKeyIndex(int32_t key)
+{
+    if (key >= 0 && (size_t) key < DISPLAY_ASCII_KEYS_COUNT) { return (size_t) key; }
+    if ((key & SDLK_SCANCODE_MASK) == 0 || key < 0)         { return DISPLAY_KEYS_COUNT; }
+
+    size_t scancode = (size_t) (key & ~SDLK_SCANCODE_MASK);
+
+    return scancode < DISPLAY_KEYS_COUNT - DISPLAY_ASCII_KEYS_COUNT ? DISPLAY_ASCII_KEYS_COUNT + scancode : DISPLAY_KEYS_COUNT;
+}
@@ -1,14 +1,31 @@
 #pragma once
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
 
 static const size_t DISPLAY_DEFAULT_WIDTH  = 640;
 static const size_t DISPLAY_DEFAULT_HEIGHT = 480;
 
 static const size_t DISPLAY_PXL_SIZE = 1;
 
+// state of the keyboard and the mouse, from the events of the window
+struct DisplayInput
+{
+    double   mouseX       = 0; // in pixels of the VRAM
+    double   mouseY       = 0;
+    unsigned mouseButtons = 0; // bit i is set while the button i + 1 is held
+    int32_t  lastKey      = 0; // SDL key code of the last key pressed
+    uint64_t keyPresses   = 0;
+};
+
 struct Display;
 
-Display* newDisplay           (size_t width, size_t height);
-Display* newDisplay           ();
+Display* newDisplay           (size_t width, size_t height, FILE* messages);
+Display* newDisplay           (FILE* messages);
 void     deleteDisplay        (Display* display);
 void     updateDisplay        (Display* display, unsigned char* buffer);
-size_t   getDisplayBufferSize (Display* display);
\ No newline at end of file
+size_t   getDisplayBufferSize (Display* display);
+void     pollDisplayEvents    (Display* display);
+bool     isDisplayClosed      (Display* display);
+void     getDisplayInput      (Display* display, DisplayInput* input);
+bool     isDisplayKeyHeld     (Display* display, int32_t key);
\ No newline at end of file
@@ -0,0 +1,448 @@
+#include <assert.h>
+#include <float.h>
+#include <stdint.h>
+#include <string.h>
+#include <mutex>
+
+#include "fast_math.h"
+
+static const char* const MATH_MODE_NAMES[MATH_MODES_COUNT] = { "exact", "fast", "table" };
+
+static const double   TWO_OVER_PI     = 6.36619772367581382433e-01;
+static const double   PIO2_1          = 1.57079632673412561417e+00; // pi/2 in three parts of 33 bits,
+static const double   PIO2_2          = 6.07710050630396597660e-11; // k * part is exact while |k| < 2^20,
+static const double   PIO2_3          = 2.02226624871116645580e-21; // and the rest
+static const double   PIO2_3T         = 8.47842766036889956997e-32;
+static const double   TRIG_LIMIT      = 1e6;
+
+static const double   LN2             = 6.93147180559945286227e-01;
+static const double   INV_LN2         = 1.44269504088896338700e+00;
+static const double   EXP2_MIN        = -1022;
+static const double   EXP2_MAX        = 1023;
+
+// the coefficients of the kernels sin, cos and log of fdlibm
+static const double   SIN_1 = -1.66666666666666324348e-01;
+static const double   SIN_2 =  8.33333333332248946124e-03;
+static const double   SIN_3 = -1.98412698298579493134e-04;
+static const double   SIN_4 =  2.75573137070700676789e-06;
+static const double   SIN_5 = -2.50507602534068634195e-08;
+static const double   SIN_6 =  1.58969099521155010221e-10;
+static const double   COS_1 =  4.16666666666666019037e-02;
+static const double   COS_2 = -1.38888888888741095749e-03;
+static const double   COS_3 =  2.48015872894767294178e-05;
+static const double   COS_4 = -2.75573143513906633035e-07;
+static const double   COS_5 =  2.08757232129817482790e-09;
+static const double   COS_6 = -1.13596475577881948265e-11;
+static const double   LOG_1 =  6.666666666666735130e-01;
+static const double   LOG_2 =  3.999999999940941908e-01;
+static const double   LOG_3 =  2.857142874366239149e-01;
+static const double   LOG_4 =  2.222219843214978396e-01;
+static const double   LOG_5 =  1.818357216161805012e-01;
+static const double   LOG_6 =  1.531383769920937332e-01;
+static const double   LOG_7 =  1.479819860511658591e-01;
+
+// adding it to a value below 2^51 rounds the value to an integer, which ends up in the low bits
+static const double   ROUND_MAGIC      = 6755399441055744.0; // 1.5 * 2^52
+static const uint64_t ROUND_MAGIC_BITS = 0x4338000000000000;
+
+static const uint64_t MANTISSA_MASK   = 0x000FFFFFFFFFFFFF;
+static const uint64_t EXPONENT_MASK   = 0xFFF0000000000000;
+static const uint64_t SIGN_BIT        = 0x8000000000000000;
+static const uint64_t ONE_BITS        = 0x3FF0000000000000;
+static const uint64_t SQRT_HALF_BITS  = 0x3FE6A09E667F3BCD;
+
+// table kernels: sin and cos at the nodes j * TRIG_TABLE_STEP, |j| <= TRIG_TABLE_HALF, which covers
+// [-pi/4, pi/4] with a margin for the reduction being one off; the indices of the arguments out of
+// range are masked, so that they stay in the table
+static const size_t   TRIG_TABLE_HALF = 260;
+static const size_t   TRIG_TABLE_SIZE = 1024;
+static const size_t   TRIG_TABLE_MASK = TRIG_TABLE_SIZE - 1;
+static const double   TRIG_TABLE_STEP = 3.06796157577128245943e-03; // pi/4 / 256
+static const double   TRIG_TABLE_INV  = 3.25949323452479408189e+02;
+
+// 1 / c and log2(c) for the nodes c = 1 + j / 128 in [sqrt(1/2), sqrt(2)], at j + LOG_TABLE_OFFSET,
+// and 2^(j / 128)
+static const size_t   LOG_TABLE_STEPS  = 128;
+static const size_t   LOG_TABLE_OFFSET = 38;
+static const size_t   LOG_TABLE_SIZE   = 128;
+static const size_t   LOG_TABLE_MASK   = LOG_TABLE_SIZE - 1;
+static const size_t   EXP_TABLE_BITS  = 7;
+static const size_t   EXP_TABLE_SIZE  = 1 << EXP_TABLE_BITS;
+static const uint64_t EXP_TABLE_BIAS  = (uint64_t) 1 << 40;
+
+// kernels are evaluated into chunks of this size, then the arguments out of their range are passed to libm
+static const size_t   MATH_ARRAY_CHUNK = 256;
+
+static double         sinTable[TRIG_TABLE_SIZE]   = {};
+static double         cosTable[TRIG_TABLE_SIZE]   = {};
+static double         logInvTable[LOG_TABLE_SIZE] = {};
+static double         logTable[LOG_TABLE_SIZE]    = {};
+static double         exp2Table[EXP_TABLE_SIZE]   = {};
+static std::once_flag mathTablesFlag              = {};
+
+void     buildMathTables   ();
+void     evaluateTrigArray (bool isTable, const double* x, double* results, size_t count, uint64_t quadrantShift);
+double   sinCosKernel      (double x, uint64_t quadrantShift);
+double   tableSinCos       (double x, uint64_t quadrantShift);
+double   log2Kernel        (double x);
+double   exp2Kernel        (double z);
+double   tableLog2         (double x);
+double   tableExp2         (double z);
+bool     isPowInRange      (double x, double z);
+double   reduceArgument    (double x, double k, double* tail);
+double   twoDifference     (double a, double b, double* error);
+double   selectQuadrant    (double s, double c, uint64_t quadrant);
+uint64_t getBits           (double value);
+double   getDouble         (uint64_t bits);
+
+bool parseMathMode(const char* string, MathMode* mode)
+{
+    assert(string != NULL);
+    assert(mode   != NULL);
+
+    for (size_t i = 0; i < MATH_MODES_COUNT; i++)
+    {
+        if (strcmp(string, MATH_MODE_NAMES[i]) == 0) { *mode = (MathMode) i; return true; }
+    }
+
+    return false;
+}
+
+const char* getMathModeName(MathMode mode)
+{
+    return (size_t) mode < MATH_MODES_COUNT ? MATH_MODE_NAMES[mode] : NULL;
+}
+
+void initMathTables()
+{
+    std::call_once(mathTablesFlag, buildMathTables);
+}
+
+void buildMathTables()
+{
+    for (size_t i = 0; i <= 2 * TRIG_TABLE_HALF; i++)
+    {
+        double node = ((double) i - (double) TRIG_TABLE_HALF) * TRIG_TABLE_STEP;
+        sinTable[i] = sin(node);
+        cosTable[i] = cos(node);
+    }
+
+    for (size_t i = 0; i < LOG_TABLE_SIZE; i++)
+    {
+        double node = 1 + ((double) i - (double) LOG_TABLE_OFFSET) / LOG_TABLE_STEPS;
+        logInvTable[i] = 1 / node;
+        logTable[i]    = log2(node);
+    }
+
+    for (size_t i = 0; i < EXP_TABLE_SIZE; i++)
+    {
+        exp2Table[i] = exp2((double) i / EXP_TABLE_SIZE);
+    }
+}
+
+double fastSin(double x)
+{
+    if (!(fabs(x) < TRIG_LIMIT)) { return sin(x); }
+    if (x == 0)                 { return x;      } // keeps the sign of -0
+
+    return sinCosKernel(x, 0);
+}
+
+double fastCos(double x)
+{
+    if (!(fabs(x) < TRIG_LIMIT)) { return cos(x); }
+
+    return sinCosKernel(x, 1);
+}
+
+double fastPow(double x, double y)
+{
+    double z = y * log2Kernel(x);
+    if (!isPowInRange(x, z)) { return pow(x, y); }
+
+    return exp2Kernel(z);
+}
+
+double tableSin(double x)
+{
+    if (!(fabs(x) < TRIG_LIMIT)) { return sin(x); }
+    if (x == 0)                 { return x;      } // keeps the sign of -0
+
+    return tableSinCos(x, 0);
+}
+
+double tableCos(double x)
+{
+    if (!(fabs(x) < TRIG_LIMIT)) { return cos(x); }
+
+    return tableSinCos(x, 1);
+}
+
+double tablePow(double x, double y)
+{
+    double z = y * tableLog2(x);
+    if (!isPowInRange(x, z)) { return pow(x, y); }
+
+    return tableExp2(z);
+}
+
+void mathSinArray(MathMode mode, const double* x, double* results, size_t count)
+{
+    assert(x       != NULL || count == 0);
+    assert(results != NULL || count == 0);
+
+    if (mode == MATH_MODE_EXACT) { for (size_t i = 0; i < count; i++) { results[i] = sin(x[i]); } return; }
+
+    evaluateTrigArray(mode == MATH_MODE_TABLE, x, results, count, 0);
+}
+
+void mathCosArray(MathMode mode, const double* x, double* results, size_t count)
+{
+    assert(x       != NULL || count == 0);
+    assert(results != NULL || count == 0);
+
+    if (mode == MATH_MODE_EXACT) { for (size_t i = 0; i < count; i++) { results[i] = cos(x[i]); } return; }
+
+    evaluateTrigArray(mode == MATH_MODE_TABLE, x, results, count, 1);
+}
+
+void mathPowArray(MathMode mode, const double* x, const double* y, double* results, size_t count)
+{
+    assert(x       != NULL || count == 0);
+    assert(y       != NULL || count == 0);
+    assert(results != NULL || count == 0);
+
+    if (mode == MATH_MODE_EXACT) { for (size_t i = 0; i < count; i++) { results[i] = pow(x[i], y[i]); } return; }
+
+    bool   isTable                       = mode == MATH_MODE_TABLE;
+    double exponents[MATH_ARRAY_CHUNK]   = {};
+    double chunk[MATH_ARRAY_CHUNK]       = {};
+
+    for (size_t start = 0; start < count; start += MATH_ARRAY_CHUNK)
+    {
+        size_t size = count - start < MATH_ARRAY_CHUNK ? count - start : MATH_ARRAY_CHUNK;
+
+        if (isTable) { for (size_t i = 0; i < size; i++) { exponents[i] = y[start + i] * tableLog2(x[start + i]); } }
+        else         { for (size_t i = 0; i < size; i++) { exponents[i] = y[start + i] * log2Kernel(x[start + i]); } }
+
+        if (isTable) { for (size_t i = 0; i < size; i++) { chunk[i] = tableExp2(exponents[i]);  } }
+        else         { for (size_t i = 0; i < size; i++) { chunk[i] = exp2Kernel(exponents[i]); } }
+
+        for (size_t i = 0; i < size; i++)
+        {
+            double base     = x[start + i];
+            double exponent = y[start + i];
+            results[start + i] = isPowInRange(base, exponents[i]) ? chunk[i] : pow(base, exponent);
+        }
+    }
+}
+
+// The kernels have no comparisons, so that their loops are vectorized (without -ffast-math floating
+// point comparisons aren't if-converted), they are evaluated for a whole chunk and give garbage for
+// the arguments out of their range, zeros go to libm too for the sign of sin(-0). The fix-up loop reads every argument before it writes the
+// result, so results can alias the arguments.
+void evaluateTrigArray(bool isTable, const double* x, double* results, size_t count, uint64_t quadrantShift)
+{
+    double chunk[MATH_ARRAY_CHUNK] = {};
+    for (size_t start = 0; start < count; start += MATH_ARRAY_CHUNK)
+    {
+        size_t size = count - start < MATH_ARRAY_CHUNK ? count - start : MATH_ARRAY_CHUNK;
+
+        if (isTable) { for (size_t i = 0; i < size; i++) { chunk[i] = tableSinCos(x[start + i], quadrantShift);  } }
+        else         { for (size_t i = 0; i < size; i++) { chunk[i] = sinCosKernel(x[start + i], quadrantShift); } }
+
+        for (size_t i = 0; i < size; i++)
+        {
+            double argument = x[start + i];
+            if (fabs(argument) < TRIG_LIMIT && argument != 0) { results[start + i] = chunk[i]; continue; }
+
+            results[start + i] = quadrantShift == 0 ? sin(argument) : cos(argument);
+        }
+    }
+}
+
+// sin(x) for the quadrant shift 0, cos(x) for 1; |x| < TRIG_LIMIT
+inline double sinCosKernel(double x, uint64_t quadrantShift)
+{
+    double   shifted = x * TWO_OVER_PI + ROUND_MAGIC;
+    double   k       = shifted - ROUND_MAGIC;
+    uint64_t kBits   = getBits(shifted);
+
+    double tail = 0;
+    double r    = reduceArgument(x, k, &tail);
+    double r2   = r * r;
+    double r4   = r2 * r2;
+
+    // the minimax polynomials of fdlibm, within 2^-58 on |r| <= pi/4, in Estrin's form for a short
+    // latency; the tail of r is added to the first order terms, and 1 - r^2 / 2 is split as in fdlibm,
+    // so that its rounding error isn't lost
+    double sinTail = (SIN_2 + r2 * SIN_3) + r4 * ((SIN_4 + r2 * SIN_5) + r4 * SIN_6);
+    double cosTail = r2 * ((COS_1 + r2 * COS_2) + r4 * COS_3) + r4 * r4 * ((COS_4 + r2 * COS_5) + r4 * COS_6);
+    double r3      = r2 * r;
+    double s       = r - ((r2 * (0.5 * tail - r3 * sinTail) - tail) - r3 * SIN_1);
+    double half    = 0.5 * r2;
+    double w       = 1 - half;
+    double c       = w + (((1 - w) - half) + (r2 * cosTail - r * tail));
+
+    return selectQuadrant(s, c, kBits + quadrantShift);
+}
+
+// sin(node + d) = sin(node) * cos(d) + cos(node) * sin(d), |d| <= TRIG_TABLE_STEP / 2
+inline double tableSinCos(double x, uint64_t quadrantShift)
+{
+    double   shifted = x * TWO_OVER_PI + ROUND_MAGIC;
+    double   k       = shifted - ROUND_MAGIC;
+    uint64_t kBits   = getBits(shifted);
+
+    double tail = 0;
+    double r    = reduceArgument(x, k, &tail);
+
+    double nodeShifted = r * TRIG_TABLE_INV + ROUND_MAGIC;
+    double node        = (nodeShifted - ROUND_MAGIC) * TRIG_TABLE_STEP;
+    size_t index       = (size_t) ((getBits(nodeShifted) - ROUND_MAGIC_BITS + TRIG_TABLE_HALF) & TRIG_TABLE_MASK);
+
+    double d  = r - node;
+    double d2 = d * d;
+
+    double sinD      = d + d * d2 * (-1.0 / 6 + d2 * (1.0 / 120));
+    double cosDMinus = d2 * (-1.0 / 2 + d2 * (1.0 / 24));
+
+    double s = sinTable[index] + (sinTable[index] * cosDMinus + cosTable[index] * sinD);
+    double c = cosTable[index] + (cosTable[index] * cosDMinus - sinTable[index] * sinD);
+
+    return selectQuadrant(s, c, kBits + quadrantShift);
+}
+
+// x positive and normal: x = m * 2^e, m in [sqrt(1/2), sqrt(2)), ln(m) = 2 atanh((m - 1) / (m + 1));
+// the exponent is the one of x - sqrt(1/2) in bits, biased so that it can be shifted as unsigned
+inline double log2Kernel(double x)
+{
+    uint64_t bits     = getBits(x);
+    uint64_t offset   = bits - SQRT_HALF_BITS;
+    uint64_t exponent = (offset ^ SIGN_BIT) >> 52; // e + 2048
+    double   m        = getDouble(bits - (offset & EXPONENT_MASK));
+
+    double t  = (m - 1) / (m + 1);
+    double t2 = t * t;
+    double t4 = t2 * t2;
+
+    // 2 atanh(t) = 2t + t R(t^2), R is the minimax polynomial of fdlibm, within 2^-58 on |t| <= 0.1716
+    double lnM = 2 * t + t * t2 * ((LOG_1 + t2 * LOG_2) + t4 * ((LOG_3 + t2 * LOG_4) + t4 * ((LOG_5 + t2 * LOG_6) + t4 * LOG_7)));
+
+    return (getDouble(ROUND_MAGIC_BITS + exponent) - (ROUND_MAGIC + 2048)) + lnM * INV_LN2;
+}
+
+// z in (EXP2_MIN, EXP2_MAX): 2^z = 2^n * e^(f * ln 2), |f| <= 1/2
+inline double exp2Kernel(double z)
+{
+    double shifted = z + ROUND_MAGIC;
+    double f       = z - (shifted - ROUND_MAGIC);
+
+    // Taylor series in Estrin's form, on |g| <= ln(2) / 2 the first omitted term is below 2^-64
+    double g  = f * LN2;
+    double g2 = g * g;
+    double g4 = g2 * g2;
+    double g8 = g4 * g4;
+
+    double low  = ((1.0 / 2 + g * (1.0 / 6)) + g2 * (1.0 / 24 + g * (1.0 / 120))) + g4 * ((1.0 / 720 + g * (1.0 / 5040)) + g2 * (1.0 / 40320 + g * (1.0 / 362880)));
+    double high = ((1.0 / 3628800 + g * (1.0 / 39916800)) + g2 * (1.0 / 479001600 + g * (1.0 / 6227020800)));
+    double p    = 1 + (g + g2 * (low + g8 * high));
+
+    return p * getDouble((getBits(shifted) - ROUND_MAGIC_BITS + 1023) << 52);
+}
+
+// x positive and normal: x = m * 2^e as in log2Kernel, log2(m) = log2(c) + log2(1 + r), where c is the
+// nearest node 1 + j / 128 and r = (m - c) / c, |r| < 1/128; m - c is exact and c = 1 is a node, so
+// that the result has a small relative error near x = 1 too
+inline double tableLog2(double x)
+{
+    uint64_t bits     = getBits(x);
+    uint64_t offset   = bits - SQRT_HALF_BITS;
+    uint64_t exponent = (offset ^ SIGN_BIT) >> 52; // e + 2048
+    double   m        = getDouble(bits - (offset & EXPONENT_MASK));
+
+    double jShifted = (m - 1) * LOG_TABLE_STEPS + ROUND_MAGIC;
+    double node     = 1 + (jShifted - ROUND_MAGIC) / LOG_TABLE_STEPS;
+    size_t index    = (size_t) ((getBits(jShifted) - ROUND_MAGIC_BITS + LOG_TABLE_OFFSET) & LOG_TABLE_MASK);
+
+    double r      = (m - node) * logInvTable[index];
+    double log1pR = r - r * r * (1.0 / 2 - r * (1.0 / 3 - r * (1.0 / 4 - r * (1.0 / 5 - r * (1.0 / 6 - r * (1.0 / 7))))));
+
+    return (getDouble(ROUND_MAGIC_BITS + exponent) - (ROUND_MAGIC + 2048)) + (logTable[index] + log1pR * INV_LN2);
+}
+
+// z in (EXP2_MIN, EXP2_MAX): 2^z = 2^n * 2^(j / 128) * e^(f * ln 2), |f| <= 1/256; k = 128 n + j
+// is biased by a multiple of 128, so that it's shifted as unsigned
+inline double tableExp2(double z)
+{
+    double   shifted = z * EXP_TABLE_SIZE + ROUND_MAGIC;
+    double   f       = z - (shifted - ROUND_MAGIC) / EXP_TABLE_SIZE;
+    uint64_t k       = getBits(shifted) - ROUND_MAGIC_BITS + EXP_TABLE_BIAS;
+
+    double g = f * LN2;
+    double p = 1 + g * (1 + g * (1.0 / 2 + g * (1.0 / 6 + g * (1.0 / 24 + g * (1.0 / 120)))));
+
+    uint64_t n = (k >> EXP_TABLE_BITS) - (EXP_TABLE_BIAS >> EXP_TABLE_BITS);
+
+    return exp2Table[k & (EXP_TABLE_SIZE - 1)] * p * getDouble((n + 1023) << 52);
+}
+
+// the kernels only handle positive normal bases and results with a normal exponent
+inline bool isPowInRange(double x, double z)
+{
+    return x >= DBL_MIN && x <= DBL_MAX && z > EXP2_MIN && z < EXP2_MAX;
+}
+
+// x - k * pi/2, |k| < 2^20: the products k * PIO2_1..3 are exact, x - k * PIO2_1 is exact too, and
+// the next two differences are exact two-sums, so that there is no cancellation error when x is
+// close to a multiple of pi/2; *tail gets what the rounded result misses
+inline double reduceArgument(double x, double k, double* tail)
+{
+    double high  = x - k * PIO2_1;
+    double error = 0;
+
+    high = twoDifference(high, k * PIO2_2, &error);
+
+    double secondError = 0;
+    high = twoDifference(high, k * PIO2_3, &secondError);
+
+    double low    = (error + secondError) - k * PIO2_3T;
+    double result = high + low;
+    *tail         = low - (result - high);
+
+    return result;
+}
+
+// a - b rounded, *error gets the exact rest
+inline double twoDifference(double a, double b, double* error)
+{
+    double difference = a - b;
+    double part       = difference - a;
+    *error            = (a - (difference - part)) - (b + part);
+
+    return difference;
+}
+
+// s, c, -s, -c for the quadrants 0-3, with bit operations, which are vectorized without SSE4
+inline double selectQuadrant(double s, double c, uint64_t quadrant)
+{
+    uint64_t mask = 0 - (quadrant & 1);
+
+    return getDouble(((getBits(s) & ~mask) | (getBits(c) & mask)) ^ ((quadrant & 2) << 62));
+}
+
+inline uint64_t getBits(double value)
+{
+    uint64_t bits = 0;
+    memcpy(&bits, &value, sizeof(bits));
+
+    return bits;
+}
+
+inline double getDouble(uint64_t bits)
+{
+    double value = 0;
+    memcpy(&value, &bits, sizeof(value));
+
+    return value;
+}
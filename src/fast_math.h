@@ -0,0 +1,76 @@
+#pragma once
+#include <math.h>
+#include <stddef.h>
+
+// Kernels of sin, cos and pow for the CPU, selected per run with --math:
+//
+//     exact  libm, the default
+//     fast   polynomials after an exact reduction by multiples of pi/2 (sin, cos), and
+//            exp2(y * log2(x)) from series (pow)
+//     table  sin and cos from tables of the values at 521 points and short polynomials, pow from
+//            tables of log2 and exp2 at 128 points each
+//
+// sin and cos are within 1 ulp of libm (fast) and 2 ulp (table) for |x| < 1e6, also close to the
+// zeros; the relative error of pow is below 2^-50 * max(1, |y * log2(x)|) in both modes, for
+// positive normal x and |y * log2(x)| < 1022.
+//
+// Arguments out of the ranges above, NaN and infinities are passed on to libm, so the results
+// only differ in the last bits; sin(-0) is -0 in every mode. sqrt is a single hardware instruction, it's exact in every mode.
+// The array forms evaluate many values at once (e.g. RAM cells), their loops are vectorized.
+
+enum MathMode
+{
+    MATH_MODE_EXACT,
+    MATH_MODE_FAST,
+    MATH_MODE_TABLE
+};
+
+static const size_t MATH_MODES_COUNT = 3;
+
+bool        parseMathMode   (const char* string, MathMode* mode);
+const char* getMathModeName (MathMode mode);
+
+// the table kernels need it, called once per process from initCpu
+void        initMathTables  ();
+
+double      fastSin         (double x);
+double      fastCos         (double x);
+double      fastPow         (double x, double y);
+double      tableSin        (double x);
+double      tableCos        (double x);
+double      tablePow        (double x, double y);
+
+// results can be the same array as the arguments
+void        mathSinArray    (MathMode mode, const double* x, double* results, size_t count);
+void        mathCosArray    (MathMode mode, const double* x, double* results, size_t count);
+void        mathPowArray    (MathMode mode, const double* x, const double* y, double* results, size_t count);
+
+inline double mathSin(MathMode mode, double x)
+{
+    switch (mode)
+    {
+        case MATH_MODE_FAST:  { return fastSin(x);  }
+        case MATH_MODE_TABLE: { return tableSin(x); }
+        default:              { return sin(x);      }
+    }
+}
+
+inline double mathCos(MathMode mode, double x)
+{
+    switch (mode)
+    {
+        case MATH_MODE_FAST:  { return fastCos(x);  }
+        case MATH_MODE_TABLE: { return tableCos(x); }
+        default:              { return cos(x);      }
+    }
+}
+
+inline double mathPow(MathMode mode, double x, double y)
+{
+    switch (mode)
+    {
+        case MATH_MODE_FAST:  { return fastPow(x, y);  }
+        case MATH_MODE_TABLE: { return tablePow(x, y); }
+        default:              { return pow(x, y);      }
+    }
+}
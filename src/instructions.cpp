@@ -0,0 +1,272 @@
+#include <assert.h>
+#include <charconv>
+#include <stdio.h>
+#include <string.h>
+
+#include "bytecode.h"
+#include "instructions.h"
+
+// enough for any double in the %lg format
+static const size_t MAX_NUMBER_STR_LENGTH = 32;
+
+struct FormatBuffer;
+
+bool isValidOperand            (OperandKind kind, bool hasRegister, bool hasConst, bool hasRam);
+void appendText                (FormatBuffer* buffer, const char* text, size_t length);
+void appendNumber              (FormatBuffer* buffer, double value);
+void appendTarget              (FormatBuffer* buffer, uint32_t target);
+void appendRegister            (FormatBuffer* buffer, size_t index);
+void formatRegisterInstruction (FormatBuffer* formatted, const unsigned char* instruction, size_t length);
+
+// the destination of a register instruction is a register, the sources are registers and numbers,
+// pop writes to a register or to RAM, so the CPU doesn't check them
+bool isValidOperand(OperandKind kind, bool hasRegister, bool hasConst, bool hasRam)
+{
+    switch (kind)
+    {
+        case OPERAND_DESTINATION: { return hasRegister && !hasConst && !hasRam; }
+        case OPERAND_SOURCE:      { return !hasRam; }
+        case OPERAND_POP:         { return hasRam || (hasRegister && !hasConst); }
+        default:                  { return true; }
+    }
+}
+
+// returns 0 if the instruction is invalid or doesn't fit into bytesLeft,
+// the last argument of a control flow instruction is its target
+size_t getInstructionLength(const unsigned char* instruction, size_t bytesLeft)
+{
+    assert(instruction != NULL);
+
+    if (bytesLeft == 0 || *instruction >= CPU_COMMANDS_COUNT) { return 0; }
+
+    const InstructionDescriptor* descriptor = &INSTRUCTIONS[*instruction];
+
+    // instructions without push and pop style operands have a fixed length
+    if (descriptor->minLength == descriptor->maxLength) { return descriptor->minLength <= bytesLeft ? descriptor->minLength : 0; }
+
+    size_t length = 1;
+    for (size_t i = 0; i < descriptor->argsCount; i++)
+    {
+        if (descriptor->operands[i] == OPERAND_TARGET) { length += CPU_TARGET_NUM_BYTES; break; }
+
+        if (length >= bytesLeft) { return 0; }
+
+        unsigned char mode          = instruction[length];
+        unsigned      immediateKind = (mode & CPU_MODE_MASK_IMMEDIATE) >> CPU_MODE_IMMEDIATE_SHIFT;
+        if (mode == 0 || immediateKind > CPU_IMMEDIATE_DOUBLE) { return 0; }
+
+        if (!isValidOperand(descriptor->operands[i], (mode & CPU_MODE_MASK_REGISTER) != 0,
+                            immediateKind != CPU_IMMEDIATE_NONE, (mode & CPU_MODE_MASK_RAM) != 0))
+        {
+            return 0;
+        }
+
+        length++;
+        if ((mode & CPU_MODE_MASK_REGISTER) == CPU_MODE_REGISTER_EXTENDED)
+        {
+            if (length >= bytesLeft || instruction[length] >= CPU_REGISTERS_COUNT) { return 0; }
+            length++;
+        }
+
+        length += CPU_IMMEDIATE_SIZES[immediateKind];
+    }
+
+    if (length > bytesLeft) { return 0; }
+
+    return length;
+}
+
+// same for the wide encoding of the assembler and of the old bytecode files
+size_t getWideInstructionLength(const unsigned char* instruction, size_t bytesLeft)
+{
+    assert(instruction != NULL);
+
+    if (bytesLeft == 0 || *instruction >= CPU_COMMANDS_COUNT) { return 0; }
+
+    const InstructionDescriptor* descriptor = &INSTRUCTIONS[*instruction];
+
+    size_t length = 1;
+    for (size_t i = 0; i < descriptor->argsCount; i++)
+    {
+        if (length >= bytesLeft) { return 0; }
+
+        unsigned char argType = instruction[length];
+        if (argType == 0) { return 0; }
+
+        if (!isValidOperand(descriptor->operands[i], (argType & CPU_ARGUMENT_MASK_REG) != 0,
+                            (argType & CPU_ARGUMENT_MASK_CST) != 0, (argType & CPU_ARGUMENT_MASK_RAM) != 0))
+        {
+            return 0;
+        }
+
+        length++;
+        if ((argType & CPU_ARGUMENT_MASK_REG) != 0)
+        {
+            if (length >= bytesLeft || instruction[length] == 0 || instruction[length] > CPU_REGISTERS_COUNT) { return 0; }
+            length += 1;
+        }
+
+        if ((argType & CPU_ARGUMENT_MASK_CST) != 0) { length += sizeof(double); }
+    }
+
+    if (length > bytesLeft) { return 0; }
+
+    return length;
+}
+
+// disassembly is written piece by piece, numbers with to_chars instead of printf
+struct FormatBuffer
+{
+    char*  data   = NULL;
+    size_t size   = 0;
+    size_t length = 0;
+};
+
+void appendText(FormatBuffer* buffer, const char* text, size_t length)
+{
+    size_t available = buffer->length + 1 < buffer->size ? buffer->size - buffer->length - 1 : 0;
+    if (length > available) { length = available; }
+
+    memcpy(buffer->data + buffer->length, text, length);
+    buffer->length += length;
+    buffer->data[buffer->length] = '\0';
+}
+
+// "%lg"
+void appendNumber(FormatBuffer* buffer, double value)
+{
+    char                 number[MAX_NUMBER_STR_LENGTH] = {};
+    std::to_chars_result result = std::to_chars(number, number + sizeof(number), value, std::chars_format::general, 6);
+
+    appendText(buffer, number, result.ptr - number);
+}
+
+void appendTarget(FormatBuffer* buffer, uint32_t target)
+{
+    char                 number[MAX_NUMBER_STR_LENGTH] = {};
+    std::to_chars_result result = std::to_chars(number, number + sizeof(number), target);
+
+    appendText(buffer, number, result.ptr - number);
+}
+
+void appendRegister(FormatBuffer* buffer, size_t index)
+{
+    char name[] = { 'r', (char) ('a' + index), 'x' };
+
+    appendText(buffer, name, sizeof(name));
+}
+
+#define APPEND_TEXT(text) appendText(&formatted, text, sizeof(text) - 1)
+
+// writes disassembly of one instruction into buffer (in the same format asm- uses),
+// returns the instruction's length or 0 if it's invalid
+size_t formatInstruction(char* buffer, size_t bufferSize, const unsigned char* instruction, size_t bytesLeft)
+{
+    assert(buffer      != NULL);
+    assert(bufferSize  != 0);
+    assert(instruction != NULL);
+
+    buffer[0] = '\0';
+
+    size_t length = getInstructionLength(instruction, bytesLeft);
+    if (length == 0) { return 0; }
+
+    const InstructionDescriptor* descriptor = &INSTRUCTIONS[*instruction];
+    const char*                  currByte   = (const char*) instruction + 1;
+    FormatBuffer                 formatted  = { buffer, bufferSize, 0 };
+
+    if (descriptor->isRegister)
+    {
+        formatRegisterInstruction(&formatted, instruction, length);
+        return length;
+    }
+
+    appendText(&formatted, descriptor->name, descriptor->nameLength);
+
+    if (descriptor->argsCount != 0 && descriptor->isControlFlow)
+    {
+        APPEND_TEXT(" ");
+        appendTarget(&formatted, decodeTarget(currByte, 0));
+        APPEND_TEXT(" ");
+        return length;
+    }
+
+    for (size_t i = 0; i < descriptor->argsCount; i++)
+    {
+        size_t        position = 0;
+        unsigned char mode     = (unsigned char) currByte[position++];
+
+        bool hasRegister  = (mode & CPU_MODE_MASK_REGISTER)  != 0;
+        bool hasImmediate = (mode & CPU_MODE_MASK_IMMEDIATE) != 0;
+
+        // ram specifier
+        if ((mode & CPU_MODE_MASK_RAM) != 0) { APPEND_TEXT(" ["); }
+
+        // register specifier
+        if (hasRegister)
+        {
+            APPEND_TEXT(" ");
+            appendRegister(&formatted, decodeRegister(currByte, &position, mode));
+            APPEND_TEXT(" ");
+        }
+
+        // both register and const specifier
+        if (hasRegister && hasImmediate) { APPEND_TEXT(" + "); }
+
+        // const specifier
+        if (hasImmediate)
+        {
+            APPEND_TEXT(" ");
+            appendNumber(&formatted, decodeImmediate(currByte, &position, mode));
+            APPEND_TEXT(" ");
+        }
+
+        // ram specifier
+        if ((mode & CPU_MODE_MASK_RAM) != 0) { APPEND_TEXT(" ] "); }
+
+        currByte += position;
+    }
+
+    return length;
+}
+
+// in the syntax of the assembler: "add rdx, rbx, 5", "jb rax, rcx+1, 12"
+void formatRegisterInstruction(FormatBuffer* formatted, const unsigned char* instruction, size_t length)
+{
+    assert(formatted   != NULL);
+    assert(instruction != NULL);
+
+    const InstructionDescriptor* descriptor   = &INSTRUCTIONS[*instruction];
+    size_t                       nameLength   = descriptor->nameLength;
+    size_t                       suffixLength = strlen(REGISTER_INSTRUCTION_SUFFIX);
+    if (nameLength > suffixLength && strcmp(descriptor->name + nameLength - suffixLength, REGISTER_INSTRUCTION_SUFFIX) == 0)
+    {
+        nameLength -= suffixLength;
+    }
+
+    appendText(formatted, descriptor->name, nameLength);
+
+    const char* code     = (const char*) instruction;
+    size_t      position = 1;
+    for (size_t i = 0; i < descriptor->argsCount && descriptor->operands[i] != OPERAND_TARGET; i++)
+    {
+        unsigned char mode = (unsigned char) code[position++];
+
+        if (i == 0) { appendText(formatted, " ", 1);  }
+        else        { appendText(formatted, ", ", 2); }
+
+        if ((mode & CPU_MODE_MASK_REGISTER) != 0) { appendRegister(formatted, decodeRegister(code, &position, mode)); }
+
+        if ((mode & CPU_MODE_MASK_REGISTER) != 0 && (mode & CPU_MODE_MASK_IMMEDIATE) != 0) { appendText(formatted, "+", 1); }
+
+        if ((mode & CPU_MODE_MASK_IMMEDIATE) != 0) { appendNumber(formatted, decodeImmediate(code, &position, mode)); }
+    }
+
+    if (descriptor->isControlFlow)
+    {
+        appendText(formatted, ", ", 2);
+        appendTarget(formatted, decodeTarget(code, length - CPU_TARGET_NUM_BYTES));
+    }
+}
+
+#undef APPEND_TEXT
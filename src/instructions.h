@@ -0,0 +1,172 @@
+#pragma once
+#include <stddef.h>
+#include "cpu_specification.h"
+
+static const size_t MAX_INSTRUCTION_STR_LENGTH = 128;
+static const size_t MAX_INSTRUCTION_ARGS       = 3;
+
+// register forms of the stack instructions are written with the same mnemonic and comma-separated
+// operands, "add rdx, rbx, 5" is add_r
+static const char* const REGISTER_INSTRUCTION_SUFFIX = "_r";
+
+enum OperandKind
+{
+    OPERAND_NONE,
+    OPERAND_STACK,       // push: register, number or both, in RAM or not
+    OPERAND_POP,         // pop: register, or RAM at a register, a number or both
+    OPERAND_DESTINATION, // register
+    OPERAND_SOURCE,      // register, number or both, not in RAM
+    OPERAND_TARGET       // the last argument of jumps and call
+};
+
+// Everything the tools need to know about an instruction, built at compile time from cpu_commands.h
+// and indexed by the opcode. Lengths are in bytes, including the opcode.
+struct InstructionDescriptor
+{
+    const char*   name          = NULL;
+    size_t        nameLength    = 0;
+    unsigned char opcode        = 0;
+    size_t        argsCount     = 0;
+    bool          isControlFlow = false;
+    bool          isRegister    = false;
+    OperandKind   operands[MAX_INSTRUCTION_ARGS] = {};
+
+    size_t        minLength     = 0; // compact encoding
+    size_t        maxLength     = 0;
+    size_t        wideLength    = 0; // longest in the wide encoding
+
+    size_t        stackPops     = 0;
+    size_t        stackPushes   = 0;
+};
+
+// pop is the only stack instruction with an operand which takes a value off the stack
+constexpr OperandKind getOperandKind(size_t index, size_t argsCount, bool isControlFlow, bool isRegister, size_t stackPops)
+{
+    if (index >= argsCount)                      { return OPERAND_NONE;        }
+    if (isControlFlow && index + 1 == argsCount) { return OPERAND_TARGET;      }
+    if (!isRegister && stackPops != 0)           { return OPERAND_POP;         }
+    if (!isRegister)                             { return OPERAND_STACK;       }
+    if (!isControlFlow && index == 0)            { return OPERAND_DESTINATION; }
+
+    return OPERAND_SOURCE;
+}
+
+constexpr InstructionDescriptor describeInstruction(const char* name, size_t nameLength, unsigned char opcode, size_t argsCount,
+                                                    bool isControlFlow, bool isRegister, size_t stackPops, size_t stackPushes)
+{
+    InstructionDescriptor descriptor = {};
+    descriptor.name          = name;
+    descriptor.nameLength    = nameLength;
+    descriptor.opcode        = opcode;
+    descriptor.argsCount     = argsCount;
+    descriptor.isControlFlow = isControlFlow;
+    descriptor.isRegister    = isRegister;
+    descriptor.stackPops     = stackPops;
+    descriptor.stackPushes   = stackPushes;
+    descriptor.minLength     = 1;
+    descriptor.maxLength     = 1;
+    descriptor.wideLength    = 1;
+
+    for (size_t i = 0; i < argsCount; i++)
+    {
+        OperandKind kind = getOperandKind(i, argsCount, isControlFlow, isRegister, stackPops);
+        descriptor.operands[i] = kind;
+
+        // compact: mode byte, extended register index, immediate; wide: type byte, register byte, double
+        switch (kind)
+        {
+            case OPERAND_TARGET:
+            {
+                descriptor.minLength  += CPU_TARGET_NUM_BYTES;
+                descriptor.maxLength  += CPU_TARGET_NUM_BYTES;
+                descriptor.wideLength += 1 + sizeof(double);
+                break;
+            }
+
+            case OPERAND_DESTINATION:
+            {
+                descriptor.minLength  += 1;
+                descriptor.maxLength  += 2;
+                descriptor.wideLength += 2;
+                break;
+            }
+
+            default:
+            {
+                descriptor.minLength  += 1;
+                descriptor.maxLength  += 2 + sizeof(double);
+                descriptor.wideLength += 2 + sizeof(double);
+                break;
+            }
+        }
+    }
+
+    return descriptor;
+}
+
+static constexpr InstructionDescriptor INSTRUCTIONS[] = {
+                                                            #define DEFINE_CMD(name, number, args, isControlFlow, isRegister, stackPops, stackPushes, code) \
+                                                                describeInstruction(#name, sizeof(#name) - 1, CPU_CMD_##name, args, isControlFlow, isRegister, stackPops, stackPushes),
+                                                            #include "cpu_commands.h"
+                                                            #undef DEFINE_CMD
+                                                        };
+
+static_assert(sizeof(INSTRUCTIONS) / sizeof(INSTRUCTIONS[0]) == CPU_COMMANDS_COUNT, "every command needs a descriptor");
+
+constexpr bool areOpcodesIndices()
+{
+    for (size_t i = 0; i < CPU_COMMANDS_COUNT; i++)
+    {
+        if (INSTRUCTIONS[i].opcode != i || INSTRUCTIONS[i].argsCount > MAX_INSTRUCTION_ARGS) { return false; }
+    }
+
+    return true;
+}
+
+static_assert(areOpcodesIndices(), "commands have to be numbered from 0 in the order of cpu_commands.h");
+
+// of the compact encoding or of the wide one
+constexpr size_t getMaxInstructionLength(bool isWide)
+{
+    size_t maxLength = 0;
+    for (size_t i = 0; i < CPU_COMMANDS_COUNT; i++)
+    {
+        size_t length = isWide ? INSTRUCTIONS[i].wideLength : INSTRUCTIONS[i].maxLength;
+        if (length > maxLength) { maxLength = length; }
+    }
+
+    return maxLength;
+}
+
+// returns NULL for an invalid opcode
+inline const InstructionDescriptor* getInstructionDescriptor(unsigned char opcode)
+{
+    if (opcode >= CPU_COMMANDS_COUNT) { return NULL; }
+
+    return &INSTRUCTIONS[opcode];
+}
+
+inline const char* getInstructionName(unsigned char opcode)
+{
+    return opcode < CPU_COMMANDS_COUNT ? INSTRUCTIONS[opcode].name : NULL;
+}
+
+inline size_t getInstructionArgsCount(unsigned char opcode)
+{
+    return opcode < CPU_COMMANDS_COUNT ? INSTRUCTIONS[opcode].argsCount : 0;
+}
+
+inline bool isControlFlowInstruction(unsigned char opcode)
+{
+    return opcode < CPU_COMMANDS_COUNT && INSTRUCTIONS[opcode].isControlFlow;
+}
+
+// operands come from registers instead of the stack
+inline bool isRegisterInstruction(unsigned char opcode)
+{
+    return opcode < CPU_COMMANDS_COUNT && INSTRUCTIONS[opcode].isRegister;
+}
+
+size_t getInstructionLength     (const unsigned char* instruction, size_t bytesLeft);
+size_t getWideInstructionLength (const unsigned char* instruction, size_t bytesLeft);
+size_t formatInstruction        (char* buffer, size_t bufferSize, const unsigned char* instruction, size_t bytesLeft);
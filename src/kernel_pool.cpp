@@ -0,0 +1,246 @@
+#include <assert.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "kernel_pool.h"
+#include "profiler.h"
+
+// x + width and y + height have to fit into a RAM address computed by the kernel
+static const double KERNEL_MAX_COORDINATE = 4294967296.0;
+
+KernelPool* newKernelPool       (CPU* cpu);
+bool        initKernelLane      (KernelPool* pool, KernelLane* lane);
+void        runKernelThread     (KernelPool* pool, KernelLane* lane);
+void        runKernelLane       (KernelPool* pool, KernelLane* lane);
+CpuError    runKernelInvocation (KernelPool* pool, CPU* kernel, size_t x, size_t y);
+bool        isKernelRange       (double x, double y, double width, double height);
+
+CpuError launchKernel(CPU* cpu, size_t target, double x, double y, double width, double height)
+{
+    assert(cpu != NULL);
+
+    if (cpu->isKernel)                       { return CPU_LAUNCH_ERROR;         }
+    if (!isKernelRange(x, y, width, height)) { return CPU_INVALID_CMD_ARGUMENT; }
+    if (width < 1 || height < 1)             { return CPU_NO_ERROR;             }
+
+    if (cpu->kernels == NULL) { cpu->kernels = newKernelPool(cpu); }
+    if (cpu->kernels == NULL) { return CPU_LAUNCH_ERROR; }
+
+    KernelPool* pool = cpu->kernels;
+    {
+        std::lock_guard<std::mutex> launchGuard(pool->lock);
+
+        pool->target       = target;
+        pool->x            = (size_t) x;
+        pool->y            = (size_t) y;
+        pool->width        = (size_t) width;
+        pool->height       = (size_t) height;
+        pool->error        = CPU_NO_ERROR;
+        pool->runningCount = pool->lanesCount - 1;
+        pool->nextRow.store(0, std::memory_order_relaxed);
+        pool->isFailed.store(false, std::memory_order_relaxed);
+        pool->launchNumber++;
+    }
+    pool->launched.notify_all();
+
+    runKernelLane(pool, &pool->lanes[0]);
+
+    std::unique_lock<std::mutex> finishGuard(pool->lock);
+    pool->finished.wait(finishGuard, [pool] { return pool->runningCount == 0; });
+
+    for (size_t i = 0; i < pool->lanesCount; i++)
+    {
+        countInstructions(cpu, pool->lanes[i].cpu.instructionsCount.load(std::memory_order_relaxed));
+        pool->lanes[i].cpu.instructionsCount.store(0, std::memory_order_relaxed);
+    }
+
+    return pool->error;
+}
+
+// --threads lanes or one per core, the threads are started here
+KernelPool* newKernelPool(CPU* cpu)
+{
+    assert(cpu != NULL);
+
+    size_t lanesCount = cpu->options.kernelThreads;
+    if (lanesCount == 0) { lanesCount = std::thread::hardware_concurrency(); }
+    if (lanesCount == 0) { lanesCount = 1; }
+
+    // the profiler and the tracer of the CPU are used by one thread only
+#if defined(CPU_PROFILE_MODE) || defined(CPU_TRACE_MODE)
+    lanesCount = 1;
+#endif
+
+    KernelPool* pool = new KernelPool();
+    pool->cpu   = cpu;
+    pool->lanes = new KernelLane[lanesCount];
+
+    for (size_t i = 0; i < lanesCount; i++)
+    {
+        if (!initKernelLane(pool, &pool->lanes[i]))
+        {
+            fprintf(getCpuMessages(cpu), "Cpu error: not enough memory for the stacks of %zu kernel threads\n", lanesCount);
+            deleteKernelPool(pool);
+            return NULL;
+        }
+
+        pool->lanesCount++;
+    }
+
+    for (size_t i = 1; i < lanesCount; i++)
+    {
+        pool->lanes[i].thread = std::thread(runKernelThread, pool, &pool->lanes[i]);
+    }
+
+    return pool;
+}
+
+void deleteKernelPool(KernelPool* pool)
+{
+    if (pool == NULL) { return; }
+
+    {
+        std::lock_guard<std::mutex> stopGuard(pool->lock);
+        pool->isStopped = true;
+    }
+    pool->launched.notify_all();
+
+    for (size_t i = 0; i < pool->lanesCount; i++)
+    {
+        KernelLane* lane = &pool->lanes[i];
+        if (lane->thread.joinable()) { lane->thread.join(); }
+
+        deleteOperandStack(&lane->cpu.stack);
+        stackDestruct(&lane->cpu.callStack);
+    }
+
+    delete[] pool->lanes;
+    delete pool;
+}
+
+// the lane owns its stacks only
+bool initKernelLane(KernelPool* pool, KernelLane* lane)
+{
+    assert(pool != NULL);
+    assert(lane != NULL);
+
+    CPU* cpu    = pool->cpu;
+    CPU* kernel = &lane->cpu;
+
+    kernel->options      = cpu->options;
+    kernel->program      = cpu->program;
+    kernel->programBytes = cpu->programBytes;
+    kernel->ram          = cpu->ram;
+    kernel->isKernel     = true;
+
+    // an access to a device register is out of the RAM
+    kernel->ram.devices      = NULL;
+    kernel->ram.devicesStart = SIZE_MAX;
+
+#ifdef CPU_PROFILE_MODE
+    kernel->profiler = cpu->profiler;
+#endif
+
+#ifdef CPU_TRACE_MODE
+    kernel->tracer = cpu->tracer;
+#endif
+
+    stackDefaultConstruct(&kernel->callStack);
+
+    return newOperandStack(&kernel->stack, cpu->options.stackCapacity);
+}
+
+void runKernelThread(KernelPool* pool, KernelLane* lane)
+{
+    assert(pool != NULL);
+    assert(lane != NULL);
+
+    uint64_t launchNumber = 0;
+    while (true)
+    {
+        {
+            std::unique_lock<std::mutex> waitGuard(pool->lock);
+            pool->launched.wait(waitGuard, [pool, launchNumber] { return pool->isStopped || pool->launchNumber != launchNumber; });
+
+            if (pool->isStopped) { return; }
+            launchNumber = pool->launchNumber;
+        }
+
+        runKernelLane(pool, lane);
+
+        std::lock_guard<std::mutex> finishGuard(pool->lock);
+        if (--pool->runningCount == 0) { pool->finished.notify_one(); }
+    }
+}
+
+// takes rows until there are none left or an invocation failed
+void runKernelLane(KernelPool* pool, KernelLane* lane)
+{
+    assert(pool != NULL);
+    assert(lane != NULL);
+
+    size_t row = 0;
+    while ((row = pool->nextRow.fetch_add(1, std::memory_order_relaxed)) < pool->height)
+    {
+        if (pool->isFailed.load(std::memory_order_relaxed)) { return; }
+
+        for (size_t column = 0; column < pool->width; column++)
+        {
+            CpuError error = runKernelInvocation(pool, &lane->cpu, pool->x + column, pool->y + row);
+            if (error == CPU_NO_ERROR) { continue; }
+
+            std::lock_guard<std::mutex> errorGuard(pool->lock);
+            if (pool->error == CPU_NO_ERROR) { pool->error = error; }
+            pool->isFailed.store(true, std::memory_order_relaxed);
+
+            return;
+        }
+    }
+}
+
+// ret of the kernel returns to the end of the program, which finishes the invocation as hlt does
+CpuError runKernelInvocation(KernelPool* pool, CPU* kernel, size_t x, size_t y)
+{
+    assert(pool   != NULL);
+    assert(kernel != NULL);
+
+    memcpy(kernel->regs, pool->cpu->regs, sizeof(kernel->regs));
+
+    kernel->stack.top      = kernel->stack.base;
+    kernel->callStack.size = 0;
+    stackPush(&kernel->callStack, (double) kernel->programBytes);
+
+    operandStackPush(&kernel->stack, (double) x);
+    operandStackPush(&kernel->stack, (double) y);
+
+    kernel->pc     = pool->target;
+    kernel->halt   = false;
+    kernel->status = CPU_NO_ERROR;
+
+#ifdef CPU_PROFILE_MODE
+    // an invocation is a call of the kernel from launch in the call graph
+    profilerOnCall(kernel->profiler, pool->target);
+    profilerApplyCallEvent(kernel->profiler);
+#endif
+
+    CpuError error = executeProgram(kernel);
+    if (error == CPU_REACHED_PROGRAM_END_NOT_HALTED && kernel->pc == kernel->programBytes) { error = CPU_NO_ERROR;     }
+    if (error == CPU_TRAP)                                                                 { error = CPU_LAUNCH_ERROR; }
+
+#ifdef CPU_PROFILE_MODE
+    if (error == CPU_NO_ERROR && kernel->halt)
+    {
+        profilerOnRet(kernel->profiler);
+        profilerApplyCallEvent(kernel->profiler);
+    }
+#endif
+
+    return error;
+}
+
+// NaN isn't in the range
+bool isKernelRange(double x, double y, double width, double height)
+{
+    return x >= 0 && y >= 0 && width >= 0 && height >= 0 &&
+           x + width < KERNEL_MAX_COORDINATE && y + height < KERNEL_MAX_COORDINATE;
+}
@@ -0,0 +1,56 @@
+#pragma once
+#include <stddef.h>
+#include <stdint.h>
+#include <atomic>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+#include "cpu_specification.h"
+
+// launch runs a kernel, the code from a label up to its ret or hlt, once for every pixel of a
+// rectangle. Every invocation starts with x and y on an empty operand stack and a copy of the
+// registers of the CPU, so invocations don't depend on each other, and they are spread over a pool
+// of threads: rows of the rectangle are handed out one at a time, the launching thread takes rows
+// too. The threads are started by the first launch of a CPU and wait for the next one until the
+// CPU is deleted.
+//
+// Kernels share the code and the RAM of the CPU, invocations which write the same cells race, so a
+// kernel writes the VRAM bytes of its own pixel only. The device registers aren't mapped for
+// kernels. launch and brk (or a breakpoint) in a kernel are CPU_LAUNCH_ERROR, a kernel is debugged
+// by calling it with x and y pushed. Profiling and tracing builds run all the invocations on the
+// launching thread.
+
+// the CPU of a thread, its program and RAM are the ones of the launching CPU
+struct KernelLane
+{
+    CPU         cpu    = {};
+    std::thread thread;
+};
+
+struct KernelPool
+{
+    CPU*                    cpu           = NULL; // the launching one
+    KernelLane*             lanes         = NULL; // lane 0 is run by the launching thread
+    size_t                  lanesCount    = 0;
+
+    std::mutex              lock;
+    std::condition_variable launched;
+    std::condition_variable finished;
+    uint64_t                launchNumber  = 0;
+    size_t                  runningCount  = 0; // lanes of the current launch still running
+    bool                    isStopped     = false;
+
+    // the current launch
+    size_t                  target        = 0;
+    size_t                  x             = 0;
+    size_t                  y             = 0;
+    size_t                  width         = 0;
+    size_t                  height        = 0;
+    std::atomic<size_t>     nextRow       {0};
+    std::atomic<bool>       isFailed      {false};
+    CpuError                error         = CPU_NO_ERROR; // of the first invocation which failed
+};
+
+// the pool of the CPU is created by the first launch; an error of an invocation stops the launch
+CpuError launchKernel     (CPU* cpu, size_t target, double x, double y, double width, double height);
+void     deleteKernelPool (KernelPool* pool);
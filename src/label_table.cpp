@@ -0,0 +1,134 @@
+#include <assert.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "label_table.h"
+
+uint64_t hashLabelName  (const char* name, size_t length);
+bool     growLabelSlots (LabelTable* table);
+
+LabelTable* newLabelTable()
+{
+    LabelTable* table = (LabelTable*) calloc(1, sizeof(LabelTable));
+    if (table == NULL) { return NULL; }
+
+    table->labels     = (Label*)  calloc(LABEL_TABLE_DEFAULT_CAPACITY,     sizeof(Label));
+    table->slots      = (size_t*) calloc(LABEL_TABLE_DEFAULT_CAPACITY * 2, sizeof(size_t));
+    table->capacity   = LABEL_TABLE_DEFAULT_CAPACITY;
+    table->slotsCount = LABEL_TABLE_DEFAULT_CAPACITY * 2;
+
+    if (table->labels == NULL || table->slots == NULL)
+    {
+        deleteLabelTable(table);
+        return NULL;
+    }
+
+    return table;
+}
+
+void deleteLabelTable(LabelTable* table)
+{
+    if (table == NULL) { return; }
+
+    clearArena(&table->names);
+    free(table->labels);
+    free(table->slots);
+    free(table);
+}
+
+Label* findLabel(LabelTable* table, const char* name)
+{
+    assert(name != NULL);
+
+    return findLabel(table, name, strlen(name));
+}
+
+// name doesn't have to be null terminated
+Label* findLabel(LabelTable* table, const char* name, size_t length)
+{
+    assert(table != NULL);
+    assert(name  != NULL);
+
+    uint64_t hash = hashLabelName(name, length);
+    size_t   mask = table->slotsCount - 1;
+
+    for (size_t slot = hash & mask; table->slots[slot] != 0; slot = (slot + 1) & mask)
+    {
+        Label* label = &table->labels[table->slots[slot] - 1];
+
+        if (label->hash == hash && strncmp(label->name, name, length) == 0 && label->name[length] == '\0') { return label; }
+    }
+
+    return NULL;
+}
+
+// the label must not be in the table yet, the returned pointer is valid until the next addLabel
+Label* addLabel(LabelTable* table, const char* name, size_t length, double value)
+{
+    assert(table != NULL);
+    assert(name  != NULL);
+
+    if (table->count == table->capacity)
+    {
+        Label* labels = (Label*) realloc(table->labels, table->capacity * 2 * sizeof(Label));
+        if (labels == NULL) { return NULL; }
+
+        table->labels    = labels;
+        table->capacity *= 2;
+    }
+
+    if ((table->count + 1) * 2 > table->slotsCount && !growLabelSlots(table)) { return NULL; }
+
+    Label* label = &table->labels[table->count];
+    label->name  = arenaCopyString(&table->names, name, length);
+    label->value = value;
+    label->hash  = hashLabelName(name, length);
+    if (label->name == NULL) { return NULL; }
+
+    size_t mask = table->slotsCount - 1;
+    size_t slot = label->hash & mask;
+    while (table->slots[slot] != 0) { slot = (slot + 1) & mask; }
+
+    table->slots[slot] = ++table->count;
+
+    return label;
+}
+
+// FNV-1a
+uint64_t hashLabelName(const char* name, size_t length)
+{
+    assert(name != NULL);
+
+    uint64_t hash = 14695981039346656037ull;
+    for (size_t i = 0; i < length; i++)
+    {
+        hash ^= (unsigned char) name[i];
+        hash *= 1099511628211ull;
+    }
+
+    return hash;
+}
+
+bool growLabelSlots(LabelTable* table)
+{
+    assert(table != NULL);
+
+    size_t  slotsCount = table->slotsCount * 2;
+    size_t* slots      = (size_t*) calloc(slotsCount, sizeof(size_t));
+    if (slots == NULL) { return false; }
+
+    size_t mask = slotsCount - 1;
+    for (size_t i = 0; i < table->count; i++)
+    {
+        size_t slot = table->labels[i].hash & mask;
+        while (slots[slot] != 0) { slot = (slot + 1) & mask; }
+
+        slots[slot] = i + 1;
+    }
+
+    free(table->slots);
+    table->slots      = slots;
+    table->slotsCount = slotsCount;
+
+    return true;
+}
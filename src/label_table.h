@@ -0,0 +1,42 @@
+#pragma once
+#include <stddef.h>
+#include <stdint.h>
+#include "arena.h"
+
+// Labels of the assembler in the order of definition, indexed by an open addressing hash table.
+// Names are interned in an arena, so there is no allocation per label.
+
+static const size_t LABEL_TABLE_DEFAULT_CAPACITY = 64;
+
+struct Label
+{
+    char*    name  = NULL;
+    double   value = 0;
+    uint64_t hash  = 0;
+};
+
+// reference to a label from the bytecode, it is patched once the whole file is read
+struct Fixup
+{
+    size_t offset     = 0; // of the double in the bytecode
+    char*  labelName  = NULL;
+    size_t lineNumber = 0;
+};
+
+struct LabelTable
+{
+    Label*  labels     = NULL;
+    size_t  count      = 0;
+    size_t  capacity   = 0;
+
+    size_t* slots      = NULL; // index of the label + 1, 0 for an empty slot
+    size_t  slotsCount = 0;    // power of two, at most half of the slots are used
+
+    Arena   names      = {};
+};
+
+LabelTable* newLabelTable    ();
+void        deleteLabelTable (LabelTable* table);
+Label*      findLabel        (LabelTable* table, const char* name);
+Label*      findLabel        (LabelTable* table, const char* name, size_t length);
+Label*      addLabel         (LabelTable* table, const char* name, size_t length, double value);
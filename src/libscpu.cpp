@@ -0,0 +1,146 @@
+#include <assert.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "assembler_specification.h"
+#include "bytecode.h"
+#include "libscpu.h"
+
+bool isScpuRamRange (const CPU* cpu, size_t cell, size_t count);
+
+CPU* newScpu(const unsigned char* bytecode, size_t size, const CpuOptions* options,
+             FILE* messages, CpuInitError* error)
+{
+    CpuInitError initError = CPU_INIT_NO_ERROR;
+    if (error == NULL) { error = &initError; }
+
+    if (bytecode == NULL && size != 0) { *error = CPU_INIT_NULL_PTR_PARAMETER; return NULL; }
+
+    // not calloc, the CPU has atomic members
+    CPU* cpu = new CPU();
+    cpu->messages = messages;
+    if (options != NULL) { cpu->options = *options; }
+    else                 { cpu->options.isHeadless = true; }
+
+    BytecodeImage image = {};
+    if (!loadBytecodeBuffer(bytecode, size, &image))
+    {
+        clearBytecodeImage(&image);
+        delete cpu;
+
+        *error = CPU_INIT_BYTECODE_FILE_READ_ERROR;
+        return NULL;
+    }
+
+    *error = initCpuFromImage(cpu, &image);
+    if (*error != CPU_INIT_NO_ERROR)
+    {
+        deleteScpu(cpu);
+        return NULL;
+    }
+
+    return cpu;
+}
+
+void deleteScpu(CPU* cpu)
+{
+    if (cpu == NULL) { return; }
+
+    deleteCpu(cpu);
+    delete cpu;
+}
+
+CpuError runScpu(CPU* cpu)
+{
+    assert(cpu != NULL);
+
+    return executeProgram(cpu);
+}
+
+CpuError stepScpu(CPU* cpu)
+{
+    assert(cpu != NULL);
+
+    return executeInstruction(cpu);
+}
+
+bool getScpuRegister(const CPU* cpu, size_t index, double* value)
+{
+    assert(cpu   != NULL);
+    assert(value != NULL);
+
+    if (index >= CPU_REGISTERS_COUNT) { return false; }
+
+    *value = cpu->regs[index];
+
+    return true;
+}
+
+bool setScpuRegister(CPU* cpu, size_t index, double value)
+{
+    assert(cpu != NULL);
+
+    if (index >= CPU_REGISTERS_COUNT) { return false; }
+
+    cpu->regs[index] = value;
+
+    return true;
+}
+
+// the device registers aren't read or written here, they have side effects
+bool readScpuRam(const CPU* cpu, size_t cell, double* values, size_t count)
+{
+    assert(cpu    != NULL);
+    assert(values != NULL || count == 0);
+
+    if (!isScpuRamRange(cpu, cell, count)) { return false; }
+
+    for (size_t i = 0; i < count; i++) { values[i] = readRam(&cpu->ram, cell + i); }
+
+    return true;
+}
+
+bool writeScpuRam(CPU* cpu, size_t cell, const double* values, size_t count)
+{
+    assert(cpu    != NULL);
+    assert(values != NULL || count == 0);
+
+    if (!isScpuRamRange(cpu, cell, count)) { return false; }
+
+    for (size_t i = 0; i < count; i++) { writeRam(&cpu->ram, cell + i, values[i]); }
+
+    return true;
+}
+
+// the whole range is either in the cells or in the VRAM
+bool isScpuRamRange(const CPU* cpu, size_t cell, size_t count)
+{
+    assert(cpu != NULL);
+
+    const RAM* ram = &cpu->ram;
+
+    if (cell <= ram->cellsCount && count <= ram->cellsCount - cell) { return true; }
+
+    return cell >= ram->vramStart && cell - ram->vramStart <= ram->vramSize && count <= ram->vramSize - (cell - ram->vramStart);
+}
+
+bool assembleScpuSource(const char* source, size_t size, bool isOptimized, FILE* messages,
+                        unsigned char** bytecode, size_t* bytecodeSize)
+{
+    assert(bytecode     != NULL);
+    assert(bytecodeSize != NULL);
+
+    Assembler assembler = {};
+    assembler.isOptimized = isOptimized;
+    if (messages != NULL) { assembler.messages = messages; }
+
+    BytecodeImage image = {};
+    bool isAssembled = initAssemblerForSource(&assembler, source, size) == ASSEMBLER_INIT_NO_ERROR &&
+                       translateAssemblySource(&assembler, &image) &&
+                       writeBytecodeBuffer(&image, bytecode, bytecodeSize);
+
+    clearBytecodeImage(&image);
+    finishAssembler(&assembler);
+
+    return isAssembled;
+}
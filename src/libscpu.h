@@ -0,0 +1,41 @@
+#pragma once
+#include <stddef.h>
+#include <stdio.h>
+#include "cpu_specification.h"
+
+// The CPU and the assembler as a library (libmake builds bin/libscpu.a) for hosts which run
+// programs in their own long-lived process. CPUs don't share any state, every function works
+// on its own arguments only and never ends the process, a CPU is used by one thread at a time.
+//
+// The process-wide state is set up once and doesn't change after that:
+//
+//     the SIGSEGV handler, installed with the first CPU, turns faults on the guard pages into
+//     CPU errors and passes other faults on to the handler which was there before it
+//     the tables of MATH_MODE_TABLE, filled with the first CPU which uses them
+//
+// launch runs kernels on threads of the CPU itself (see kernel_pool.h), and so does the metrics
+// exporter (see metrics.h), they are stopped by deleteScpu. Programs still read (in) from stdin
+// and write (out) to stdout. A CPU with a display holds the video subsystem of SDL until it's
+// deleted, closing the window stops the CPU; if the display can't be created, newScpu fails with
+// CPU_INIT_DISPLAY_ERROR.
+
+// bytecode is the contents of a bytecode file (see assembleScpuSource), it's copied; options
+// can be NULL for the defaults without a display; the errors of the initialization and of the
+// threads of the CPU go to messages (NULL for stdout), error, if not NULL, gets the reason of NULL
+CPU*     newScpu            (const unsigned char* bytecode, size_t size, const CpuOptions* options,
+                             FILE* messages, CpuInitError* error);
+void     deleteScpu         (CPU* cpu);
+
+// until hlt, brk (CPU_TRAP) or an error; a single instruction
+CpuError runScpu            (CPU* cpu);
+CpuError stepScpu           (CPU* cpu);
+
+// false for an index or a range out of the registers or out of the RAM and the VRAM
+bool     getScpuRegister    (const CPU* cpu, size_t index, double* value);
+bool     setScpuRegister    (CPU* cpu, size_t index, double value);
+bool     readScpuRam        (const CPU* cpu, size_t cell, double* values, size_t count);
+bool     writeScpuRam       (CPU* cpu, size_t cell, const double* values, size_t count);
+
+// the bytecode is from malloc, the errors go to messages (NULL for stdout)
+bool     assembleScpuSource (const char* source, size_t size, bool isOptimized, FILE* messages,
+                             unsigned char** bytecode, size_t* bytecodeSize);
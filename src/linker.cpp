@@ -0,0 +1,361 @@
+#include <assert.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "assembler_specification.h"
+#include "build_cache.h"
+#include "linker_specification.h"
+#include "symbols.h"
+
+const char* DEFAULT_LINKED_FILE_NAME = "bin/bytecode.bcd";
+
+bool  assembleThroughCache (Linker* linker, LinkerInput* input);
+bool  collectExports       (Linker* linker);
+bool  relocateModule       (Linker* linker, LinkerInput* input, unsigned char* code);
+bool  writeLinkedLabels    (Linker* linker, const BytecodeImage* image);
+
+#ifndef LINKER_NO_MAIN
+int main(int argc, char* argv[])
+{
+    Linker linker = {};
+
+    LinkerInitError linkerInitError = initLinker(&linker, argc, argv);
+    if (linkerInitError != LINKER_INIT_NO_ERROR) { finishLinker(&linker); return linkerInitError; }
+
+    bool isLinkedSuccessfuly = linkProgram(&linker);
+    if (!isLinkedSuccessfuly) { printf("Linker finished with an error.\n"); }
+
+    finishLinker(&linker);
+
+    return !isLinkedSuccessfuly;
+}
+#endif
+
+#define LINKER_INIT_ERROR(error) printf("Linker error: %s\n", #error); return error;
+
+// sld <output bytecode> <object or source>... [-O] [--cache <dir>]
+LinkerInitError initLinker(Linker* linker, int argc, char* argv[])
+{
+    if (linker == NULL) { LINKER_INIT_ERROR(LINKER_INIT_NULL_PTR_PARAMETER); }
+    if (argv   == NULL) { LINKER_INIT_ERROR(LINKER_INIT_ARGS_EMPTY); }
+    if (argc   <= 1   ) { LINKER_INIT_ERROR(LINKER_INIT_BCD_FILE_UNSPECIFIED); }
+
+    linker->bytecodeFileName = DEFAULT_LINKED_FILE_NAME;
+    linker->cacheDir         = DEFAULT_BUILD_CACHE_DIR;
+
+    linker->inputs = (LinkerInput*) calloc((size_t) argc, sizeof(LinkerInput));
+    if (linker->inputs == NULL) { LINKER_INIT_ERROR(LINKER_INIT_NOT_ENOUGH_MEMORY); }
+
+    bool isOutputSet = false;
+    for (int i = 1; i < argc; i++)
+    {
+        if (strcmp(argv[i], "-O") == 0)
+        {
+            linker->isOptimized = true;
+        }
+        else if (strcmp(argv[i], "--cache") == 0)
+        {
+            if (i + 1 == argc) { LINKER_INIT_ERROR(LINKER_INIT_INVALID_OPTION); }
+            linker->cacheDir = argv[++i];
+        }
+        else if (argv[i][0] == '-')
+        {
+            printf("Unknown option '%s'.\n", argv[i]);
+            LINKER_INIT_ERROR(LINKER_INIT_INVALID_OPTION);
+        }
+        else if (!isOutputSet)
+        {
+            linker->bytecodeFileName = argv[i];
+            isOutputSet = true;
+        }
+        else
+        {
+            linker->inputs[linker->inputsCount++].fileName = argv[i];
+        }
+    }
+
+    if (linker->inputsCount == 0) { LINKER_INIT_ERROR(LINKER_INIT_INPUT_FILES_UNSPECIFIED); }
+
+    linker->exports = newLabelTable();
+    if (linker->exports == NULL) { LINKER_INIT_ERROR(LINKER_INIT_NOT_ENOUGH_MEMORY); }
+
+    return LINKER_INIT_NO_ERROR;
+}
+
+void finishLinker(Linker* linker)
+{
+    assert(linker != NULL);
+
+    for (size_t i = 0; i < linker->inputsCount; i++)
+    {
+        free(linker->inputs[i].objectFileName);
+        deleteObjectFile(linker->inputs[i].object);
+    }
+
+    free(linker->inputs);
+    linker->inputs      = NULL;
+    linker->inputsCount = 0;
+
+    if (linker->exports != NULL)
+    {
+        deleteLabelTable(linker->exports);
+        linker->exports = NULL;
+    }
+}
+
+bool linkProgram(Linker* linker)
+{
+    assert(linker         != NULL);
+    assert(linker->inputs != NULL);
+
+    size_t codeSize = 0;
+    for (size_t i = 0; i < linker->inputsCount; i++)
+    {
+        LinkerInput* input = &linker->inputs[i];
+        if (!prepareObject(linker, input)) { return false; }
+
+        input->base  = codeSize;
+        codeSize    += input->object->codeSize;
+    }
+
+    if (!collectExports(linker)) { return false; }
+
+    unsigned char* code = (unsigned char*) calloc(codeSize + 1, sizeof(unsigned char));
+    if (code == NULL) { printf("Not enough memory for the linked code.\n"); return false; }
+
+    bool isLinked = true;
+    for (size_t i = 0; i < linker->inputsCount && isLinked; i++)
+    {
+        isLinked = relocateModule(linker, &linker->inputs[i], code);
+    }
+
+    // objects have no numeric jump targets, every target is a label and is mapped
+    BytecodeImage image = {};
+    if (isLinked && !compactBytecode(code, codeSize, NULL, 0, &image))
+    {
+        printf("Couldn't compact the linked code.\n");
+        isLinked = false;
+    }
+
+    if (isLinked)
+    {
+        FILE* bytecodeFile = fopen(linker->bytecodeFileName, "wb");
+        isLinked = bytecodeFile != NULL && writeBytecode(bytecodeFile, &image);
+        if (bytecodeFile != NULL) { fclose(bytecodeFile); }
+
+        if (!isLinked) { printf("Couldn't write to file '%s'.\n", linker->bytecodeFileName); }
+    }
+
+    free(code);
+
+    isLinked = isLinked && writeLinkedLabels(linker, &image);
+    if (isLinked)
+    {
+        printf("Linked %zu modules (%zu assembled, %zu from the cache) into %zu bytes.\n",
+               linker->inputsCount, linker->assembledCount, linker->cachedCount, image.size);
+    }
+
+    clearBytecodeImage(&image);
+
+    return isLinked;
+}
+
+// object files are used as they are, anything else is assembled first
+bool prepareObject(Linker* linker, LinkerInput* input)
+{
+    assert(linker != NULL);
+    assert(input  != NULL);
+
+    if (isObjectFile(input->fileName))
+    {
+        input->objectFileName = strdup(input->fileName);
+        if (input->objectFileName == NULL) { printf("Not enough memory.\n"); return false; }
+    }
+    else if (!assembleThroughCache(linker, input))
+    {
+        return false;
+    }
+
+    input->object = loadObjectFile(input->objectFileName);
+    if (input->isTemporary) { remove(input->objectFileName); }
+
+    if (input->object == NULL)
+    {
+        printf("Couldn't load object file '%s'.\n", input->objectFileName);
+        return false;
+    }
+
+    return true;
+}
+
+// the key covers everything the object depends on: the format, the options and the source;
+// without a writable cache directory the module is assembled next to the linked file and isn't kept
+bool assembleThroughCache(Linker* linker, LinkerInput* input)
+{
+    assert(linker != NULL);
+    assert(input  != NULL);
+
+    uint64_t key = BUILD_CACHE_HASH_SEED;
+    key = hashBytes(&OBJECT_FILE_VERSION,  sizeof(OBJECT_FILE_VERSION),  key);
+    key = hashBytes(&ASSEMBLER_VERSION,    sizeof(ASSEMBLER_VERSION),    key);
+    key = hashBytes(&linker->isOptimized,  sizeof(linker->isOptimized),  key);
+
+    if (!hashFile(input->fileName, &key)) { printf("Couldn't read '%s'.\n", input->fileName); return false; }
+
+    input->objectFileName = makeCacheEntryName(linker->cacheDir, key, OBJECT_FILE_EXTENSION);
+    if (input->objectFileName == NULL) { printf("Not enough memory.\n"); return false; }
+
+    if (isCacheEntryPresent(input->objectFileName))
+    {
+        linker->cachedCount++;
+        return true;
+    }
+
+    if (!createCacheDir(linker->cacheDir))
+    {
+        printf("Note: couldn't create the cache directory '%s', '%s' isn't cached.\n", linker->cacheDir, input->fileName);
+        input->isTemporary = true;
+    }
+
+    char* temporaryName = makeTemporaryEntryName(input->isTemporary ? linker->bytecodeFileName : input->objectFileName);
+    if (temporaryName == NULL) { printf("Not enough memory.\n"); return false; }
+
+    char* assemblerArgv[] = { (char*) "asm+", (char*) input->fileName, temporaryName, (char*) "-c", (char*) "-O", NULL };
+
+    Assembler assembler   = {};
+    bool      isAssembled = initAssembler(&assembler, linker->isOptimized ? 5 : 4, assemblerArgv) == ASSEMBLER_INIT_NO_ERROR &&
+                            translateAssemblyFile(&assembler);
+    finishAssembler(&assembler);
+
+    if (!isAssembled)
+    {
+        remove(temporaryName);
+        free(temporaryName);
+
+        printf("Couldn't assemble '%s'.\n", input->fileName);
+        return false;
+    }
+
+    linker->assembledCount++;
+
+    if (input->isTemporary)
+    {
+        free(input->objectFileName);
+        input->objectFileName = temporaryName;
+
+        return true;
+    }
+
+    // another link could have committed the same entry in the meantime
+    bool isCommitted = commitCacheEntry(temporaryName, input->objectFileName) || isCacheEntryPresent(input->objectFileName);
+    free(temporaryName);
+
+    if (!isCommitted) { printf("Couldn't write '%s' to the cache.\n", input->fileName); return false; }
+
+    return true;
+}
+
+bool collectExports(Linker* linker)
+{
+    assert(linker != NULL);
+
+    for (size_t i = 0; i < linker->inputsCount; i++)
+    {
+        const LinkerInput* input = &linker->inputs[i];
+
+        for (size_t j = 0; j < input->object->symbolsCount; j++)
+        {
+            const ObjectSymbol* symbol = &input->object->symbols[j];
+            if (!symbol->isExported) { continue; }
+
+            if (findLabel(linker->exports, symbol->name) != NULL)
+            {
+                printf("Link ERROR: symbol '%s' is exported more than once, again by '%s'\n", symbol->name, input->fileName);
+                return false;
+            }
+
+            if (addLabel(linker->exports, symbol->name, strlen(symbol->name), (double) (input->base + symbol->offset)) == NULL)
+            {
+                printf("Not enough memory for symbols.\n");
+                return false;
+            }
+        }
+    }
+
+    return true;
+}
+
+// a reference is resolved to a label of the same module first, then to an exported one
+bool relocateModule(Linker* linker, LinkerInput* input, unsigned char* code)
+{
+    assert(linker != NULL);
+    assert(input  != NULL);
+    assert(code   != NULL);
+
+    const ObjectFile* object = input->object;
+    memcpy(code + input->base, object->code, object->codeSize);
+
+    LabelTable* locals = newLabelTable();
+    if (locals == NULL) { printf("Not enough memory for symbols.\n"); return false; }
+
+    bool isRelocated = true;
+    for (size_t i = 0; i < object->symbolsCount && isRelocated; i++)
+    {
+        const ObjectSymbol* symbol = &object->symbols[i];
+        isRelocated = addLabel(locals, symbol->name, strlen(symbol->name), (double) (input->base + symbol->offset)) != NULL;
+    }
+
+    for (size_t i = 0; i < object->relocationsCount && isRelocated; i++)
+    {
+        const ObjectRelocation* relocation = &object->relocations[i];
+
+        Label* label = findLabel(locals, relocation->name);
+        if (label == NULL) { label = findLabel(linker->exports, relocation->name); }
+
+        if (label == NULL)
+        {
+            printf("Link ERROR: undefined symbol '%s' in '%s': line %zu\n", relocation->name, input->fileName, relocation->lineNumber);
+            isRelocated = false;
+            break;
+        }
+
+        memcpy(code + input->base + relocation->offset, &label->value, sizeof(label->value));
+    }
+
+    deleteLabelTable(locals);
+
+    return isRelocated;
+}
+
+// all symbols of all modules, so the debugger and the profiler see the same names as in one file
+bool writeLinkedLabels(Linker* linker, const BytecodeImage* image)
+{
+    assert(linker != NULL);
+    assert(image  != NULL);
+
+    char* labelsFileName = makeSymbolsFileName(linker->bytecodeFileName);
+    if (labelsFileName == NULL) { printf("Not enough memory.\n"); return false; }
+
+    FILE* labelsFile = fopen(labelsFileName, "w");
+    free(labelsFileName);
+    if (labelsFile == NULL) { printf("Couldn't open labels file.\n"); return false; }
+
+    bool isWritten = true;
+    for (size_t i = 0; i < linker->inputsCount && isWritten; i++)
+    {
+        const LinkerInput* input = &linker->inputs[i];
+
+        for (size_t j = 0; j < input->object->symbolsCount && isWritten; j++)
+        {
+            const ObjectSymbol* symbol = &input->object->symbols[j];
+            isWritten = fprintf(labelsFile, "%zu %s\n", mapWideOffset(image, input->base + symbol->offset), symbol->name) >= 0;
+        }
+    }
+
+    fclose(labelsFile);
+
+    if (!isWritten) { printf("Couldn't write to labels file.\n"); }
+
+    return isWritten;
+}
@@ -0,0 +1,48 @@
+#pragma once
+#include <stddef.h>
+#include "label_table.h"
+#include "object_file.h"
+
+// sld links object files written by asm+ -c into one bytecode file. Inputs which aren't object
+// files are assembled as sources, through a cache keyed by their contents, so only the changed
+// modules of a program are assembled again. The code of the first input comes first, so the
+// program starts there.
+
+enum LinkerInitError
+{
+	LINKER_INIT_NO_ERROR,
+	LINKER_INIT_NULL_PTR_PARAMETER,
+	LINKER_INIT_ARGS_EMPTY,
+	LINKER_INIT_BCD_FILE_UNSPECIFIED,
+	LINKER_INIT_INPUT_FILES_UNSPECIFIED,
+	LINKER_INIT_INVALID_OPTION,
+	LINKER_INIT_NOT_ENOUGH_MEMORY
+};
+
+struct LinkerInput
+{
+    const char* fileName       = NULL;
+    char*       objectFileName = NULL; // the input itself or its cache entry
+    bool        isTemporary    = false; // the object is assembled outside the cache and removed once loaded
+    ObjectFile* object         = NULL;
+    size_t      base           = 0;    // offset of the module code in the linked bytecode
+};
+
+struct Linker
+{
+    const char*  bytecodeFileName = NULL;
+    const char*  cacheDir         = NULL;
+    bool         isOptimized      = false; // -O for the sources assembled by the linker
+
+    LinkerInput* inputs           = NULL;
+    size_t       inputsCount      = 0;
+
+    LabelTable*  exports          = NULL;  // exported symbols of all modules, the value is the address
+    size_t       assembledCount   = 0;
+    size_t       cachedCount      = 0;
+};
+
+LinkerInitError initLinker    (Linker* linker, int argc, char* argv[]);
+void            finishLinker  (Linker* linker);
+bool            linkProgram   (Linker* linker);
+bool            prepareObject (Linker* linker, LinkerInput* input);
@@ -0,0 +1,259 @@
+#include <assert.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include <unistd.h>
+#include <chrono>
+
+#include "cpu_specification.h"
+#include "metrics.h"
+
+static const char* const METRICS_TEMPORARY_SUFFIX = ".tmp";
+
+bool   openMetricsSocket    (Metrics* metrics);
+void   runMetricsExporter   (Metrics* metrics);
+bool   publishMetrics       (Metrics* metrics);
+size_t formatMetrics        (Metrics* metrics, char* snapshot, size_t capacity);
+bool   writeMetricsFile     (Metrics* metrics, const char* snapshot, size_t length);
+void   sendMetrics          (Metrics* metrics, const char* snapshot, size_t length);
+void   acceptMetricsClients (Metrics* metrics);
+
+Metrics* newMetrics(const CPU* cpu, const char* fileName, const char* socketName, size_t intervalMs)
+{
+    assert(cpu != NULL);
+    assert(fileName != NULL || socketName != NULL);
+
+    Metrics* metrics = new Metrics();
+
+    metrics->cpu          = cpu;
+    metrics->fileName     = fileName;
+    metrics->socketName   = socketName;
+    metrics->intervalMs   = intervalMs != 0 ? intervalMs : METRICS_DEFAULT_INTERVAL_MS;
+    metrics->startNs      = getMetricsTime();
+    metrics->lastSampleNs = metrics->startNs;
+
+    if (fileName != NULL)
+    {
+        metrics->temporaryFileName = (char*) calloc(strlen(fileName) + strlen(METRICS_TEMPORARY_SUFFIX) + 1, sizeof(char));
+        if (metrics->temporaryFileName == NULL) { fprintf(getCpuMessages(cpu), "Metrics error: not enough memory\n"); deleteMetrics(metrics); return NULL; }
+
+        strcpy(metrics->temporaryFileName, fileName);
+        strcat(metrics->temporaryFileName, METRICS_TEMPORARY_SUFFIX);
+    }
+
+    if (socketName != NULL && !openMetricsSocket(metrics))
+    {
+        fprintf(getCpuMessages(cpu), "Metrics error: couldn't listen on the socket '%s'\n", socketName);
+        deleteMetrics(metrics);
+        return NULL;
+    }
+
+    // the first snapshot right away, it also checks that the file can be written
+    if (!publishMetrics(metrics))
+    {
+        fprintf(getCpuMessages(cpu), "Metrics error: couldn't write '%s'\n", fileName);
+        deleteMetrics(metrics);
+        return NULL;
+    }
+
+    metrics->exporter = std::thread(runMetricsExporter, metrics);
+
+    return metrics;
+}
+
+// the last snapshot is published after the exporter stops
+void deleteMetrics(Metrics* metrics)
+{
+    if (metrics == NULL) { return; }
+
+    if (metrics->exporter.joinable())
+    {
+        {
+            std::lock_guard<std::mutex> stopGuard(metrics->lock);
+            metrics->isStopped = true;
+        }
+
+        metrics->stopped.notify_one();
+        metrics->exporter.join();
+
+        publishMetrics(metrics);
+    }
+
+    for (size_t i = 0; i < metrics->clientsCount; i++) { close(metrics->clients[i]); }
+
+    if (metrics->socketDescriptor >= 0)
+    {
+        close(metrics->socketDescriptor);
+        unlink(metrics->socketName);
+    }
+
+    free(metrics->temporaryFileName);
+
+    delete metrics;
+}
+
+uint64_t getMetricsTime()
+{
+    return (uint64_t) std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+// a socket file left by a previous run is replaced, any other file is an error
+bool openMetricsSocket(Metrics* metrics)
+{
+    assert(metrics != NULL);
+
+    sockaddr_un address = {};
+    address.sun_family = AF_UNIX;
+    if (strlen(metrics->socketName) >= sizeof(address.sun_path)) { return false; }
+    strcpy(address.sun_path, metrics->socketName);
+
+    struct stat socketStat = {};
+    if (lstat(metrics->socketName, &socketStat) == 0 && S_ISSOCK(socketStat.st_mode)) { unlink(metrics->socketName); }
+
+    int socketDescriptor = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (socketDescriptor < 0) { return false; }
+
+    if (bind(socketDescriptor, (sockaddr*) &address, sizeof(address)) != 0 ||
+        listen(socketDescriptor, (int) METRICS_MAX_CLIENTS) != 0 ||
+        fcntl(socketDescriptor, F_SETFL, O_NONBLOCK) != 0)
+    {
+        close(socketDescriptor);
+        return false;
+    }
+
+    metrics->socketDescriptor = socketDescriptor;
+
+    return true;
+}
+
+void runMetricsExporter(Metrics* metrics)
+{
+    assert(metrics != NULL);
+
+    std::unique_lock<std::mutex> stopGuard(metrics->lock);
+    while (!metrics->stopped.wait_for(stopGuard, std::chrono::milliseconds(metrics->intervalMs), [metrics] { return metrics->isStopped; }))
+    {
+        publishMetrics(metrics);
+    }
+}
+
+// false if the file couldn't be written
+bool publishMetrics(Metrics* metrics)
+{
+    assert(metrics != NULL);
+
+    char   snapshot[METRICS_MAX_SNAPSHOT_LENGTH] = {};
+    size_t length = formatMetrics(metrics, snapshot, sizeof(snapshot) - 1);
+
+    bool isWritten = metrics->fileName == NULL || writeMetricsFile(metrics, snapshot, length);
+
+    // snapshots in the socket are separated by an empty line
+    snapshot[length] = '\n';
+    if (metrics->socketDescriptor >= 0) { sendMetrics(metrics, snapshot, length + 1); }
+
+    return isWritten;
+}
+
+// mips is over the time since the previous snapshot
+size_t formatMetrics(Metrics* metrics, char* snapshot, size_t capacity)
+{
+    assert(metrics  != NULL);
+    assert(snapshot != NULL);
+
+    const CPU* cpu          = metrics->cpu;
+    uint64_t   now          = getMetricsTime();
+    uint64_t   instructions = cpu->instructionsCount.load(std::memory_order_relaxed);
+    uint64_t   elapsedNs    = now - metrics->lastSampleNs;
+    double     mips         = elapsedNs != 0 ? (double) (instructions - metrics->lastInstructions) * 1e3 / (double) elapsedNs : 0;
+
+    metrics->lastSampleNs     = now;
+    metrics->lastInstructions = instructions;
+
+    int length = snprintf(snapshot, capacity,
+                          "uptime_seconds %.3lf\n"
+                          "instructions %llu\n"
+                          "mips %.1lf\n"
+                          "operand_stack_peak %zu\n"
+                          "call_stack_peak %llu\n"
+                          "frames %llu\n"
+                          "frame_interval_ms %.3lf\n"
+                          "frame_interval_max_ms %.3lf\n"
+                          "present_ms %.3lf\n"
+                          "present_max_ms %.3lf\n"
+                          "in %llu\n"
+                          "out %llu\n",
+                          (double) (now - metrics->startNs) / 1e9,
+                          (unsigned long long) instructions,
+                          mips,
+                          getOperandStackPeak(&cpu->stack),
+                          (unsigned long long) metrics->callStackPeak.load(std::memory_order_relaxed),
+                          (unsigned long long) metrics->framesCount.load(std::memory_order_relaxed),
+                          (double) metrics->frameIntervalNs.load(std::memory_order_relaxed) / 1e6,
+                          (double) metrics->maxFrameIntervalNs.load(std::memory_order_relaxed) / 1e6,
+                          (double) metrics->presentNs.load(std::memory_order_relaxed) / 1e6,
+                          (double) metrics->maxPresentNs.load(std::memory_order_relaxed) / 1e6,
+                          (unsigned long long) metrics->inCount.load(std::memory_order_relaxed),
+                          (unsigned long long) metrics->outCount.load(std::memory_order_relaxed));
+
+    return length > 0 && (size_t) length < capacity ? (size_t) length : 0;
+}
+
+// written next to the file and renamed over it, a reader sees either the old or the new snapshot
+bool writeMetricsFile(Metrics* metrics, const char* snapshot, size_t length)
+{
+    assert(metrics  != NULL);
+    assert(snapshot != NULL);
+
+    FILE* metricsFile = fopen(metrics->temporaryFileName, "w");
+    if (metricsFile == NULL) { return false; }
+
+    bool isWritten = fwrite(snapshot, sizeof(char), length, metricsFile) == length;
+    if (fclose(metricsFile) != 0 || !isWritten || rename(metrics->temporaryFileName, metrics->fileName) != 0)
+    {
+        remove(metrics->temporaryFileName);
+        return false;
+    }
+
+    return true;
+}
+
+// a client which doesn't take the whole snapshot at once is disconnected, the exporter never waits
+void sendMetrics(Metrics* metrics, const char* snapshot, size_t length)
+{
+    assert(metrics  != NULL);
+    assert(snapshot != NULL);
+
+    acceptMetricsClients(metrics);
+
+    for (size_t i = 0; i < metrics->clientsCount;)
+    {
+        if (send(metrics->clients[i], snapshot, length, MSG_NOSIGNAL | MSG_DONTWAIT) == (ssize_t) length)
+        {
+            i++;
+            continue;
+        }
+
+        close(metrics->clients[i]);
+        metrics->clients[i] = metrics->clients[--metrics->clientsCount];
+    }
+}
+
+void acceptMetricsClients(Metrics* metrics)
+{
+    assert(metrics != NULL);
+
+    int client = -1;
+    while ((client = accept(metrics->socketDescriptor, NULL, NULL)) >= 0 || errno == EINTR)
+    {
+        if (client < 0) { continue; }
+
+        if (metrics->clientsCount == METRICS_MAX_CLIENTS) { close(client); continue; }
+
+        metrics->clients[metrics->clientsCount++] = client;
+    }
+}
@@ -0,0 +1,105 @@
+#pragma once
+#include <stddef.h>
+#include <stdint.h>
+#include <atomic>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+
+// Live metrics of a running CPU (--metrics <file>, --metrics-socket <path>): a background thread
+// publishes a snapshot every --metrics-interval milliseconds as "name value" lines, e.g.
+//
+//     instructions 1843200000
+//     mips 412.7
+//
+// into the file, which is replaced as a whole so that it's never read half written, and to every
+// client connected to the UNIX socket, where snapshots are separated by an empty line. The
+// interpreter loop isn't instrumented: instructions are the relaxed counter of the CPU, the
+// operand stack peak is read from the pages of the stack, and the interpreter only updates the
+// counters below at call, upd, in and out. The counters of kernels (see kernel_pool.h) are
+// added when their launch finishes, call, in and out in kernels aren't counted.
+
+static const size_t METRICS_DEFAULT_INTERVAL_MS = 1000;
+static const size_t METRICS_MAX_CLIENTS         = 8;
+static const size_t METRICS_MAX_SNAPSHOT_LENGTH = 1024;
+
+struct CPU;
+
+struct Metrics
+{
+    const CPU*            cpu                = NULL;
+
+    // written by the interpreter thread only, read by the exporter
+    std::atomic<uint64_t> inCount            {0};
+    std::atomic<uint64_t> outCount           {0};
+    std::atomic<uint64_t> callStackPeak      {0};
+    std::atomic<uint64_t> framesCount        {0};
+    std::atomic<uint64_t> lastFrameNs        {0}; // when the last upd started
+    std::atomic<uint64_t> frameIntervalNs    {0}; // between the last two upd
+    std::atomic<uint64_t> maxFrameIntervalNs {0};
+    std::atomic<uint64_t> presentNs          {0}; // of the display update of the last upd
+    std::atomic<uint64_t> maxPresentNs       {0};
+
+    // the exporter
+    std::thread             exporter;
+    std::mutex              lock;
+    std::condition_variable stopped;
+    bool                    isStopped          = false;
+    size_t                  intervalMs         = METRICS_DEFAULT_INTERVAL_MS;
+    const char*             fileName           = NULL;
+    char*                   temporaryFileName  = NULL;
+    const char*             socketName         = NULL;
+    int                     socketDescriptor   = -1;
+    int                     clients[METRICS_MAX_CLIENTS] = {};
+    size_t                  clientsCount       = 0;
+    uint64_t                startNs            = 0;
+    uint64_t                lastSampleNs       = 0;
+    uint64_t                lastInstructions   = 0;
+};
+
+// fileName and socketName can be NULL, not both; NULL if the file or the socket can't be created
+Metrics* newMetrics     (const CPU* cpu, const char* fileName, const char* socketName, size_t intervalMs);
+void     deleteMetrics  (Metrics* metrics);
+uint64_t getMetricsTime ();
+
+// counters are only written by the interpreter thread, so a relaxed load and store is enough
+inline void increaseMetricsCounter(std::atomic<uint64_t>* counter, uint64_t value)
+{
+    counter->store(counter->load(std::memory_order_relaxed) + value, std::memory_order_relaxed);
+}
+
+inline void raiseMetricsPeak(std::atomic<uint64_t>* peak, uint64_t value)
+{
+    if (value > peak->load(std::memory_order_relaxed)) { peak->store(value, std::memory_order_relaxed); }
+}
+
+inline void metricsOnCall(Metrics* metrics, size_t callDepth)
+{
+    raiseMetricsPeak(&metrics->callStackPeak, callDepth);
+}
+
+// the time upd started, for metricsOnPresent
+inline uint64_t metricsOnFrame(Metrics* metrics)
+{
+    uint64_t now       = getMetricsTime();
+    uint64_t lastFrame = metrics->lastFrameNs.load(std::memory_order_relaxed);
+
+    if (lastFrame != 0)
+    {
+        metrics->frameIntervalNs.store(now - lastFrame, std::memory_order_relaxed);
+        raiseMetricsPeak(&metrics->maxFrameIntervalNs, now - lastFrame);
+    }
+
+    metrics->lastFrameNs.store(now, std::memory_order_relaxed);
+    increaseMetricsCounter(&metrics->framesCount, 1);
+
+    return now;
+}
+
+inline void metricsOnPresent(Metrics* metrics, uint64_t frameStart)
+{
+    uint64_t presentTime = getMetricsTime() - frameStart;
+
+    metrics->presentNs.store(presentTime, std::memory_order_relaxed);
+    raiseMetricsPeak(&metrics->maxPresentNs, presentTime);
+}
@@ -0,0 +1,80 @@
+#pragma once
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+#include "instructions.h"
+
+// Mnemonic lookup for the assembler. The table is a perfect hash built at compile time over the
+// instruction descriptors: a seed is searched for with which every mnemonic lands in its own slot,
+// so a lookup is one hash and one string comparison no matter how many commands there are.
+
+static_assert(CPU_COMMANDS_COUNT < 256, "slots keep opcodes in a byte");
+
+constexpr size_t getMnemonicTableSize(size_t commandsCount)
+{
+    size_t size = 1;
+    while (size < commandsCount * 8) { size *= 2; }
+
+    return size;
+}
+
+// power of two with enough room for a seed to be found after a few tries
+static const size_t   MNEMONIC_TABLE_SIZE = getMnemonicTableSize(CPU_COMMANDS_COUNT);
+static const uint32_t MNEMONIC_MAX_SEED   = 1 << 16;
+
+struct MnemonicTable
+{
+    uint32_t      seed                       = 0;
+    unsigned char slots[MNEMONIC_TABLE_SIZE] = {}; // opcode + 1, 0 means an empty slot
+    bool          isPerfect                  = false;
+};
+
+// FNV-1a with the seed mixed into the offset basis
+constexpr uint32_t hashMnemonic(const char* name, size_t length, uint32_t seed)
+{
+    uint32_t hash = 2166136261u ^ (seed * 0x9e3779b9u);
+    for (size_t i = 0; i < length; i++)
+    {
+        hash = (hash ^ (unsigned char) name[i]) * 16777619u;
+    }
+
+    return hash ^ (hash >> 16);
+}
+
+constexpr MnemonicTable buildMnemonicTable()
+{
+    for (uint32_t seed = 0; seed < MNEMONIC_MAX_SEED; seed++)
+    {
+        MnemonicTable table = {};
+        table.seed      = seed;
+        table.isPerfect = true;
+
+        for (size_t i = 0; i < CPU_COMMANDS_COUNT && table.isPerfect; i++)
+        {
+            size_t slot = hashMnemonic(INSTRUCTIONS[i].name, INSTRUCTIONS[i].nameLength, seed) & (MNEMONIC_TABLE_SIZE - 1);
+
+            if (table.slots[slot] != 0) { table.isPerfect = false; }
+            table.slots[slot] = (unsigned char) (i + 1);
+        }
+
+        if (table.isPerfect) { return table; }
+    }
+
+    return {};
+}
+
+static constexpr MnemonicTable MNEMONIC_TABLE = buildMnemonicTable();
+static_assert(MNEMONIC_TABLE.isPerfect, "no perfect hash seed found for the mnemonics, increase MNEMONIC_TABLE_SIZE");
+
+// returns NULL if name[0..length) is not a mnemonic
+inline const InstructionDescriptor* findMnemonic(const char* name, size_t length)
+{
+    size_t        slot  = hashMnemonic(name, length, MNEMONIC_TABLE.seed) & (MNEMONIC_TABLE_SIZE - 1);
+    unsigned char index = MNEMONIC_TABLE.slots[slot];
+    if (index == 0) { return NULL; }
+
+    const InstructionDescriptor* instruction = &INSTRUCTIONS[index - 1];
+    if (instruction->nameLength != length || memcmp(instruction->name, name, length) != 0) { return NULL; }
+
+    return instruction;
+}
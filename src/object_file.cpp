@@ -0,0 +1,198 @@
+#include <assert.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "object_file.h"
+#include "label_table.h"
+
+bool     addObjectName (LabelTable* names, size_t* namesSize, const char* name);
+uint32_t getNameOffset (LabelTable* names, const char* name);
+
+// names are written once, relocations of the same label share them
+bool writeObjectFile(FILE* file, const ObjectFile* object)
+{
+    assert(file   != NULL);
+    assert(object != NULL);
+
+    LabelTable* names = newLabelTable();
+    if (names == NULL) { return false; }
+
+    size_t namesSize = 0;
+    bool   isOk      = true;
+    for (size_t i = 0; i < object->symbolsCount     && isOk; i++) { isOk = addObjectName(names, &namesSize, object->symbols[i].name);     }
+    for (size_t i = 0; i < object->relocationsCount && isOk; i++) { isOk = addObjectName(names, &namesSize, object->relocations[i].name); }
+
+    ObjectFileHeader header = {};
+    memcpy(header.magic, OBJECT_FILE_MAGIC, sizeof(header.magic));
+    header.version          = OBJECT_FILE_VERSION;
+    header.codeSize         = object->codeSize;
+    header.symbolsCount     = object->symbolsCount;
+    header.relocationsCount = object->relocationsCount;
+    header.namesSize        = namesSize;
+
+    isOk = isOk && fwrite(&header, sizeof(header), 1, file) == 1;
+    isOk = isOk && fwrite(object->code, sizeof(unsigned char), object->codeSize, file) == object->codeSize;
+
+    for (size_t i = 0; i < object->symbolsCount && isOk; i++)
+    {
+        ObjectSymbolRecord record = {};
+        record.offset     = object->symbols[i].offset;
+        record.nameOffset = getNameOffset(names, object->symbols[i].name);
+        record.flags      = object->symbols[i].isExported ? OBJECT_SYMBOL_EXPORTED : 0;
+
+        isOk = fwrite(&record, sizeof(record), 1, file) == 1;
+    }
+
+    for (size_t i = 0; i < object->relocationsCount && isOk; i++)
+    {
+        ObjectRelocationRecord record = {};
+        record.offset     = object->relocations[i].offset;
+        record.nameOffset = getNameOffset(names, object->relocations[i].name);
+        record.lineNumber = (uint32_t) object->relocations[i].lineNumber;
+
+        isOk = fwrite(&record, sizeof(record), 1, file) == 1;
+    }
+
+    // in the order of offsets, which is the order they were added in
+    for (size_t i = 0; i < names->count && isOk; i++)
+    {
+        isOk = fwrite(names->labels[i].name, sizeof(char), strlen(names->labels[i].name) + 1, file) != 0;
+    }
+
+    deleteLabelTable(names);
+
+    return isOk;
+}
+
+// returns NULL if the file can't be read or isn't a valid object file
+ObjectFile* loadObjectFile(const char* fileName)
+{
+    assert(fileName != NULL);
+
+    FILE* file = fopen(fileName, "rb");
+    if (file == NULL) { return NULL; }
+
+    ObjectFileHeader header = {};
+    ObjectFile*      object = NULL;
+
+    bool isOk = fread(&header, sizeof(header), 1, file) == 1 &&
+                memcmp(header.magic, OBJECT_FILE_MAGIC, sizeof(header.magic)) == 0 &&
+                header.version == OBJECT_FILE_VERSION;
+
+    if (isOk)
+    {
+        object = (ObjectFile*) calloc(1, sizeof(ObjectFile));
+        isOk   = object != NULL;
+    }
+
+    ObjectSymbolRecord*     symbolRecords     = NULL;
+    ObjectRelocationRecord* relocationRecords = NULL;
+    if (isOk)
+    {
+        object->codeSize         = header.codeSize;
+        object->symbolsCount     = header.symbolsCount;
+        object->relocationsCount = header.relocationsCount;
+
+        object->code        = (unsigned char*)    calloc(header.codeSize + 1,         sizeof(unsigned char));
+        object->symbols     = (ObjectSymbol*)     calloc(header.symbolsCount + 1,     sizeof(ObjectSymbol));
+        object->relocations = (ObjectRelocation*) calloc(header.relocationsCount + 1, sizeof(ObjectRelocation));
+        object->names       = (char*)             calloc(header.namesSize + 1,        sizeof(char));
+        symbolRecords       = (ObjectSymbolRecord*)     calloc(header.symbolsCount + 1,     sizeof(ObjectSymbolRecord));
+        relocationRecords   = (ObjectRelocationRecord*) calloc(header.relocationsCount + 1, sizeof(ObjectRelocationRecord));
+
+        isOk = object->code  != NULL && object->symbols  != NULL && object->relocations  != NULL &&
+               object->names != NULL && symbolRecords    != NULL && relocationRecords    != NULL;
+    }
+
+    isOk = isOk && fread(object->code,      sizeof(unsigned char),          header.codeSize,         file) == header.codeSize;
+    isOk = isOk && fread(symbolRecords,     sizeof(ObjectSymbolRecord),     header.symbolsCount,     file) == header.symbolsCount;
+    isOk = isOk && fread(relocationRecords, sizeof(ObjectRelocationRecord), header.relocationsCount, file) == header.relocationsCount;
+    isOk = isOk && fread(object->names,     sizeof(char),                   header.namesSize,        file) == header.namesSize;
+    isOk = isOk && (header.namesSize == 0 || object->names[header.namesSize - 1] == '\0');
+
+    for (size_t i = 0; i < header.symbolsCount && isOk; i++)
+    {
+        isOk = symbolRecords[i].offset <= header.codeSize && symbolRecords[i].nameOffset < header.namesSize;
+        if (!isOk) { break; }
+
+        object->symbols[i].name       = object->names + symbolRecords[i].nameOffset;
+        object->symbols[i].offset     = symbolRecords[i].offset;
+        object->symbols[i].isExported = (symbolRecords[i].flags & OBJECT_SYMBOL_EXPORTED) != 0;
+    }
+
+    for (size_t i = 0; i < header.relocationsCount && isOk; i++)
+    {
+        isOk = relocationRecords[i].offset + sizeof(double) <= header.codeSize && relocationRecords[i].nameOffset < header.namesSize;
+        if (!isOk) { break; }
+
+        object->relocations[i].name       = object->names + relocationRecords[i].nameOffset;
+        object->relocations[i].offset     = relocationRecords[i].offset;
+        object->relocations[i].lineNumber = relocationRecords[i].lineNumber;
+    }
+
+    free(symbolRecords);
+    free(relocationRecords);
+    fclose(file);
+
+    if (!isOk)
+    {
+        deleteObjectFile(object);
+        return NULL;
+    }
+
+    return object;
+}
+
+void deleteObjectFile(ObjectFile* object)
+{
+    if (object == NULL) { return; }
+
+    free(object->code);
+    free(object->symbols);
+    free(object->relocations);
+    free(object->names);
+    free(object);
+}
+
+bool isObjectFile(const char* fileName)
+{
+    assert(fileName != NULL);
+
+    FILE* file = fopen(fileName, "rb");
+    if (file == NULL) { return false; }
+
+    char magic[sizeof(OBJECT_FILE_MAGIC)] = {};
+    bool isObject = fread(magic, sizeof(magic), 1, file) == 1 && memcmp(magic, OBJECT_FILE_MAGIC, sizeof(magic)) == 0;
+
+    fclose(file);
+
+    return isObject;
+}
+
+// the value of the name is its offset in the names of the file
+bool addObjectName(LabelTable* names, size_t* namesSize, const char* name)
+{
+    assert(names     != NULL);
+    assert(namesSize != NULL);
+    assert(name      != NULL);
+
+    if (findLabel(names, name) != NULL) { return true; }
+
+    size_t length = strlen(name);
+    if (addLabel(names, name, length, (double) *namesSize) == NULL) { return false; }
+
+    *namesSize += length + 1;
+
+    return true;
+}
+
+uint32_t getNameOffset(LabelTable* names, const char* name)
+{
+    assert(names != NULL);
+    assert(name  != NULL);
+
+    Label* label = findLabel(names, name);
+    assert(label != NULL);
+
+    return (uint32_t) label->value;
+}
@@ -0,0 +1,75 @@
+#pragma once
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+
+// Relocatable object file written by the assembler with -c and linked by sld. It holds the code
+// of one module, all of its labels (the exported ones can be used by other modules) and a
+// relocation for every label reference, the double at its offset is written by the linker.
+//
+// Layout: ObjectFileHeader, code, symbols, relocations, names (null-terminated strings).
+
+static const char        OBJECT_FILE_MAGIC[8]  = { 'S', 'C', 'P', 'U', 'O', 'B', 'J', '\0' };
+static const uint32_t    OBJECT_FILE_VERSION   = 1;
+static const char* const OBJECT_FILE_EXTENSION = ".osy";
+
+enum ObjectSymbolFlag
+{
+    OBJECT_SYMBOL_EXPORTED = 1 << 0
+};
+
+struct ObjectFileHeader
+{
+    char     magic[8]         = {};
+    uint32_t version          = 0;
+    uint32_t reserved         = 0;
+    uint64_t codeSize         = 0;
+    uint64_t symbolsCount     = 0;
+    uint64_t relocationsCount = 0;
+    uint64_t namesSize        = 0;
+};
+
+struct ObjectSymbolRecord
+{
+    uint64_t offset     = 0;
+    uint32_t nameOffset = 0;
+    uint32_t flags      = 0;
+};
+
+struct ObjectRelocationRecord
+{
+    uint64_t offset     = 0; // of the double in the code
+    uint32_t nameOffset = 0;
+    uint32_t lineNumber = 0; // of the reference, for error messages
+};
+
+struct ObjectSymbol
+{
+    const char* name       = NULL;
+    size_t      offset     = 0;
+    bool        isExported = false;
+};
+
+struct ObjectRelocation
+{
+    size_t      offset     = 0;
+    const char* name       = NULL;
+    size_t      lineNumber = 0;
+};
+
+struct ObjectFile
+{
+    unsigned char*    code             = NULL;
+    size_t            codeSize         = 0;
+    ObjectSymbol*     symbols          = NULL; // in the order of offsets
+    size_t            symbolsCount     = 0;
+    ObjectRelocation* relocations      = NULL;
+    size_t            relocationsCount = 0;
+
+    char*             names            = NULL; // owned only by loaded files
+};
+
+bool        writeObjectFile  (FILE* file, const ObjectFile* object);
+ObjectFile* loadObjectFile   (const char* fileName);
+void        deleteObjectFile (ObjectFile* object);
+bool        isObjectFile     (const char* fileName);
@@ -0,0 +1,80 @@
+#include <assert.h>
+#include <stdint.h>
+
+#include "operand_stack.h"
+#include "pages.h"
+
+bool newOperandStack(OperandStack* stack, size_t capacity)
+{
+    assert(stack != NULL);
+
+    size_t pageSize  = getPageSize();
+    size_t cellsSize = roundUpToPages((capacity != 0 ? capacity : 1) * sizeof(double));
+
+    unsigned char* pages = (unsigned char*) allocatePages(pageSize + cellsSize + pageSize);
+    if (pages == NULL) { return false; }
+
+    if (!protectPages(pages, pageSize, PAGE_ACCESS_NONE) || !protectPages(pages + pageSize + cellsSize, pageSize, PAGE_ACCESS_NONE))
+    {
+        freePages(pages, pageSize + cellsSize + pageSize);
+        return false;
+    }
+
+    stack->base     = (double*) (pages + pageSize);
+    stack->top      = stack->base;
+    stack->capacity = cellsSize / sizeof(double);
+
+    return true;
+}
+
+void deleteOperandStack(OperandStack* stack)
+{
+    assert(stack != NULL);
+
+    if (stack->base == NULL) { return; }
+
+    size_t pageSize = getPageSize();
+    freePages((unsigned char*) stack->base - pageSize, pageSize + stack->capacity * sizeof(double) + pageSize);
+
+    *stack = {};
+}
+
+// called from a signal handler: if the address is on one of the guard pages, the top is moved
+// back into the cells, it can be one cell off depending on when the faulted instruction stored it
+OperandStackFault getOperandStackFault(OperandStack* stack, const void* faultAddress)
+{
+    assert(stack != NULL);
+
+    if (stack->base == NULL) { return OPERAND_STACK_NO_FAULT; }
+
+    uintptr_t address  = (uintptr_t) faultAddress;
+    uintptr_t start    = (uintptr_t) stack->base;
+    uintptr_t end      = (uintptr_t) (stack->base + stack->capacity);
+    size_t    pageSize = getPageSize();
+
+    if (address < start && address >= start - pageSize)
+    {
+        stack->top = stack->base;
+        return OPERAND_STACK_UNDERFLOW;
+    }
+
+    if (address >= end && address < end + pageSize)
+    {
+        stack->top = stack->base + stack->capacity;
+        return OPERAND_STACK_OVERFLOW;
+    }
+
+    return OPERAND_STACK_NO_FAULT;
+}
+
+// the most cells the stack has held, in whole pages: it isn't tracked by push, the pages of the cells
+// are committed on the first touch, so the last committed page is as high as the stack has been;
+// can be called from another thread while the CPU runs
+size_t getOperandStackPeak(const OperandStack* stack)
+{
+    assert(stack != NULL);
+
+    if (stack->base == NULL) { return 0; }
+
+    return getTouchedSize(stack->base, stack->capacity * sizeof(double)) / sizeof(double);
+}
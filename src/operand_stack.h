@@ -0,0 +1,49 @@
+#pragma once
+#include <stddef.h>
+#include <atomic>
+
+// The operand stack of the CPU: a fixed number of cells between two guard pages which can't be
+// accessed at all. Push and pop don't check the size, an overflow or an underflow touches a guard
+// page instead, and the CPU turns the fault into an error (see handleCpuFault in cpu.cpp).
+
+static const size_t OPERAND_STACK_DEFAULT_CAPACITY = 1 << 20;
+
+enum OperandStackFault
+{
+    OPERAND_STACK_NO_FAULT,
+    OPERAND_STACK_UNDERFLOW,
+    OPERAND_STACK_OVERFLOW
+};
+
+struct OperandStack
+{
+    double* base     = NULL; // the lower guard page is right below
+    double* top      = NULL; // next free cell
+    size_t  capacity = 0;    // rounded up to whole pages, the upper guard page is right after the last cell
+};
+
+bool              newOperandStack      (OperandStack* stack, size_t capacity);
+void              deleteOperandStack   (OperandStack* stack);
+OperandStackFault getOperandStackFault (OperandStack* stack, const void* faultAddress);
+size_t            getOperandStackPeak  (const OperandStack* stack);
+
+// the fences only keep the compiler from moving the accesses after them (e.g. of pc) before a
+// possible fault, they are not instructions
+inline void operandStackPush(OperandStack* stack, double value)
+{
+    *stack->top++ = value;
+    std::atomic_signal_fence(std::memory_order_seq_cst);
+}
+
+inline double operandStackPop(OperandStack* stack)
+{
+    double value = *--stack->top;
+    std::atomic_signal_fence(std::memory_order_seq_cst);
+
+    return value;
+}
+
+inline size_t getOperandStackSize(const OperandStack* stack)
+{
+    return (size_t) (stack->top - stack->base);
+}
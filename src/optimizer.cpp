@@ -0,0 +1,566 @@
+#include <assert.h>
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "optimizer.h"
+#include "bytecode.h"
+#include "instructions.h"
+
+static const size_t OPTIMIZER_MAX_INSTRUCTION_LENGTH = 32;
+static const size_t OPTIMIZER_MAX_PASSES             = 16;
+static const size_t OPTIMIZER_MAX_JUMP_HOPS          = 16;
+static const size_t NO_TARGET                        = (size_t) -1;
+
+static_assert(getMaxInstructionLength(true) <= OPTIMIZER_MAX_INSTRUCTION_LENGTH, "the longest instruction doesn't fit");
+
+struct OptimizedInstruction
+{
+    unsigned char bytes[OPTIMIZER_MAX_INSTRUCTION_LENGTH] = {};
+    size_t        length     = 0;
+    size_t        offset     = 0;         // in the original code
+    size_t        target     = NO_TARGET; // index of the label for jumps and calls
+    char*         importName = NULL;      // label of another module, the jump can't be changed then
+    size_t        lineNumber = 0;         // of the label reference
+    bool          isRemoved  = false;
+    bool          isTarget   = false;     // some jump leads here, so it can't be merged with the previous instruction
+};
+
+struct Optimizer
+{
+    OptimizedInstruction* instructions = NULL;
+    size_t                count        = 0;
+    size_t*               labelTargets = NULL; // index of the instruction each label is defined at
+    size_t                labelsCount  = 0;
+    bool*                 isExported   = NULL; // labels other modules can jump to
+    OptimizerStats*       stats        = NULL;
+};
+
+bool   decodeInstructions  (Optimizer* optimizer, const unsigned char* code, size_t codeSize,
+                            LabelTable* labels, LabelTable* exports, const Fixup* fixups, size_t fixupsCount);
+size_t encodeInstructions  (Optimizer* optimizer, unsigned char* code, LabelTable* labels,
+                            Fixup* fixups, size_t* fixupsCount);
+void   finishOptimizer     (Optimizer* optimizer);
+size_t nextAlive           (const Optimizer* optimizer, size_t index);
+size_t getLabelInstruction (const Optimizer* optimizer, size_t label);
+void   markJumpTargets     (Optimizer* optimizer);
+void   removeInstruction   (Optimizer* optimizer, size_t index);
+bool   threadJumps         (Optimizer* optimizer);
+bool   removeJumpsToNext   (Optimizer* optimizer);
+bool   removeDeadCode      (Optimizer* optimizer);
+bool   foldConstants       (Optimizer* optimizer);
+bool   reduceOperations    (Optimizer* optimizer);
+bool   removePushPopPairs  (Optimizer* optimizer);
+bool   foldUnary           (unsigned char opcode, double operand, double* result);
+bool   foldBinary          (unsigned char opcode, double operand1, double operand2, double* result);
+bool   isPushConst         (const OptimizedInstruction* instruction, double* value);
+void   setPushConst        (OptimizedInstruction* instruction, double value);
+bool   isTerminal          (const OptimizedInstruction* instruction);
+
+bool optimizeBytecode(unsigned char* code, size_t* codeSize, LabelTable* labels, LabelTable* exports,
+                      Fixup* fixups, size_t* fixupsCount, OptimizerStats* stats)
+{
+    assert(code        != NULL);
+    assert(codeSize    != NULL);
+    assert(labels      != NULL);
+    assert(fixupsCount != NULL);
+    assert(stats       != NULL);
+
+    Optimizer optimizer = {};
+    optimizer.stats     = stats;
+
+    if (!decodeInstructions(&optimizer, code, *codeSize, labels, exports, fixups, *fixupsCount))
+    {
+        finishOptimizer(&optimizer);
+        return false;
+    }
+
+    *stats = {};
+    stats->instructionsBefore = optimizer.count;
+
+    for (size_t pass = 0; pass < OPTIMIZER_MAX_PASSES; pass++)
+    {
+        markJumpTargets(&optimizer);
+
+        bool isChanged = false;
+        isChanged |= threadJumps        (&optimizer);
+        isChanged |= removeJumpsToNext  (&optimizer);
+        isChanged |= removeDeadCode     (&optimizer);
+        isChanged |= foldConstants      (&optimizer);
+        isChanged |= reduceOperations   (&optimizer);
+        isChanged |= removePushPopPairs (&optimizer);
+
+        if (!isChanged) { break; }
+    }
+
+    *codeSize = encodeInstructions(&optimizer, code, labels, fixups, fixupsCount);
+
+    finishOptimizer(&optimizer);
+
+    return true;
+}
+
+void printOptimizerStats(FILE* stream, const OptimizerStats* stats)
+{
+    assert(stream != NULL);
+    assert(stats  != NULL);
+
+    size_t removed = stats->instructionsBefore - stats->instructionsAfter;
+
+    fprintf(stream, "Optimized: %zu -> %zu instructions (-%zu, %.1lf%%)\n",
+                    stats->instructionsBefore, stats->instructionsAfter, removed,
+                    stats->instructionsBefore == 0 ? 0 : 100.0 * removed / stats->instructionsBefore);
+
+    fprintf(stream, "    constants folded:          %zu\n", stats->foldedConstants);
+    fprintf(stream, "    push/pop pairs removed:    %zu\n", stats->removedPushPopPairs);
+    fprintf(stream, "    jumps threaded:            %zu\n", stats->threadedJumps);
+    fprintf(stream, "    jumps to next removed:     %zu\n", stats->removedJumpsToNext);
+    fprintf(stream, "    dead instructions removed: %zu\n", stats->removedDeadInstructions);
+    fprintf(stream, "    operations reduced:        %zu\n", stats->reducedOperations);
+    fprintf(stream, "    divisions replaced:        %zu\n", stats->replacedDivisions);
+}
+
+// every jump and call has to refer to a label through a fixup, otherwise its target can't be moved
+bool decodeInstructions(Optimizer* optimizer, const unsigned char* code, size_t codeSize,
+                        LabelTable* labels, LabelTable* exports, const Fixup* fixups, size_t fixupsCount)
+{
+    assert(optimizer != NULL);
+    assert(code      != NULL);
+    assert(labels    != NULL);
+
+    for (size_t offset = 0; offset < codeSize; optimizer->count++)
+    {
+        size_t length = getWideInstructionLength(code + offset, codeSize - offset);
+        if (length == 0 || length > OPTIMIZER_MAX_INSTRUCTION_LENGTH) { return false; }
+
+        offset += length;
+    }
+
+    optimizer->instructions = (OptimizedInstruction*) calloc(optimizer->count + 1, sizeof(OptimizedInstruction));
+    optimizer->labelTargets = (size_t*)               calloc(labels->count + 1,    sizeof(size_t));
+    optimizer->isExported   = (bool*)                 calloc(labels->count + 1,    sizeof(bool));
+    optimizer->labelsCount  = labels->count;
+    if (optimizer->instructions == NULL || optimizer->labelTargets == NULL || optimizer->isExported == NULL) { return false; }
+
+    size_t offset    = 0;
+    size_t currFixup = 0;
+    for (size_t i = 0; i < optimizer->count; i++)
+    {
+        OptimizedInstruction* instruction = &optimizer->instructions[i];
+        *instruction = {};
+
+        instruction->length = getWideInstructionLength(code + offset, codeSize - offset);
+        instruction->offset = offset;
+        memcpy(instruction->bytes, code + offset, instruction->length);
+
+        // the target is the last argument
+        if (isControlFlowInstruction(code[offset]))
+        {
+            if (currFixup == fixupsCount || fixups[currFixup].offset != offset + instruction->length - sizeof(double)) { return false; }
+
+            Label* label = findLabel(labels, fixups[currFixup].labelName);
+            if (label != NULL) { instruction->target     = (size_t) (label - labels->labels); }
+            else               { instruction->importName = fixups[currFixup].labelName;       }
+
+            instruction->lineNumber = fixups[currFixup].lineNumber;
+            currFixup++;
+        }
+
+        offset += instruction->length;
+    }
+
+    if (currFixup != fixupsCount) { return false; }
+
+    // the end of the code, labels defined after the last instruction point here
+    optimizer->instructions[optimizer->count]        = {};
+    optimizer->instructions[optimizer->count].offset = codeSize;
+
+    // labels are defined in the order of offsets
+    size_t currInstruction = 0;
+    for (size_t i = 0; i < labels->count; i++)
+    {
+        size_t labelOffset = (size_t) labels->labels[i].value;
+        while (currInstruction < optimizer->count && optimizer->instructions[currInstruction].offset < labelOffset)
+        {
+            currInstruction++;
+        }
+
+        if (currInstruction < optimizer->count && optimizer->instructions[currInstruction].offset != labelOffset) { return false; }
+        if (currInstruction == optimizer->count && labelOffset != codeSize)                                       { return false; }
+
+        optimizer->labelTargets[i] = currInstruction;
+        optimizer->isExported[i]   = exports != NULL && findLabel(exports, labels->labels[i].name) != NULL;
+    }
+
+    return true;
+}
+
+// labels of removed instructions now point to the next remaining one
+size_t encodeInstructions(Optimizer* optimizer, unsigned char* code, LabelTable* labels,
+                          Fixup* fixups, size_t* fixupsCount)
+{
+    assert(optimizer   != NULL);
+    assert(code        != NULL);
+    assert(labels      != NULL);
+    assert(fixupsCount != NULL);
+
+    *fixupsCount = 0;
+
+    size_t offset = 0;
+    for (size_t i = 0; i < optimizer->count; i++)
+    {
+        OptimizedInstruction* instruction = &optimizer->instructions[i];
+
+        instruction->offset = offset;
+        if (instruction->isRemoved) { continue; }
+
+        memcpy(code + offset, instruction->bytes, instruction->length);
+        offset += instruction->length;
+        optimizer->stats->instructionsAfter++;
+
+        if (instruction->target != NO_TARGET || instruction->importName != NULL)
+        {
+            Fixup* fixup = &fixups[(*fixupsCount)++];
+            fixup->offset     = instruction->offset + instruction->length - sizeof(double);
+            fixup->labelName  = instruction->target != NO_TARGET ? labels->labels[instruction->target].name : instruction->importName;
+            fixup->lineNumber = instruction->lineNumber;
+        }
+    }
+
+    optimizer->instructions[optimizer->count].offset = offset;
+
+    for (size_t i = 0; i < labels->count; i++)
+    {
+        labels->labels[i].value = (double) optimizer->instructions[optimizer->labelTargets[i]].offset;
+    }
+
+    return offset;
+}
+
+void finishOptimizer(Optimizer* optimizer)
+{
+    assert(optimizer != NULL);
+
+    free(optimizer->instructions);
+    free(optimizer->labelTargets);
+    free(optimizer->isExported);
+
+    *optimizer = {};
+}
+
+// returns the first remaining instruction starting from index or count if there is none
+size_t nextAlive(const Optimizer* optimizer, size_t index)
+{
+    assert(optimizer != NULL);
+
+    while (index < optimizer->count && optimizer->instructions[index].isRemoved) { index++; }
+
+    return index;
+}
+
+size_t getLabelInstruction(const Optimizer* optimizer, size_t label)
+{
+    assert(optimizer != NULL);
+    assert(label     <  optimizer->labelsCount);
+
+    return nextAlive(optimizer, optimizer->labelTargets[label]);
+}
+
+void markJumpTargets(Optimizer* optimizer)
+{
+    assert(optimizer != NULL);
+
+    for (size_t i = 0; i < optimizer->count; i++)
+    {
+        optimizer->instructions[i].isTarget = false;
+    }
+
+    for (size_t i = nextAlive(optimizer, 0); i < optimizer->count; i = nextAlive(optimizer, i + 1))
+    {
+        if (optimizer->instructions[i].target == NO_TARGET) { continue; }
+
+        optimizer->instructions[getLabelInstruction(optimizer, optimizer->instructions[i].target)].isTarget = true;
+    }
+
+    // exported labels are reached from other modules, after the linker resolves their calls
+    for (size_t i = 0; i < optimizer->labelsCount; i++)
+    {
+        if (optimizer->isExported[i]) { optimizer->instructions[getLabelInstruction(optimizer, i)].isTarget = true; }
+    }
+}
+
+// jumps to a removed instruction now lead to the next one, so it becomes a target instead
+void removeInstruction(Optimizer* optimizer, size_t index)
+{
+    assert(optimizer != NULL);
+    assert(index     <  optimizer->count);
+
+    optimizer->instructions[index].isRemoved = true;
+
+    if (optimizer->instructions[index].isTarget)
+    {
+        optimizer->instructions[nextAlive(optimizer, index + 1)].isTarget = true;
+    }
+}
+
+// jmp :a ... a: jmp :b  ->  jmp :b ... a: jmp :b
+bool threadJumps(Optimizer* optimizer)
+{
+    assert(optimizer != NULL);
+
+    bool isChanged = false;
+    for (size_t i = nextAlive(optimizer, 0); i < optimizer->count; i = nextAlive(optimizer, i + 1))
+    {
+        OptimizedInstruction* instruction = &optimizer->instructions[i];
+        if (instruction->target == NO_TARGET) { continue; }
+
+        size_t target = instruction->target;
+        for (size_t hop = 0; hop < OPTIMIZER_MAX_JUMP_HOPS; hop++)
+        {
+            const OptimizedInstruction* destination = &optimizer->instructions[getLabelInstruction(optimizer, target)];
+            if (destination->bytes[0] != CPU_CMD_jmp || destination->target == NO_TARGET || destination->target == target) { break; }
+
+            target = destination->target;
+        }
+
+        if (target != instruction->target)
+        {
+            instruction->target = target;
+            optimizer->instructions[getLabelInstruction(optimizer, target)].isTarget = true;
+            optimizer->stats->threadedJumps++;
+            isChanged = true;
+        }
+    }
+
+    return isChanged;
+}
+
+bool removeJumpsToNext(Optimizer* optimizer)
+{
+    assert(optimizer != NULL);
+
+    bool isChanged = false;
+    for (size_t i = nextAlive(optimizer, 0); i < optimizer->count; i = nextAlive(optimizer, i + 1))
+    {
+        OptimizedInstruction* instruction = &optimizer->instructions[i];
+        if (instruction->bytes[0] != CPU_CMD_jmp || instruction->target == NO_TARGET) { continue; }
+
+        if (getLabelInstruction(optimizer, instruction->target) == nextAlive(optimizer, i + 1))
+        {
+            removeInstruction(optimizer, i);
+            optimizer->stats->removedJumpsToNext++;
+            isChanged = true;
+        }
+    }
+
+    return isChanged;
+}
+
+// nothing falls through jmp, ret and hlt, so the code after them up to the next jump target is unreachable
+bool removeDeadCode(Optimizer* optimizer)
+{
+    assert(optimizer != NULL);
+
+    bool isChanged = false;
+    for (size_t i = nextAlive(optimizer, 0); i < optimizer->count; i = nextAlive(optimizer, i + 1))
+    {
+        if (!isTerminal(&optimizer->instructions[i])) { continue; }
+
+        size_t next = nextAlive(optimizer, i + 1);
+        while (next < optimizer->count && !optimizer->instructions[next].isTarget)
+        {
+            removeInstruction(optimizer, next);
+            optimizer->stats->removedDeadInstructions++;
+            isChanged = true;
+
+            next = nextAlive(optimizer, next + 1);
+        }
+    }
+
+    return isChanged;
+}
+
+// push 2, push 3, mul -> push 6; push 4, sqrt -> push 2
+bool foldConstants(Optimizer* optimizer)
+{
+    assert(optimizer != NULL);
+
+    bool isChanged = false;
+    for (size_t i = nextAlive(optimizer, 0); i < optimizer->count; i = nextAlive(optimizer, i + 1))
+    {
+        OptimizedInstruction* first = &optimizer->instructions[i];
+
+        double operand1 = 0;
+        if (!isPushConst(first, &operand1)) { continue; }
+
+        size_t second = nextAlive(optimizer, i + 1);
+        if (second == optimizer->count || optimizer->instructions[second].isTarget) { continue; }
+
+        double result = 0;
+        if (foldUnary(optimizer->instructions[second].bytes[0], operand1, &result))
+        {
+            setPushConst(first, result);
+            removeInstruction(optimizer, second);
+            optimizer->stats->foldedConstants++;
+            isChanged = true;
+            continue;
+        }
+
+        double operand2 = 0;
+        if (!isPushConst(&optimizer->instructions[second], &operand2)) { continue; }
+
+        size_t third = nextAlive(optimizer, second + 1);
+        if (third == optimizer->count || optimizer->instructions[third].isTarget) { continue; }
+
+        if (foldBinary(optimizer->instructions[third].bytes[0], operand1, operand2, &result))
+        {
+            setPushConst(first, result);
+            removeInstruction(optimizer, second);
+            removeInstruction(optimizer, third);
+            optimizer->stats->foldedConstants++;
+            isChanged = true;
+        }
+    }
+
+    return isChanged;
+}
+
+// push 1, mul / push 1, div / push 0, sub are removed; division by a power of two becomes
+// multiplication by its reciprocal, which gives exactly the same result
+bool reduceOperations(Optimizer* optimizer)
+{
+    assert(optimizer != NULL);
+
+    bool isChanged = false;
+    for (size_t i = nextAlive(optimizer, 0); i < optimizer->count; i = nextAlive(optimizer, i + 1))
+    {
+        OptimizedInstruction* push = &optimizer->instructions[i];
+
+        double operand = 0;
+        if (!isPushConst(push, &operand)) { continue; }
+
+        size_t next = nextAlive(optimizer, i + 1);
+        if (next == optimizer->count || optimizer->instructions[next].isTarget) { continue; }
+
+        OptimizedInstruction* operation = &optimizer->instructions[next];
+        unsigned char         opcode    = operation->bytes[0];
+
+        if ((operand == 1 && (opcode == CPU_CMD_mul || opcode == CPU_CMD_div)) ||
+            (operand == 0 &&  opcode == CPU_CMD_sub))
+        {
+            removeInstruction(optimizer, i);
+            removeInstruction(optimizer, next);
+            optimizer->stats->reducedOperations++;
+            isChanged = true;
+            continue;
+        }
+
+        // the reciprocal of a power of two is exact, it's only used when its immediate isn't wider
+        // than the divisor (push 0.5, div -> push 2, mul), otherwise the compact code would grow
+        int exponent = 0;
+        if (opcode == CPU_CMD_div && operand != 0 && fabs(frexp(operand, &exponent)) == 0.5)
+        {
+            double reciprocal = 1 / operand;
+            if (!isfinite(reciprocal) || reciprocal * operand != 1)        { continue; }
+            if (getImmediateKind(reciprocal) > getImmediateKind(operand)) { continue; }
+
+            setPushConst(push, reciprocal);
+            operation->bytes[0] = CPU_CMD_mul;
+            optimizer->stats->replacedDivisions++;
+            isChanged = true;
+        }
+    }
+
+    return isChanged;
+}
+
+// push rax, pop rax
+bool removePushPopPairs(Optimizer* optimizer)
+{
+    assert(optimizer != NULL);
+
+    bool isChanged = false;
+    for (size_t i = nextAlive(optimizer, 0); i < optimizer->count; i = nextAlive(optimizer, i + 1))
+    {
+        const OptimizedInstruction* push = &optimizer->instructions[i];
+        if (push->bytes[0] != CPU_CMD_push || push->bytes[1] != CPU_ARGUMENT_TYPE_REG) { continue; }
+
+        size_t next = nextAlive(optimizer, i + 1);
+        if (next == optimizer->count || optimizer->instructions[next].isTarget) { continue; }
+
+        const OptimizedInstruction* pop = &optimizer->instructions[next];
+        if (pop->bytes[0] != CPU_CMD_pop || pop->bytes[1] != CPU_ARGUMENT_TYPE_REG || pop->bytes[2] != push->bytes[2]) { continue; }
+
+        removeInstruction(optimizer, i);
+        removeInstruction(optimizer, next);
+        optimizer->stats->removedPushPopPairs++;
+        isChanged = true;
+    }
+
+    return isChanged;
+}
+
+// operations which would stop the CPU with an error (e.g. sqrt of a negative number) aren't folded
+bool foldUnary(unsigned char opcode, double operand, double* result)
+{
+    assert(result != NULL);
+
+    switch (opcode)
+    {
+        case CPU_CMD_sin:  { *result = sin(operand);   return true; }
+        case CPU_CMD_cos:  { *result = cos(operand);   return true; }
+        case CPU_CMD_abs:  { *result = fabs(operand);  return true; }
+        case CPU_CMD_flr:  { *result = floor(operand); return true; }
+        case CPU_CMD_sqrt: { if (operand < 0) { return false; } *result = sqrt(operand); return true; }
+
+        default: { return false; }
+    }
+}
+
+bool foldBinary(unsigned char opcode, double operand1, double operand2, double* result)
+{
+    assert(result != NULL);
+
+    switch (opcode)
+    {
+        case CPU_CMD_add: { *result = operand1 + operand2;     return true; }
+        case CPU_CMD_sub: { *result = operand1 - operand2;     return true; }
+        case CPU_CMD_mul: { *result = operand1 * operand2;     return true; }
+        case CPU_CMD_pow: { *result = pow(operand1, operand2); return true; }
+        case CPU_CMD_div: { if (operand2 == 0) { return false; } *result = operand1 / operand2; return true; }
+
+        default: { return false; }
+    }
+}
+
+bool isPushConst(const OptimizedInstruction* instruction, double* value)
+{
+    assert(instruction != NULL);
+    assert(value       != NULL);
+
+    if (instruction->bytes[0] != CPU_CMD_push || instruction->bytes[1] != CPU_ARGUMENT_TYPE_CST) { return false; }
+
+    memcpy(value, &instruction->bytes[2], sizeof(double));
+
+    return true;
+}
+
+void setPushConst(OptimizedInstruction* instruction, double value)
+{
+    assert(instruction != NULL);
+
+    instruction->bytes[0] = CPU_CMD_push;
+    instruction->bytes[1] = CPU_ARGUMENT_TYPE_CST;
+    memcpy(&instruction->bytes[2], &value, sizeof(double));
+    instruction->length   = 2 + sizeof(double);
+}
+
+bool isTerminal(const OptimizedInstruction* instruction)
+{
+    assert(instruction != NULL);
+
+    unsigned char opcode = instruction->bytes[0];
+
+    return opcode == CPU_CMD_jmp || opcode == CPU_CMD_ret || opcode == CPU_CMD_hlt;
+}
@@ -0,0 +1,29 @@
+#pragma once
+#include <stddef.h>
+#include <stdio.h>
+#include "label_table.h"
+
+// Peephole optimizer of the assembler (asm+ -O). It works on the emitted bytecode before the
+// fixups are resolved: every jump refers to a label, so instructions can be removed and
+// replaced, and the labels and fixups are moved along with the instructions they point to.
+// Jumps to labels of other modules (in object files) are kept as they are, and the code at
+// exported labels is never removed as unreachable.
+
+struct OptimizerStats
+{
+    size_t instructionsBefore      = 0;
+    size_t instructionsAfter       = 0;
+    size_t foldedConstants         = 0; // push c1, push c2, add -> push c1 + c2
+    size_t removedPushPopPairs     = 0; // push rax, pop rax
+    size_t threadedJumps           = 0; // jumps to a jmp retargeted to its destination
+    size_t removedJumpsToNext      = 0;
+    size_t removedDeadInstructions = 0; // unreachable after jmp, ret or hlt
+    size_t reducedOperations       = 0; // push 1, mul and push 0, sub removed
+    size_t replacedDivisions       = 0; // push 0.5, div -> push 2, mul
+};
+
+// returns false if the code can't be optimized (e.g. there is a jump to a numeric offset),
+// the code is left as it is then; exports (NULL if there are none) are kept as entry points
+bool optimizeBytecode    (unsigned char* code, size_t* codeSize, LabelTable* labels, LabelTable* exports,
+                          Fixup* fixups, size_t* fixupsCount, OptimizerStats* stats);
+void printOptimizerStats (FILE* stream, const OptimizerStats* stats);
@@ -0,0 +1,90 @@
+#include <assert.h>
+#include <stdint.h>
+#include <sys/mman.h>
+#include <unistd.h>
+
+#include "pages.h"
+
+static const size_t PAGES_RESIDENCY_CHUNK = 256;
+
+size_t getPageSize()
+{
+    static size_t pageSize = (size_t) sysconf(_SC_PAGESIZE);
+
+    return pageSize;
+}
+
+size_t roundUpToPages(size_t size)
+{
+    size_t pageSize = getPageSize();
+
+    return (size + pageSize - 1) / pageSize * pageSize;
+}
+
+// returns zeroed pages or NULL
+void* allocatePages(size_t size)
+{
+    void* pages = mmap(NULL, roundUpToPages(size), PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+
+    return pages == MAP_FAILED ? NULL : pages;
+}
+
+// same as allocatePages, but no memory is set aside for the pages until they are touched, so that
+// large regions can be reserved even if there isn't as much memory; freed with freePages too
+void* reservePages(size_t size)
+{
+    void* pages = mmap(NULL, roundUpToPages(size), PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0);
+
+    return pages == MAP_FAILED ? NULL : pages;
+}
+
+void freePages(void* pages, size_t size)
+{
+    if (pages == NULL) { return; }
+
+    munmap(pages, roundUpToPages(size));
+}
+
+// protects all the pages which contain at least one byte of [pages, pages + size)
+bool protectPages(void* pages, size_t size, PageAccess access)
+{
+    assert(pages != NULL);
+
+    uintptr_t start = (uintptr_t) pages / getPageSize() * getPageSize();
+    uintptr_t end   = roundUpToPages((uintptr_t) pages + size);
+
+    int protection = PROT_NONE;
+    if (access == PAGE_ACCESS_READ)       { protection = PROT_READ;              }
+    if (access == PAGE_ACCESS_READ_WRITE) { protection = PROT_READ | PROT_WRITE; }
+
+    return mprotect((void*) start, end - start, protection) == 0;
+}
+
+// the size of [pages, pages + size) up to the end of the last page in memory; pages are put in
+// memory when they are first touched, so it's how far the region has been used, pages swapped out
+// are missed
+size_t getTouchedSize(const void* pages, size_t size)
+{
+    assert(pages != NULL);
+
+    size_t pageSize   = getPageSize();
+    size_t pagesCount = roundUpToPages(size) / pageSize;
+
+    unsigned char residency[PAGES_RESIDENCY_CHUNK] = {};
+    while (pagesCount != 0)
+    {
+        size_t chunk = pagesCount < PAGES_RESIDENCY_CHUNK ? pagesCount : PAGES_RESIDENCY_CHUNK;
+        size_t first = pagesCount - chunk;
+
+        if (mincore((unsigned char*) pages + first * pageSize, chunk * pageSize, residency) != 0) { return 0; }
+
+        for (size_t i = chunk; i > 0; i--)
+        {
+            if (residency[i - 1] & 1) { return (first + i) * pageSize < size ? (first + i) * pageSize : size; }
+        }
+
+        pagesCount = first;
+    }
+
+    return 0;
+}
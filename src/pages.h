@@ -0,0 +1,19 @@
+#pragma once
+#include <stddef.h>
+
+// page granular host memory, which can be protected, e.g. to catch accesses to watched RAM cells
+
+enum PageAccess
+{
+    PAGE_ACCESS_NONE,
+    PAGE_ACCESS_READ,
+    PAGE_ACCESS_READ_WRITE
+};
+
+size_t getPageSize     ();
+size_t roundUpToPages  (size_t size);
+void*  allocatePages   (size_t size);
+void*  reservePages    (size_t size);
+void   freePages       (void* pages, size_t size);
+bool   protectPages    (void* pages, size_t size, PageAccess access);
+size_t getTouchedSize  (const void* pages, size_t size);
@@ -0,0 +1,365 @@
+#include <assert.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <chrono>
+
+#include "profiler.h"
+
+static const size_t PROFILER_MAX_HOT_SPOTS    = 64;
+static const size_t PROFILER_DEFAULT_CAPACITY = 64;
+static const char*  PROFILER_ROOT_NAME        = "[program]";
+
+static const Profiler* sortedProfiler = NULL; // qsort comparators have no context parameter
+
+int         compareOpcodesByTime                  (const void* first, const void* second);
+int         comparePcsByTime                      (const void* first, const void* second);
+int         compareTargetsByInclusiveInstructions (const void* first, const void* second);
+bool        expandArray                           (void** array, size_t* capacity, size_t elemSize);
+size_t      getChildNode                          (Profiler* profiler, size_t parent, size_t target);
+const char* getTargetName                         (Profiler* profiler, size_t target, char* buffer, size_t bufferSize);
+
+Profiler* newProfiler(const char* program, size_t programBytes, const SymbolTable* symbols)
+{
+    assert(program != NULL);
+
+    Profiler* profiler = (Profiler*) calloc(1, sizeof(Profiler));
+    if (profiler == NULL) { return NULL; }
+
+    profiler->program      = (const unsigned char*) program;
+    profiler->programBytes = programBytes;
+    profiler->symbols      = symbols;
+
+    profiler->pcs            = (PcProfile*)         calloc(programBytes,              sizeof(PcProfile));
+    profiler->targets        = (CallTargetProfile*) calloc(programBytes,              sizeof(CallTargetProfile));
+    profiler->nodes          = (CallNode*)          calloc(PROFILER_DEFAULT_CAPACITY, sizeof(CallNode));
+    profiler->frames         = (CallFrame*)         calloc(PROFILER_DEFAULT_CAPACITY, sizeof(CallFrame));
+    profiler->nodesCapacity  = PROFILER_DEFAULT_CAPACITY;
+    profiler->framesCapacity = PROFILER_DEFAULT_CAPACITY;
+
+    if (profiler->pcs == NULL || profiler->targets == NULL || profiler->nodes == NULL || profiler->frames == NULL)
+    {
+        deleteProfiler(profiler);
+        return NULL;
+    }
+
+    // root of the call tree is the program itself
+    profiler->nodes[0] = {};
+    profiler->nodesCount  = 1;
+    profiler->frames[0] = {};
+    profiler->framesCount = 1;
+    profiler->currentNode = 0;
+
+    return profiler;
+}
+
+void deleteProfiler(Profiler* profiler)
+{
+    if (profiler == NULL) { return; }
+
+    free(profiler->pcs);
+    free(profiler->targets);
+    free(profiler->nodes);
+    free(profiler->frames);
+    free(profiler);
+}
+
+uint64_t getHostTimeNs()
+{
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(
+               std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+void profilerApplyCallEvent(Profiler* profiler)
+{
+    assert(profiler != NULL);
+
+    ProfilerCallEvent event = profiler->pendingEvent;
+    profiler->pendingEvent = PROFILER_EVENT_NONE;
+
+    if (event == PROFILER_EVENT_CALL)
+    {
+        size_t target = profiler->pendingTarget;
+        if (target >= profiler->programBytes) { return; }
+
+        size_t child = getChildNode(profiler, profiler->currentNode, target);
+        if (child == PROFILER_NO_NODE) { return; }
+
+        if (profiler->framesCount == profiler->framesCapacity &&
+            !expandArray((void**) &profiler->frames, &profiler->framesCapacity, sizeof(CallFrame)))
+        {
+            return;
+        }
+
+        CallFrame* frame = &profiler->frames[profiler->framesCount++];
+        frame->node              = child;
+        frame->startInstructions = profiler->totalInstructions;
+        frame->startNs           = profiler->totalNs;
+
+        profiler->targets[target].calls++;
+        profiler->targets[target].activeFrames++;
+        profiler->currentNode = child;
+    }
+    else if (event == PROFILER_EVENT_RET)
+    {
+        // ret without a matching call leaves the shadow stack at the root
+        if (profiler->framesCount <= 1) { return; }
+
+        CallFrame*         frame  = &profiler->frames[--profiler->framesCount];
+        CallTargetProfile* target = &profiler->targets[profiler->nodes[frame->node].target];
+
+        target->activeFrames--;
+        if (target->activeFrames == 0)
+        {
+            target->inclusiveInstructions += profiler->totalInstructions - frame->startInstructions;
+            target->inclusiveNs           += profiler->totalNs           - frame->startNs;
+        }
+
+        profiler->currentNode = profiler->nodes[frame->node].parent;
+    }
+}
+
+bool writeProfileReport(Profiler* profiler, const char* reportFileName)
+{
+    assert(profiler       != NULL);
+    assert(reportFileName != NULL);
+
+    FILE* reportFile = fopen(reportFileName, "w");
+    if (reportFile == NULL) { printf("Couldn't open profile report file '%s'.\n", reportFileName); return false; }
+
+    uint64_t totalCount = 0;
+    uint64_t totalNs    = 0;
+    for (size_t i = 0; i < CPU_COMMANDS_COUNT; i++)
+    {
+        totalCount += profiler->opcodes[i].count;
+        totalNs    += profiler->opcodes[i].nanoseconds;
+    }
+
+    sortedProfiler = profiler;
+
+    size_t opcodesOrder[CPU_COMMANDS_COUNT] = {};
+    for (size_t i = 0; i < CPU_COMMANDS_COUNT; i++) { opcodesOrder[i] = i; }
+    qsort(opcodesOrder, CPU_COMMANDS_COUNT, sizeof(size_t), compareOpcodesByTime);
+
+    size_t  pcsCount  = 0;
+    size_t* pcsOrder  = (size_t*) calloc(profiler->programBytes, sizeof(size_t));
+    if (pcsOrder == NULL) { fclose(reportFile); return false; }
+
+    for (size_t pc = 0; pc < profiler->programBytes; pc++)
+    {
+        if (profiler->pcs[pc].count != 0) { pcsOrder[pcsCount++] = pc; }
+    }
+    qsort(pcsOrder, pcsCount, sizeof(size_t), comparePcsByTime);
+
+    fprintf(reportFile, "Profile: %llu instructions executed, %.3lf ms of host time\n\n",
+            (unsigned long long) totalCount, totalNs / 1e6);
+
+    fprintf(reportFile, "Opcodes (sorted by host time)\n"
+                        "%-8s %14s %14s %10s %8s\n", "opcode", "count", "total ns", "ns/instr", "time %");
+
+    for (size_t i = 0; i < CPU_COMMANDS_COUNT; i++)
+    {
+        const OpcodeProfile* opcode = &profiler->opcodes[opcodesOrder[i]];
+        if (opcode->count == 0) { continue; }
+
+        fprintf(reportFile, "%-8s %14llu %14llu %10.1lf %7.2lf%%\n",
+                getInstructionName(opcodesOrder[i]),
+                (unsigned long long) opcode->count,
+                (unsigned long long) opcode->nanoseconds,
+                (double) opcode->nanoseconds / opcode->count,
+                totalNs == 0 ? 0 : 100.0 * opcode->nanoseconds / totalNs);
+    }
+
+    fprintf(reportFile, "\nHot spots (sorted by host time)\n"
+                        "%-8s %14s %14s %8s %12s %12s   %s\n",
+                        "offset", "count", "total ns", "time %", "taken", "not taken", "instruction");
+
+    char instruction[MAX_INSTRUCTION_STR_LENGTH] = {};
+    for (size_t i = 0; i < pcsCount && i < PROFILER_MAX_HOT_SPOTS; i++)
+    {
+        size_t           pc        = pcsOrder[i];
+        const PcProfile* pcProfile = &profiler->pcs[pc];
+
+        formatInstruction(instruction, MAX_INSTRUCTION_STR_LENGTH, &profiler->program[pc], profiler->programBytes - pc);
+
+        fprintf(reportFile, "%.8lu %14llu %14llu %7.2lf%% ",
+                pc,
+                (unsigned long long) pcProfile->count,
+                (unsigned long long) pcProfile->nanoseconds,
+                totalNs == 0 ? 0 : 100.0 * pcProfile->nanoseconds / totalNs);
+
+        if (isControlFlowInstruction(profiler->program[pc]))
+            fprintf(reportFile, "%12llu %12llu", (unsigned long long) pcProfile->taken, (unsigned long long) pcProfile->notTaken);
+        else
+            fprintf(reportFile, "%12s %12s", "-", "-");
+
+        fprintf(reportFile, "   %s\n", instruction);
+    }
+
+    free(pcsOrder);
+
+    // exclusive statistics are gathered from the call tree
+    for (size_t i = 0; i < profiler->programBytes; i++)
+    {
+        profiler->targets[i].exclusiveInstructions = 0;
+        profiler->targets[i].exclusiveNs           = 0;
+    }
+
+    for (size_t i = 1; i < profiler->nodesCount; i++)
+    {
+        profiler->targets[profiler->nodes[i].target].exclusiveInstructions += profiler->nodes[i].selfInstructions;
+        profiler->targets[profiler->nodes[i].target].exclusiveNs           += profiler->nodes[i].selfNs;
+    }
+
+    size_t  targetsCount = 0;
+    size_t* targetsOrder = (size_t*) calloc(profiler->programBytes, sizeof(size_t));
+    if (targetsOrder == NULL) { fclose(reportFile); return false; }
+
+    for (size_t target = 0; target < profiler->programBytes; target++)
+    {
+        if (profiler->targets[target].calls != 0) { targetsOrder[targetsCount++] = target; }
+    }
+    qsort(targetsOrder, targetsCount, sizeof(size_t), compareTargetsByInclusiveInstructions);
+
+    fprintf(reportFile, "\nSubroutines (sorted by inclusive instructions count)\n"
+                        "%-24s %10s %14s %14s %14s %14s\n",
+                        "label", "calls", "incl instrs", "excl instrs", "incl ns", "excl ns");
+
+    char targetName[MAX_INSTRUCTION_STR_LENGTH] = {};
+    for (size_t i = 0; i < targetsCount; i++)
+    {
+        const CallTargetProfile* target = &profiler->targets[targetsOrder[i]];
+
+        fprintf(reportFile, "%-24s %10llu %14llu %14llu %14llu %14llu\n",
+                getTargetName(profiler, targetsOrder[i], targetName, MAX_INSTRUCTION_STR_LENGTH),
+                (unsigned long long) target->calls,
+                (unsigned long long) target->inclusiveInstructions,
+                (unsigned long long) target->exclusiveInstructions,
+                (unsigned long long) target->inclusiveNs,
+                (unsigned long long) target->exclusiveNs);
+    }
+
+    free(targetsOrder);
+    fclose(reportFile);
+
+    return true;
+}
+
+// writes the call tree in the collapsed stacks format ("root;caller;callee count"), weighted by
+// instructions count, which can be fed to flamegraph tools
+bool writeCollapsedStacks(Profiler* profiler, const char* stacksFileName)
+{
+    assert(profiler       != NULL);
+    assert(stacksFileName != NULL);
+
+    FILE* stacksFile = fopen(stacksFileName, "w");
+    if (stacksFile == NULL) { printf("Couldn't open call stacks file '%s'.\n", stacksFileName); return false; }
+
+    size_t* path = (size_t*) calloc(profiler->nodesCount, sizeof(size_t));
+    if (path == NULL) { fclose(stacksFile); return false; }
+
+    char targetName[MAX_INSTRUCTION_STR_LENGTH] = {};
+    for (size_t i = 0; i < profiler->nodesCount; i++)
+    {
+        if (profiler->nodes[i].selfInstructions == 0) { continue; }
+
+        size_t depth = 0;
+        for (size_t node = i; node != PROFILER_NO_NODE; node = profiler->nodes[node].parent)
+        {
+            path[depth++] = node;
+        }
+
+        fprintf(stacksFile, "%s", PROFILER_ROOT_NAME);
+        for (size_t j = depth - 1; j > 0; j--)
+        {
+            fprintf(stacksFile, ";%s", getTargetName(profiler, profiler->nodes[path[j - 1]].target,
+                                                     targetName, MAX_INSTRUCTION_STR_LENGTH));
+        }
+
+        fprintf(stacksFile, " %llu\n", (unsigned long long) profiler->nodes[i].selfInstructions);
+    }
+
+    free(path);
+    fclose(stacksFile);
+
+    return true;
+}
+
+bool expandArray(void** array, size_t* capacity, size_t elemSize)
+{
+    assert(array    != NULL);
+    assert(capacity != NULL);
+
+    void* newArray = realloc(*array, 2 * (*capacity) * elemSize);
+    if (newArray == NULL) { return false; }
+
+    *array     = newArray;
+    *capacity *= 2;
+
+    return true;
+}
+
+// returns child of parent node for calls of target, creates it if it doesn't exist yet
+size_t getChildNode(Profiler* profiler, size_t parent, size_t target)
+{
+    assert(profiler != NULL);
+
+    for (size_t child = profiler->nodes[parent].firstChild; child != PROFILER_NO_NODE; child = profiler->nodes[child].nextSibling)
+    {
+        if (profiler->nodes[child].target == target) { return child; }
+    }
+
+    if (profiler->nodesCount == profiler->nodesCapacity &&
+        !expandArray((void**) &profiler->nodes, &profiler->nodesCapacity, sizeof(CallNode)))
+    {
+        return PROFILER_NO_NODE;
+    }
+
+    size_t    child     = profiler->nodesCount++;
+    CallNode* childNode = &profiler->nodes[child];
+
+    *childNode = {};
+    childNode->target      = target;
+    childNode->parent      = parent;
+    childNode->nextSibling = profiler->nodes[parent].firstChild;
+
+    profiler->nodes[parent].firstChild = child;
+
+    return child;
+}
+
+const char* getTargetName(Profiler* profiler, size_t target, char* buffer, size_t bufferSize)
+{
+    assert(profiler != NULL);
+    assert(buffer   != NULL);
+
+    const char* name = getSymbolName(profiler->symbols, target);
+    if (name != NULL) { return name; }
+
+    snprintf(buffer, bufferSize, "offset_%zu", target);
+    return buffer;
+}
+
+int compareOpcodesByTime(const void* first, const void* second)
+{
+    uint64_t firstNs  = sortedProfiler->opcodes[*(const size_t*) first].nanoseconds;
+    uint64_t secondNs = sortedProfiler->opcodes[*(const size_t*) second].nanoseconds;
+
+    return (firstNs < secondNs) - (firstNs > secondNs);
+}
+
+int comparePcsByTime(const void* first, const void* second)
+{
+    uint64_t firstNs  = sortedProfiler->pcs[*(const size_t*) first].nanoseconds;
+    uint64_t secondNs = sortedProfiler->pcs[*(const size_t*) second].nanoseconds;
+
+    return (firstNs < secondNs) - (firstNs > secondNs);
+}
+
+int compareTargetsByInclusiveInstructions(const void* first, const void* second)
+{
+    uint64_t firstCount  = sortedProfiler->targets[*(const size_t*) first].inclusiveInstructions;
+    uint64_t secondCount = sortedProfiler->targets[*(const size_t*) second].inclusiveInstructions;
+
+    return (firstCount < secondCount) - (firstCount > secondCount);
+}
@@ -0,0 +1,132 @@
+#pragma once
+#include <stddef.h>
+#include <stdint.h>
+#include "instructions.h"
+#include "symbols.h"
+
+static const size_t PROFILER_NO_NODE = (size_t) -1;
+
+enum ProfilerCallEvent
+{
+    PROFILER_EVENT_NONE,
+    PROFILER_EVENT_CALL,
+    PROFILER_EVENT_RET
+};
+
+struct OpcodeProfile
+{
+    uint64_t count       = 0;
+    uint64_t nanoseconds = 0;
+};
+
+struct PcProfile
+{
+    uint64_t count       = 0;
+    uint64_t nanoseconds = 0;
+    uint64_t taken       = 0;
+    uint64_t notTaken    = 0;
+};
+
+// statistics of a subroutine, inclusive values aren't counted twice for recursive calls
+struct CallTargetProfile
+{
+    uint64_t calls                 = 0;
+    uint64_t activeFrames          = 0;
+    uint64_t inclusiveInstructions = 0;
+    uint64_t inclusiveNs           = 0;
+    uint64_t exclusiveInstructions = 0;
+    uint64_t exclusiveNs           = 0;
+};
+
+// node of the call tree, i.e. a unique call stack
+struct CallNode
+{
+    size_t   target           = 0;
+    size_t   parent           = PROFILER_NO_NODE;
+    size_t   firstChild       = PROFILER_NO_NODE;
+    size_t   nextSibling      = PROFILER_NO_NODE;
+    uint64_t selfInstructions = 0;
+    uint64_t selfNs           = 0;
+};
+
+// frame of the shadow call stack
+struct CallFrame
+{
+    size_t   node              = 0;
+    uint64_t startInstructions = 0;
+    uint64_t startNs           = 0;
+};
+
+struct Profiler
+{
+    const unsigned char* program      = NULL;
+    size_t               programBytes = 0;
+    const SymbolTable*   symbols      = NULL;
+
+    PcProfile*           pcs          = NULL;
+    OpcodeProfile        opcodes[CPU_COMMANDS_COUNT] = {};
+
+    uint64_t             totalInstructions = 0;
+    uint64_t             totalNs           = 0;
+
+    CallTargetProfile*   targets        = NULL;
+    CallNode*            nodes          = NULL;
+    size_t               nodesCount     = 0;
+    size_t               nodesCapacity  = 0;
+    CallFrame*           frames         = NULL;
+    size_t               framesCount    = 0;
+    size_t               framesCapacity = 0;
+    size_t               currentNode    = 0;
+
+    ProfilerCallEvent    pendingEvent  = PROFILER_EVENT_NONE;
+    size_t               pendingTarget = 0;
+};
+
+Profiler* newProfiler            (const char* program, size_t programBytes, const SymbolTable* symbols);
+void      deleteProfiler         (Profiler* profiler);
+uint64_t  getHostTimeNs          ();
+void      profilerApplyCallEvent (Profiler* profiler);
+bool      writeProfileReport     (Profiler* profiler, const char* reportFileName);
+bool      writeCollapsedStacks   (Profiler* profiler, const char* stacksFileName);
+
+// call and ret only leave an event, which is applied after the instruction is recorded,
+// so that call is attributed to the caller and ret to the callee
+inline void profilerOnCall(Profiler* profiler, size_t target)
+{
+    profiler->pendingEvent  = PROFILER_EVENT_CALL;
+    profiler->pendingTarget = target;
+}
+
+inline void profilerOnRet(Profiler* profiler)
+{
+    profiler->pendingEvent = PROFILER_EVENT_RET;
+}
+
+inline void profilerRecordInstruction(Profiler* profiler, size_t pc, size_t nextPc, uint64_t nanoseconds)
+{
+    unsigned char opcode = profiler->program[pc];
+
+    profiler->opcodes[opcode].count++;
+    profiler->opcodes[opcode].nanoseconds += nanoseconds;
+
+    PcProfile* pcProfile = &profiler->pcs[pc];
+    pcProfile->count++;
+    pcProfile->nanoseconds += nanoseconds;
+
+    if (isControlFlowInstruction(opcode))
+    {
+        if (nextPc == pc + getInstructionLength(&profiler->program[pc], profiler->programBytes - pc))
+            pcProfile->notTaken++;
+        else
+            pcProfile->taken++;
+    }
+
+    profiler->totalInstructions++;
+    profiler->totalNs += nanoseconds;
+
+    CallNode* node = &profiler->nodes[profiler->currentNode];
+    node->selfInstructions++;
+    node->selfNs += nanoseconds;
+
+    if (profiler->pendingEvent != PROFILER_EVENT_NONE) { profilerApplyCallEvent(profiler); }
+}
@@ -0,0 +1,127 @@
+#include <assert.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "assembler_specification.h"
+#include "build_cache.h"
+#include "source_cache.h"
+
+bool assembleSource      (const char* source, size_t sourceSize, bool isOptimized, FILE* labelsFile, BytecodeImage* image);
+bool writeCachedBytecode (const BytecodeImage* image, const char* temporaryName);
+
+bool isAssemblyFileName(const char* fileName)
+{
+    assert(fileName != NULL);
+
+    size_t nameLength      = strlen(fileName);
+    size_t extensionLength = strlen(ASSEMBLY_FILE_EXTENSION);
+
+    return nameLength > extensionLength && strcmp(fileName + nameLength - extensionLength, ASSEMBLY_FILE_EXTENSION) == 0;
+}
+
+// the key covers everything the code depends on: the formats, the options and the source; the
+// source is read once, so the code cached under the key is assembled from the text it was hashed from
+bool loadAssemblySource(const char* fileName, const char* cacheDir, bool isOptimized,
+                        BytecodeImage* image, SymbolTable** symbols)
+{
+    assert(fileName != NULL);
+    assert(image    != NULL);
+    assert(symbols  != NULL);
+
+    if (cacheDir == NULL) { cacheDir = DEFAULT_BUILD_CACHE_DIR; }
+    *symbols = NULL;
+
+    uint64_t key = BUILD_CACHE_HASH_SEED;
+    key = hashBytes(&BYTECODE_VERSION,  sizeof(BYTECODE_VERSION),  key);
+    key = hashBytes(&ASSEMBLER_VERSION, sizeof(ASSEMBLER_VERSION), key);
+    key = hashBytes(&isOptimized,       sizeof(isOptimized),       key);
+
+    unsigned char* source     = NULL;
+    size_t         sourceSize = 0;
+    if (!readWholeFile(fileName, &source, &sourceSize)) { printf("Couldn't read '%s'.\n", fileName); return false; }
+
+    key = hashBytes(source, sourceSize, key);
+
+    char* entryName = makeCacheEntryName(cacheDir, key, BYTECODE_FILE_EXTENSION);
+    if (entryName == NULL) { printf("Not enough memory.\n"); free(source); return false; }
+
+    // a damaged entry is assembled again and replaced
+    if (isCacheEntryPresent(entryName))
+    {
+        if (loadBytecode(entryName, image))
+        {
+            *symbols = loadSymbolTable(entryName);
+            free(entryName);
+            free(source);
+            return true;
+        }
+
+        clearBytecodeImage(image);
+    }
+
+    // the labels are written while the source is assembled, the code is committed after them,
+    // so an entry which is present always has its labels
+    char* labelsName          = makeSymbolsFileName(entryName);
+    char* temporaryName       = makeTemporaryEntryName(entryName);
+    char* temporaryLabelsName = labelsName != NULL ? makeTemporaryEntryName(labelsName) : NULL;
+
+    FILE* labelsFile = NULL;
+    if (temporaryName != NULL && temporaryLabelsName != NULL && createCacheDir(cacheDir)) { labelsFile = fopen(temporaryLabelsName, "w"); }
+
+    bool isAssembled = assembleSource((const char*) source, sourceSize, isOptimized, labelsFile, image);
+    bool isCached    = isAssembled && labelsFile != NULL &&
+                       writeCachedBytecode(image, temporaryName) &&
+                       commitCacheEntry(temporaryLabelsName, labelsName) &&
+                       commitCacheEntry(temporaryName, entryName);
+
+    if (labelsFile != NULL && !isCached)
+    {
+        remove(temporaryLabelsName);
+        remove(temporaryName);
+    }
+
+    if      (isCached)    { *symbols = loadSymbolTable(entryName); }
+    else if (isAssembled) { printf("Note: couldn't write to the build cache '%s', the source is assembled on every run.\n", cacheDir); }
+
+    free(source);
+    free(entryName);
+    free(labelsName);
+    free(temporaryName);
+    free(temporaryLabelsName);
+
+    return isAssembled;
+}
+
+bool writeCachedBytecode(const BytecodeImage* image, const char* temporaryName)
+{
+    assert(image         != NULL);
+    assert(temporaryName != NULL);
+
+    FILE* bytecodeFile = fopen(temporaryName, "wb");
+    if (bytecodeFile == NULL) { return false; }
+
+    bool isWritten = writeBytecode(bytecodeFile, image);
+
+    return fclose(bytecodeFile) == 0 && isWritten;
+}
+
+// straight into the image from the source in memory, syntax errors are printed
+bool assembleSource(const char* source, size_t sourceSize, bool isOptimized, FILE* labelsFile, BytecodeImage* image)
+{
+    assert(source != NULL);
+    assert(image  != NULL);
+
+    Assembler assembler = {};
+    assembler.isOptimized = isOptimized;
+    assembler.labelsFile  = labelsFile;
+
+    bool isAssembled = initAssemblerForSource(&assembler, source, sourceSize) == ASSEMBLER_INIT_NO_ERROR &&
+                       translateAssemblySource(&assembler, image);
+
+    finishAssembler(&assembler);
+
+    if (!isAssembled) { printf("Assembler finished with an error.\n"); clearBytecodeImage(image); }
+
+    return isAssembled;
+}
@@ -0,0 +1,18 @@
+#pragma once
+#include <stddef.h>
+#include "bytecode.h"
+#include "symbols.h"
+
+// scpu runs assembly sources directly: the source is assembled in memory and the CPU gets the
+// code without a bytecode file in between. The code and its labels are also kept in the build
+// cache (see build_cache.h) under a hash of the source, -O and the versions of the assembler and
+// of the bytecode, so running an unchanged source again doesn't assemble it.
+
+static const char* const ASSEMBLY_FILE_EXTENSION = ".asy";
+static const char* const BYTECODE_FILE_EXTENSION = ".bsy";
+
+bool isAssemblyFileName (const char* fileName);
+
+// cacheDir can be NULL for DEFAULT_BUILD_CACHE_DIR, symbols gets NULL if the labels aren't cached
+bool loadAssemblySource (const char* fileName, const char* cacheDir, bool isOptimized,
+                         BytecodeImage* image, SymbolTable** symbols);
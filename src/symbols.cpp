@@ -0,0 +1,154 @@
+#include <assert.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "symbols.h"
+#include "../libs/file_manager.h"
+
+// returns calloc'ed name of the side file with labels of the bytecode file
+char* makeSymbolsFileName(const char* bytecodeFileName)
+{
+    assert(bytecodeFileName != NULL);
+
+    size_t bytecodeNameLength = strlen(bytecodeFileName);
+    char*  symbolsFileName    = (char*) calloc(bytecodeNameLength + strlen(SYMBOLS_FILE_EXTENSION) + 1, sizeof(char));
+    if (symbolsFileName == NULL) { return NULL; }
+
+    strcpy(symbolsFileName, bytecodeFileName);
+    strcpy(symbolsFileName + bytecodeNameLength, SYMBOLS_FILE_EXTENSION);
+
+    return symbolsFileName;
+}
+
+// returns NULL if there is no side file (e.g. the bytecode was produced by an older assembler),
+// labels are written by the assembler in the order of definition, so the table comes out sorted by offset
+SymbolTable* loadSymbolTable(const char* bytecodeFileName)
+{
+    assert(bytecodeFileName != NULL);
+
+    char* symbolsFileName = makeSymbolsFileName(bytecodeFileName);
+    if (symbolsFileName == NULL) { return NULL; }
+
+    Text* symbolsText = NULL;
+    if (getFileSize(symbolsFileName) != 0) { symbolsText = readTextFromFile(symbolsFileName); }
+
+    free(symbolsFileName);
+    if (symbolsText == NULL) { return NULL; }
+
+    SymbolTable* table = (SymbolTable*) calloc(1, sizeof(SymbolTable));
+    if (table == NULL) { deleteText(symbolsText); return NULL; }
+
+    size_t      capacity = 0;
+    const char* currLine = NULL;
+    while ((currLine = nextTextLine(symbolsText)) != NULL)
+    {
+        char*  nameStart = NULL;
+        size_t offset    = strtoul(currLine, &nameStart, 10);
+
+        if (nameStart == currLine || *nameStart != ' ') { continue; }
+        nameStart++;
+
+        if (table->count == capacity)
+        {
+            capacity = capacity == 0 ? 16 : capacity * 2;
+
+            Symbol* newSymbols = (Symbol*) realloc(table->symbols, capacity * sizeof(Symbol));
+            if (newSymbols == NULL) { deleteText(symbolsText); deleteSymbolTable(table); return NULL; }
+
+            table->symbols = newSymbols;
+        }
+
+        table->symbols[table->count].offset = offset;
+        table->symbols[table->count].name   = (char*) calloc(strlen(nameStart) + 1, sizeof(char));
+        if (table->symbols[table->count].name == NULL) { deleteText(symbolsText); deleteSymbolTable(table); return NULL; }
+
+        strcpy(table->symbols[table->count].name, nameStart);
+        table->count++;
+    }
+
+    deleteText(symbolsText);
+
+    return table;
+}
+
+void deleteSymbolTable(SymbolTable* table)
+{
+    if (table == NULL) { return; }
+
+    for (size_t i = 0; i < table->count; i++)
+    {
+        free(table->symbols[i].name);
+    }
+
+    free(table->symbols);
+    free(table);
+}
+
+// moves labels of wide bytecode to the offsets of its compacted code, the map keeps the order;
+// offsets which aren't in the map are left as they are
+void remapSymbolTable(SymbolTable* table, const size_t* offsetMap, size_t mapSize)
+{
+    assert(offsetMap != NULL);
+
+    if (table == NULL) { return; }
+
+    for (size_t i = 0; i < table->count; i++)
+    {
+        size_t offset = table->symbols[i].offset;
+        if (offset < mapSize && offsetMap[offset] != (size_t) -1) { table->symbols[i].offset = offsetMap[offset]; }
+    }
+}
+
+// returns name of the first label defined at offset or NULL
+const char* getSymbolName(const SymbolTable* table, size_t offset)
+{
+    if (table == NULL) { return NULL; }
+
+    size_t left  = 0;
+    size_t right = table->count;
+    while (left < right)
+    {
+        size_t middle = left + (right - left) / 2;
+
+        if (table->symbols[middle].offset < offset) { left  = middle + 1; }
+        else                                        { right = middle;     }
+    }
+
+    if (left < table->count && table->symbols[left].offset == offset) { return table->symbols[left].name; }
+
+    return NULL;
+}
+
+// returns the last label defined at or before offset or NULL
+const Symbol* findNearestSymbol(const SymbolTable* table, size_t offset)
+{
+    if (table == NULL) { return NULL; }
+
+    size_t left  = 0;
+    size_t right = table->count;
+    while (left < right)
+    {
+        size_t middle = left + (right - left) / 2;
+
+        if (table->symbols[middle].offset <= offset) { left  = middle + 1; }
+        else                                         { right = middle;     }
+    }
+
+    return left == 0 ? NULL : &table->symbols[left - 1];
+}
+
+const Symbol* findSymbol(const SymbolTable* table, const char* name)
+{
+    assert(name != NULL);
+
+    if (table == NULL) { return NULL; }
+
+    for (size_t i = 0; i < table->count; i++)
+    {
+        if (strcmp(table->symbols[i].name, name) == 0) { return &table->symbols[i]; }
+    }
+
+    return NULL;
+}
+
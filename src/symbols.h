@@ -0,0 +1,26 @@
+#pragma once
+#include <stddef.h>
+
+// the assembler writes label names into a side file next to the bytecode: "<bytecode file name>.lbl",
+// each line of which is "<offset> <label name>"
+static const char* const SYMBOLS_FILE_EXTENSION = ".lbl";
+
+struct Symbol
+{
+    size_t offset = 0;
+    char*  name   = NULL;
+};
+
+struct SymbolTable
+{
+    Symbol* symbols = NULL; // sorted by offset
+    size_t  count   = 0;
+};
+
+char*         makeSymbolsFileName (const char* bytecodeFileName);
+SymbolTable*  loadSymbolTable     (const char* bytecodeFileName);
+void          deleteSymbolTable   (SymbolTable* table);
+void          remapSymbolTable    (SymbolTable* table, const size_t* offsetMap, size_t mapSize);
+const char*   getSymbolName       (const SymbolTable* table, size_t offset);
+const Symbol* findNearestSymbol   (const SymbolTable* table, size_t offset);
+const Symbol* findSymbol          (const SymbolTable* table, const char* name);
@@ -0,0 +1,211 @@
+#include <assert.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "../libs/file_manager.h"
+
+#include "bytecode.h"
+#include "instructions.h"
+#include "symbols.h"
+#include "tracer.h"
+
+const char* DEFAULT_DECODED_TRACE_FILE_NAME = "bin/trace.txt";
+
+struct TraceDecoder
+{
+    FILE*              traceFile    = NULL;
+    FILE*              outputFile   = NULL;
+    unsigned char*     bytecode     = NULL;
+    size_t             bytecodeSize = 0;
+    SymbolTable*       symbols      = NULL;
+
+    uint64_t           nextSequence = 0; // records before it were already decoded or skipped
+    uint64_t           droppedCount = 0;
+};
+
+bool     initTraceDecoder   (TraceDecoder* decoder, const char* traceFileName, const char* bytecodeFileName, const char* outputFileName);
+void     finishTraceDecoder (TraceDecoder* decoder);
+bool     readTraceHeader    (TraceDecoder* decoder);
+uint64_t findTraceEnd       (TraceDecoder* decoder);
+bool     decodeTrace        (TraceDecoder* decoder, uint64_t firstSequence);
+void     decodeRecord       (TraceDecoder* decoder, uint64_t sequence, const TraceRecord* record);
+
+int main(int argc, char* argv[])
+{
+    if (argc < 3)
+    {
+        printf("Usage: %s <trace file> <bytecode file> [output file] [--last N]\n", argv[0]);
+        return 1;
+    }
+
+    const char* outputFileName = DEFAULT_DECODED_TRACE_FILE_NAME;
+    uint64_t    lastCount      = 0; // 0 means the whole trace
+
+    for (int i = 3; i < argc; i++)
+    {
+        if (strcmp(argv[i], "--last") == 0 && i + 1 < argc) { lastCount      = strtoull(argv[++i], NULL, 10); }
+        else                                                 { outputFileName = argv[i]; }
+    }
+
+    TraceDecoder decoder = {};
+    if (!initTraceDecoder(&decoder, argv[1], argv[2], outputFileName)) { finishTraceDecoder(&decoder); return 1; }
+
+    uint64_t firstSequence = 0;
+    if (lastCount != 0)
+    {
+        uint64_t end = findTraceEnd(&decoder);
+        firstSequence = end > lastCount ? end - lastCount : 0;
+    }
+
+    bool isDecodedSuccessfuly = decodeTrace(&decoder, firstSequence);
+    if (!isDecodedSuccessfuly) { printf("Trace decoder error: trace file is truncated or corrupted\n"); }
+
+    finishTraceDecoder(&decoder);
+
+    return !isDecodedSuccessfuly;
+}
+
+bool initTraceDecoder(TraceDecoder* decoder, const char* traceFileName, const char* bytecodeFileName, const char* outputFileName)
+{
+    assert(decoder          != NULL);
+    assert(traceFileName    != NULL);
+    assert(bytecodeFileName != NULL);
+    assert(outputFileName   != NULL);
+
+    decoder->traceFile = fopen(traceFileName, "rb");
+    if (decoder->traceFile == NULL) { printf("Trace decoder error: couldn't open trace file '%s'\n", traceFileName); return false; }
+
+    if (!readTraceHeader(decoder)) { printf("Trace decoder error: '%s' is not a trace file\n", traceFileName); return false; }
+
+    BytecodeImage image = {};
+    if (!loadBytecode(bytecodeFileName, &image))
+    {
+        printf("Trace decoder error: couldn't read bytecode file '%s'\n", bytecodeFileName);
+        clearBytecodeImage(&image);
+        return false;
+    }
+
+    decoder->bytecode     = image.code;
+    decoder->bytecodeSize = image.size;
+    decoder->symbols      = loadSymbolTable(bytecodeFileName);
+
+    // the CPU runs wide files compacted, so the trace has compact offsets
+    if (image.offsetMap != NULL) { remapSymbolTable(decoder->symbols, image.offsetMap, image.wideSize + 1); }
+
+    free(image.offsetMap);
+
+    decoder->outputFile = fopen(outputFileName, "w");
+    if (decoder->outputFile == NULL) { printf("Trace decoder error: couldn't open output file '%s'\n", outputFileName); return false; }
+
+    return true;
+}
+
+void finishTraceDecoder(TraceDecoder* decoder)
+{
+    assert(decoder != NULL);
+
+    if (decoder->traceFile  != NULL) { fclose(decoder->traceFile);  }
+    if (decoder->outputFile != NULL) { fclose(decoder->outputFile); }
+
+    free(decoder->bytecode);
+    deleteSymbolTable(decoder->symbols);
+
+    *decoder = {};
+}
+
+bool readTraceHeader(TraceDecoder* decoder)
+{
+    assert(decoder != NULL);
+
+    TraceFileHeader header = {};
+    if (fread(&header, sizeof(header), 1, decoder->traceFile) != 1) { return false; }
+
+    return memcmp(header.magic, TRACE_FILE_MAGIC, sizeof(header.magic)) == 0 &&
+           header.version    == TRACE_FILE_VERSION                           &&
+           header.recordSize == sizeof(TraceRecord);
+}
+
+// returns the sequence number after the last record, leaves the file right after the file header
+uint64_t findTraceEnd(TraceDecoder* decoder)
+{
+    assert(decoder != NULL);
+
+    long     chunksStart = ftell(decoder->traceFile);
+    uint64_t end         = 0;
+
+    TraceChunkHeader chunk = {};
+    while (fread(&chunk, sizeof(chunk), 1, decoder->traceFile) == 1)
+    {
+        if (chunk.firstSequence + chunk.recordsCount > end) { end = chunk.firstSequence + chunk.recordsCount; }
+
+        if (fseek(decoder->traceFile, (long) (chunk.recordsCount * sizeof(TraceRecord)), SEEK_CUR) != 0) { break; }
+    }
+
+    fseek(decoder->traceFile, chunksStart, SEEK_SET);
+
+    return end;
+}
+
+// a crash chunk may repeat records already written by the background writer, they are decoded once
+bool decodeTrace(TraceDecoder* decoder, uint64_t firstSequence)
+{
+    assert(decoder != NULL);
+
+    decoder->nextSequence = firstSequence;
+
+    TraceChunkHeader chunk = {};
+    while (fread(&chunk, sizeof(chunk), 1, decoder->traceFile) == 1)
+    {
+        if (chunk.flags & TRACE_CHUNK_CRASH) { fprintf(decoder->outputFile, "; --- crash, last records from the ring buffer ---\n"); }
+
+        for (uint32_t i = 0; i < chunk.recordsCount; i++)
+        {
+            TraceRecord record = {};
+            if (fread(&record, sizeof(record), 1, decoder->traceFile) != 1) { return false; }
+
+            uint64_t sequence = chunk.firstSequence + i;
+            if (sequence < decoder->nextSequence) { continue; }
+
+            if (sequence > decoder->nextSequence)
+            {
+                fprintf(decoder->outputFile, "; --- %llu records dropped ---\n", (unsigned long long) (sequence - decoder->nextSequence));
+                decoder->droppedCount += sequence - decoder->nextSequence;
+            }
+
+            decodeRecord(decoder, sequence, &record);
+            decoder->nextSequence = sequence + 1;
+        }
+    }
+
+    if (decoder->droppedCount != 0)
+    {
+        printf("Trace decoder: %llu records were dropped, the trace writer didn't keep up\n", (unsigned long long) decoder->droppedCount);
+    }
+
+    return feof(decoder->traceFile);
+}
+
+void decodeRecord(TraceDecoder* decoder, uint64_t sequence, const TraceRecord* record)
+{
+    assert(decoder != NULL);
+    assert(record  != NULL);
+
+    const char* label = getSymbolName(decoder->symbols, record->pc);
+    if (label != NULL) { fprintf(decoder->outputFile, "%s:\n", label); }
+
+    char instruction[MAX_INSTRUCTION_STR_LENGTH] = {};
+    if (record->pc >= decoder->bytecodeSize ||
+        formatInstruction(instruction, MAX_INSTRUCTION_STR_LENGTH, &decoder->bytecode[record->pc], decoder->bytecodeSize - record->pc) == 0)
+    {
+        snprintf(instruction, MAX_INSTRUCTION_STR_LENGTH, "<invalid opcode %u>", record->opcode);
+    }
+
+    fprintf(decoder->outputFile, "%10llu %08X  %-32s", (unsigned long long) sequence, record->pc, instruction);
+
+    if (record->flags & TRACE_RECORD_HAS_TOS) { fprintf(decoder->outputFile, " tos = %lg", record->topOfStack); }
+    else                                      { fprintf(decoder->outputFile, " tos = <empty>"); }
+
+    if (record->flags & TRACE_RECORD_HAS_RAM) { fprintf(decoder->outputFile, " ram[%u]", record->ramAddress); }
+
+    fprintf(decoder->outputFile, "\n");
+}
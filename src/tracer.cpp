@@ -0,0 +1,220 @@
+#include <assert.h>
+#include <fcntl.h>
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <chrono>
+
+#include "tracer.h"
+
+static const int TRACE_CRASH_SIGNALS[]  = { SIGSEGV, SIGABRT, SIGFPE, SIGILL };
+static const int TRACE_CRASH_LOCK_SPINS = 1 << 20;
+
+static Tracer* crashTracer = NULL; // signal handlers have no context parameter
+
+void runTraceWriter   (Tracer* tracer);
+bool flushTraceChunk  (Tracer* tracer);
+void writeTraceChunk  (Tracer* tracer, uint64_t firstSequence, const TraceRecord* records, size_t count);
+void handleTraceCrash (int signalNumber);
+bool writeAll         (int fileDescriptor, const void* data, size_t size);
+
+Tracer* newTracer(const char* traceFileName, size_t recordsCapacity, bool isStreaming)
+{
+    assert(traceFileName != NULL);
+
+    size_t capacity = 1;
+    while (capacity < recordsCapacity) { capacity *= 2; }
+
+    Tracer* tracer = new Tracer();
+
+    tracer->capacity    = capacity;
+    tracer->records     = (TraceRecord*) calloc(capacity,                sizeof(TraceRecord));
+    tracer->chunkBuffer = (TraceRecord*) calloc(TRACE_MAX_CHUNK_RECORDS, sizeof(TraceRecord));
+    if (tracer->records == NULL || tracer->chunkBuffer == NULL)
+    {
+        printf("Tracer error: not enough memory for %zu records\n", capacity);
+        deleteTracer(tracer);
+        return NULL;
+    }
+
+    tracer->fileDescriptor = open(traceFileName, O_WRONLY | O_CREAT | O_TRUNC | O_APPEND, 0644);
+    if (tracer->fileDescriptor < 0)
+    {
+        printf("Tracer error: couldn't open trace file '%s'\n", traceFileName);
+        deleteTracer(tracer);
+        return NULL;
+    }
+
+    TraceFileHeader header = {};
+    memcpy(header.magic, TRACE_FILE_MAGIC, sizeof(header.magic));
+    header.version    = TRACE_FILE_VERSION;
+    header.recordSize = sizeof(TraceRecord);
+
+    if (!writeAll(tracer->fileDescriptor, &header, sizeof(header)))
+    {
+        printf("Tracer error: couldn't write to trace file '%s'\n", traceFileName);
+        deleteTracer(tracer);
+        return NULL;
+    }
+
+    crashTracer = tracer;
+    for (size_t i = 0; i < sizeof(TRACE_CRASH_SIGNALS) / sizeof(TRACE_CRASH_SIGNALS[0]); i++)
+    {
+        signal(TRACE_CRASH_SIGNALS[i], handleTraceCrash);
+    }
+
+    if (isStreaming)
+    {
+        tracer->isRunning.store(true);
+        tracer->writer = std::thread(runTraceWriter, tracer);
+    }
+
+    return tracer;
+}
+
+void deleteTracer(Tracer* tracer)
+{
+    if (tracer == NULL) { return; }
+
+    if (tracer->writer.joinable())
+    {
+        tracer->isRunning.store(false, std::memory_order_release);
+        tracer->writer.join();
+    }
+
+    if (crashTracer == tracer)
+    {
+        for (size_t i = 0; i < sizeof(TRACE_CRASH_SIGNALS) / sizeof(TRACE_CRASH_SIGNALS[0]); i++)
+        {
+            signal(TRACE_CRASH_SIGNALS[i], SIG_DFL);
+        }
+
+        crashTracer = NULL;
+    }
+
+    if (tracer->fileDescriptor >= 0)
+    {
+        while (flushTraceChunk(tracer)) {}
+
+        close(tracer->fileDescriptor);
+    }
+
+    free(tracer->records);
+    free(tracer->chunkBuffer);
+
+    delete tracer;
+}
+
+void runTraceWriter(Tracer* tracer)
+{
+    assert(tracer != NULL);
+
+    while (tracer->isRunning.load(std::memory_order_acquire))
+    {
+        if (!flushTraceChunk(tracer)) { std::this_thread::sleep_for(std::chrono::milliseconds(1)); }
+    }
+}
+
+// writes out up to TRACE_MAX_CHUNK_RECORDS new records, returns false if there were none
+bool flushTraceChunk(Tracer* tracer)
+{
+    assert(tracer != NULL);
+
+    uint64_t head = tracer->publishedHead.load(std::memory_order_acquire);
+    uint64_t tail = tracer->flushedTail.load(std::memory_order_relaxed);
+    if (head == tail) { return false; }
+
+    // the interpreter doesn't wait for the writer, records it has already overwritten are lost
+    if (head - tail > tracer->capacity) { tail = head - tracer->capacity; }
+
+    uint64_t end = head - tail > TRACE_MAX_CHUNK_RECORDS ? tail + TRACE_MAX_CHUNK_RECORDS : head;
+    for (uint64_t sequence = tail; sequence < end; sequence++)
+    {
+        tracer->chunkBuffer[sequence - tail] = tracer->records[sequence & (tracer->capacity - 1)];
+    }
+
+    // records overwritten while being copied may be torn, so they are dropped too
+    std::atomic_thread_fence(std::memory_order_acquire);
+    uint64_t newHead     = tracer->publishedHead.load(std::memory_order_relaxed);
+    uint64_t oldestValid = newHead + 1 > tracer->capacity ? newHead + 1 - tracer->capacity : 0;
+    uint64_t first       = tail > oldestValid ? tail : oldestValid;
+
+    if (first < end) { writeTraceChunk(tracer, first, tracer->chunkBuffer + (first - tail), end - first); }
+
+    tracer->flushedTail.store(end, std::memory_order_release);
+
+    return true;
+}
+
+void writeTraceChunk(Tracer* tracer, uint64_t firstSequence, const TraceRecord* records, size_t count)
+{
+    assert(tracer  != NULL);
+    assert(records != NULL);
+
+    TraceChunkHeader header = {};
+    header.firstSequence = firstSequence;
+    header.recordsCount  = (uint32_t) count;
+
+    while (tracer->isWriting.test_and_set(std::memory_order_acquire)) {}
+
+    writeAll(tracer->fileDescriptor, &header, sizeof(header));
+    writeAll(tracer->fileDescriptor, records, count * sizeof(TraceRecord));
+
+    tracer->isWriting.clear(std::memory_order_release);
+}
+
+// saves the last records still in the ring buffer and lets the signal do its default action
+void handleTraceCrash(int signalNumber)
+{
+    Tracer* tracer = crashTracer;
+
+    if (tracer != NULL)
+    {
+        uint64_t head = tracer->publishedHead.load(std::memory_order_acquire);
+        uint64_t tail = tracer->flushedTail.load(std::memory_order_acquire);
+        if (head - tail > tracer->capacity) { tail = head - tracer->capacity; }
+
+        // don't wait forever in case it's the writer thread itself that crashed
+        bool isLocked = false;
+        for (int i = 0; i < TRACE_CRASH_LOCK_SPINS && !isLocked; i++)
+        {
+            isLocked = !tracer->isWriting.test_and_set(std::memory_order_acquire);
+        }
+
+        if (isLocked && head != tail)
+        {
+            TraceChunkHeader header = {};
+            header.firstSequence = tail;
+            header.recordsCount  = (uint32_t) (head - tail);
+            header.flags         = TRACE_CHUNK_CRASH;
+
+            size_t firstIndex = tail & (tracer->capacity - 1);
+            size_t firstCount = head - tail < tracer->capacity - firstIndex ? head - tail : tracer->capacity - firstIndex;
+
+            writeAll(tracer->fileDescriptor, &header, sizeof(header));
+            writeAll(tracer->fileDescriptor, &tracer->records[firstIndex], firstCount * sizeof(TraceRecord));
+            writeAll(tracer->fileDescriptor, tracer->records, (head - tail - firstCount) * sizeof(TraceRecord));
+        }
+    }
+
+    signal(signalNumber, SIG_DFL);
+    raise(signalNumber);
+}
+
+bool writeAll(int fileDescriptor, const void* data, size_t size)
+{
+    const char* currByte = (const char*) data;
+
+    while (size > 0)
+    {
+        ssize_t written = write(fileDescriptor, currByte, size);
+        if (written <= 0) { return false; }
+
+        currByte += written;
+        size     -= written;
+    }
+
+    return true;
+}
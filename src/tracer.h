@@ -0,0 +1,93 @@
+#pragma once
+#include <stddef.h>
+#include <stdint.h>
+#include <atomic>
+#include <thread>
+
+// Trace file is a header followed by chunks, each chunk is a chunk header followed by records.
+// Records are numbered by sequence numbers, so the decoder can see records lost when the
+// background writer didn't keep up, and ignore records written twice on a crash.
+// Without streaming there is no writer thread, only the last records of the ring buffer
+// are saved on exit or on a crash.
+
+static const char     TRACE_FILE_MAGIC[8]            = "SCPUTRC";
+static const uint32_t TRACE_FILE_VERSION             = 1;
+static const size_t   TRACE_DEFAULT_RECORDS_CAPACITY = 1 << 22;
+static const size_t   TRACE_MAX_CHUNK_RECORDS        = 1 << 16;
+
+enum TraceRecordFlags
+{
+    TRACE_RECORD_HAS_TOS = 1 << 0,
+    TRACE_RECORD_HAS_RAM = 1 << 1
+};
+
+enum TraceChunkFlags
+{
+    TRACE_CHUNK_CRASH = 1 << 0
+};
+
+struct TraceRecord
+{
+    double   topOfStack = 0; // after the instruction
+    uint32_t pc         = 0;
+    uint32_t ramAddress = 0;
+    uint8_t  opcode     = 0;
+    uint8_t  flags      = 0;
+};
+
+struct TraceFileHeader
+{
+    char     magic[8]   = {};
+    uint32_t version    = 0;
+    uint32_t recordSize = 0;
+};
+
+struct TraceChunkHeader
+{
+    uint64_t firstSequence = 0;
+    uint32_t recordsCount  = 0;
+    uint32_t flags         = 0;
+};
+
+struct Tracer
+{
+    TraceRecord*          records        = NULL;
+    size_t                capacity       = 0; // power of two
+    uint64_t              head           = 0; // owned by the interpreter thread
+
+    std::atomic<uint64_t> publishedHead  {0};
+    std::atomic<uint64_t> flushedTail    {0};
+    std::atomic<bool>     isRunning      {false};
+    std::atomic_flag      isWriting      = ATOMIC_FLAG_INIT;
+    std::thread           writer;
+    int                   fileDescriptor = -1;
+    TraceRecord*          chunkBuffer    = NULL;
+
+    // RAM access of the current instruction
+    uint32_t              ramAddress     = 0;
+    uint8_t               ramFlag        = 0;
+};
+
+Tracer* newTracer    (const char* traceFileName, size_t recordsCapacity, bool isStreaming);
+void    deleteTracer (Tracer* tracer);
+
+inline void tracerRecordRamAccess(Tracer* tracer, size_t address)
+{
+    tracer->ramAddress = (uint32_t) address;
+    tracer->ramFlag    = TRACE_RECORD_HAS_RAM;
+}
+
+inline void tracerRecordInstruction(Tracer* tracer, size_t pc, unsigned char opcode, bool hasTopOfStack, double topOfStack)
+{
+    TraceRecord* record = &tracer->records[tracer->head & (tracer->capacity - 1)];
+
+    record->topOfStack = topOfStack;
+    record->pc         = (uint32_t) pc;
+    record->ramAddress = tracer->ramAddress;
+    record->opcode     = opcode;
+    record->flags      = (hasTopOfStack ? TRACE_RECORD_HAS_TOS : 0) | tracer->ramFlag;
+
+    tracer->ramFlag = 0;
+    tracer->head++;
+    tracer->publishedHead.store(tracer->head, std::memory_order_release);
+}